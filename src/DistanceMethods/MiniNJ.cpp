@@ -190,8 +190,8 @@ void MiniNJ::computeDistanceMatrix(
   // update distanceMatrix with distanceDenominator
   for (unsigned int i = 0; i < speciesNumber; ++i) {
     for (unsigned int j = 0; j < speciesNumber; ++j) {
-      ParallelContext::sumDouble(distanceMatrix[i][j]);
-      ParallelContext::sumDouble(distanceDenominator[i][j]);
+      ParallelContext::sumDoubles(
+          {&distanceMatrix[i][j], &distanceDenominator[i][j]});
       if (i == j) {
         distanceMatrix[i][j] = 0.0;
       } else if (0.0 != distanceDenominator[i][j]) {
@@ -0,0 +1,121 @@
+#include "FamilyMetadataIndex.hpp"
+
+#include <IO/FileSystem.hpp>
+#include <IO/LibpllParsers.hpp>
+#include <IO/Logger.hpp>
+#include <IO/ParallelOfstream.hpp>
+#include <cassert>
+#include <ccp/ConditionalClades.hpp>
+#include <fstream>
+#include <parallelization/ParallelContext.hpp>
+
+thread_local std::string FamilyMetadataIndex::_indexPath;
+
+void FamilyMetadataIndex::setIndexPath(const std::string &indexPath) {
+  _indexPath = indexPath;
+}
+
+FamilyMetadataIndex::Entries &FamilyMetadataIndex::getEntries() {
+  // each thread rank computes its own part of the metadata
+  static thread_local Entries entries;
+  static thread_local std::string readPath;
+  if (readPath == _indexPath) {
+    return entries;
+  }
+  readPath = _indexPath;
+  if (!_indexPath.size() || !FileSystem::exists(_indexPath)) {
+    return entries;
+  }
+  // the cached entries are at least as recent as the ones of the file
+  std::ifstream is(_indexPath);
+  std::string name;
+  FamilyMetadata metadata;
+  while (is >> name >> metadata.geneTreeFingerprint >> metadata.leaves >>
+         metadata.ccpFingerprint >> metadata.ccpClades) {
+    entries.insert({name, metadata});
+  }
+  return entries;
+}
+
+void FamilyMetadataIndex::save(const Entries &entries) {
+  if (!_indexPath.size()) {
+    return;
+  }
+  ParallelOfstream os(_indexPath);
+  for (const auto &entry : entries) {
+    const auto &metadata = entry.second;
+    os << entry.first << " " << metadata.geneTreeFingerprint << " "
+       << metadata.leaves << " " << metadata.ccpFingerprint << " "
+       << metadata.ccpClades << "\n";
+  }
+}
+
+static unsigned int computeLeafNumber(const std::string &geneTreeFile) {
+  corax_utree_t *tree = LibpllParsers::readNewickFromFile(geneTreeFile);
+  unsigned int leaves = tree->tip_count;
+  corax_utree_destroy(tree, 0);
+  return leaves;
+}
+
+static unsigned int computeCCPCladeNumber(const std::string &ccpFile) {
+  ConditionalClades cc;
+  cc.unserialize(ccpFile);
+  return cc.getCladesNumber();
+}
+
+std::vector<unsigned int> FamilyMetadataIndex::getMetadata(
+    const Families &families, std::string FamilyInfo::*file,
+    unsigned long FamilyMetadata::*fingerprintField,
+    unsigned int FamilyMetadata::*valueField,
+    unsigned int (*compute)(const std::string &)) {
+  auto &entries = getEntries();
+  auto familiesNumber = static_cast<unsigned int>(families.size());
+  std::vector<unsigned int> localValues;
+  std::vector<unsigned long> localFingerprints;
+  unsigned int misses = 0;
+  for (auto i = ParallelContext::getBegin(familiesNumber);
+       i < ParallelContext::getEnd(familiesNumber); ++i) {
+    const auto &path = families[i].*file;
+    auto fingerprint = FileSystem::getFingerprint(path);
+    auto it = entries.find(families[i].name);
+    if (fingerprint && it != entries.end() &&
+        it->second.*fingerprintField == fingerprint) {
+      localValues.push_back(it->second.*valueField);
+    } else {
+      localValues.push_back(compute(path));
+      misses++;
+    }
+    localFingerprints.push_back(fingerprint);
+  }
+  std::vector<unsigned int> values;
+  std::vector<unsigned long> fingerprints;
+  ParallelContext::concatenateHeterogeneousUIntVectors(localValues, values);
+  ParallelContext::concatenateHeterogeneousULongVectors(localFingerprints,
+                                                        fingerprints);
+  assert(values.size() == families.size());
+  ParallelContext::sumUInt(misses);
+  if (misses) {
+    // all ranks update their cache, but only the master rank writes
+    for (unsigned int i = 0; i < familiesNumber; ++i) {
+      auto &metadata = entries[families[i].name];
+      metadata.*fingerprintField = fingerprints[i];
+      metadata.*valueField = values[i];
+    }
+    save(entries);
+  }
+  return values;
+}
+
+std::vector<unsigned int>
+FamilyMetadataIndex::getLeafNumbers(const Families &families) {
+  return getMetadata(families, &FamilyInfo::startingGeneTree,
+                     &FamilyMetadata::geneTreeFingerprint,
+                     &FamilyMetadata::leaves, computeLeafNumber);
+}
+
+std::vector<unsigned int>
+FamilyMetadataIndex::getCCPCladeNumbers(const Families &families) {
+  return getMetadata(families, &FamilyInfo::ccpFile,
+                     &FamilyMetadata::ccpFingerprint,
+                     &FamilyMetadata::ccpClades, computeCCPCladeNumber);
+}
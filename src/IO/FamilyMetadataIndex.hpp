@@ -0,0 +1,70 @@
+#pragma once
+
+#include <IO/Families.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ *  Per-family metadata needed to distribute the families over the
+ *  cores (number of gene tree leaves, number of CCP clades), so
+ *  that the load balancing does not need to parse all the input
+ *  files each time.
+ *
+ *  The metadata of a family are recomputed when the fingerprint
+ *  (see FileSystem::getFingerprint) of the file they were computed
+ *  from changes. They are cached in memory for the whole run and,
+ *  if an index path is set, in an index file reused by the next
+ *  runs and restarts.
+ */
+class FamilyMetadataIndex {
+public:
+  FamilyMetadataIndex() = delete;
+
+  /**
+   *  Set the file storing the index. If not set, the metadata
+   *  are only cached in memory. The entries of the file that are
+   *  not cached yet are read at the next call to the other
+   *  functions. Must be set on all the ranks.
+   */
+  static void setIndexPath(const std::string &indexPath);
+
+  /**
+   *  Collective. Return the number of leaves of the (first)
+   *  starting gene tree of each family.
+   */
+  static std::vector<unsigned int> getLeafNumbers(const Families &families);
+
+  /**
+   *  Collective. Return the number of clades of the CCP file of
+   *  each family.
+   */
+  static std::vector<unsigned int>
+  getCCPCladeNumbers(const Families &families);
+
+private:
+  struct FamilyMetadata {
+    FamilyMetadata()
+        : geneTreeFingerprint(0), leaves(0), ccpFingerprint(0),
+          ccpClades(0) {}
+    unsigned long geneTreeFingerprint;
+    unsigned int leaves;
+    unsigned long ccpFingerprint;
+    unsigned int ccpClades;
+  };
+  using Entries = std::unordered_map<std::string, FamilyMetadata>;
+
+  static Entries &getEntries();
+  /**
+   *  Collective. Read the value field of each family from the cache,
+   *  or compute it from its file if its fingerprint changed
+   */
+  static std::vector<unsigned int>
+  getMetadata(const Families &families, std::string FamilyInfo::*file,
+              unsigned long FamilyMetadata::*fingerprintField,
+              unsigned int FamilyMetadata::*valueField,
+              unsigned int (*compute)(const std::string &));
+  static void save(const Entries &entries);
+  // per thread rank, as the cached entries
+  static thread_local std::string _indexPath;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <parallelization/ParallelContext.hpp>
 #include <string>
@@ -49,6 +50,22 @@ public:
     return f.good();
   }
 
+  /**
+   *  Cheap identifier of the current version of a file, from its
+   *  path, size and modification time, without reading it.
+   *  Returns 0 if the file does not exist.
+   */
+  static unsigned long getFingerprint(const std::string &filePath) {
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0) {
+      return 0;
+    }
+    unsigned long fingerprint = std::hash<std::string>()(filePath);
+    fingerprint = fingerprint * 31 + static_cast<unsigned long>(info.st_size);
+    fingerprint = fingerprint * 31 + static_cast<unsigned long>(info.st_mtime);
+    return fingerprint ? fingerprint : 1;
+  }
+
   static void getFileContent(const std::string &filePath,
                              std::string &content) {
     std::ifstream ifs(filePath);
@@ -1,4 +1,5 @@
 #include "LibpllParsers.hpp"
+#include <IO/FamilyMetadataIndex.hpp>
 #include <IO/LibpllException.hpp>
 #include <IO/Logger.hpp>
 #include <IO/RootedNewickParser.hpp>
@@ -206,24 +207,9 @@ void LibpllParsers::getRtreeHierarchicalString(const corax_rtree_t *rtree,
 
 std::vector<unsigned int>
 LibpllParsers::parallelGetTreeSizes(const Families &families) {
-  unsigned int treesNumber = static_cast<unsigned int>(families.size());
-  std::vector<unsigned int> localTreeSizes(
-      (treesNumber - 1) / ParallelContext::getSize() + 1, 0);
-  for (auto i = ParallelContext::getBegin(treesNumber);
-       i < ParallelContext::getEnd(treesNumber); i++) {
-    corax_utree_t *tree =
-        LibpllParsers::readNewickFromFile(families[i].startingGeneTree);
-    unsigned int taxa = tree->tip_count;
-    localTreeSizes[i - ParallelContext::getBegin(treesNumber)] = taxa;
-    corax_utree_destroy(tree, 0);
-  }
-  std::vector<unsigned int> treeSizes;
-  ParallelContext::concatenateUIntVectors(localTreeSizes, treeSizes);
-  treeSizes.erase(remove(treeSizes.begin(), treeSizes.end(), 0),
-                  treeSizes.end());
-  assert(treeSizes.size() == families.size());
-  return treeSizes;
+  return FamilyMetadataIndex::getLeafNumbers(families);
 }
+
 void LibpllParsers::fillLeavesFromUtree(
     corax_utree_t *utree, std::unordered_set<std::string> &leaves) {
   for (unsigned int i = 0; i < utree->tip_count + utree->inner_count; ++i) {
@@ -1,5 +1,7 @@
 #include "IO/Logger.hpp"
 
+#include <mutex>
+
 Logger Logger::info;
 Logger Logger::error;
 Logger Logger::timed;
@@ -7,25 +9,28 @@ Logger Logger::perrank;
 TimePoint Logger::start;
 std::string Logger::outputdir;
 std::ofstream *Logger::logFile = nullptr;
-std::ofstream *Logger::rankLogFile = nullptr;
+thread_local std::ofstream *Logger::rankLogFile = nullptr;
 std::ofstream *Logger::saveLogFile = nullptr;
 bool Logger::inited = false;
+thread_local bool Logger::_unmuted = false;
 
-Logger::Logger() : _os(&std::cout), _silent(true) { setType(lt_info); }
+Logger::Logger() : _os(&std::cout) { setType(lt_info); }
 
 void Logger::init() {
-  if (inited) {
-    return;
-  }
-  inited = true;
-  info.setType(lt_info);
-  info.setStream(std::cout);
-  error.setType(lt_error);
-  error.setStream(std::cout);
-  timed.setType(lt_timed);
-  timed.setStream(std::cout);
-  perrank.setType(lt_perrank);
-  start = std::chrono::high_resolution_clock::now();
+  // the thread ranks of ParallelContext share the loggers and all
+  // call init: only the first call sets them up
+  static std::once_flag initFlag;
+  std::call_once(initFlag, [] {
+    inited = true;
+    info.setType(lt_info);
+    info.setStream(std::cout);
+    error.setType(lt_error);
+    error.setStream(std::cout);
+    timed.setType(lt_timed);
+    timed.setStream(std::cout);
+    perrank.setType(lt_perrank);
+    start = std::chrono::high_resolution_clock::now();
+  });
   ParallelContext::barrier();
 }
 
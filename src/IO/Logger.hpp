@@ -23,7 +23,10 @@ private:
   enum LoggerType { lt_info, lt_error, lt_timed, lt_perrank };
   LoggerType _type;
   std::ostream *_os; // I do not own this one
-  bool _silent;
+  // set by unmute to let Logger::info continue an error message on
+  // a non-master rank. Per thread, such that a thread rank (see
+  // ParallelContext::runThreadRanks) does not unmute the other ones
+  static thread_local bool _unmuted;
 
   Logger();
   void setType(LoggerType type) { _type = type; }
@@ -35,12 +38,12 @@ public:
 
   static void initFileOutput(const std::string &output);
 
-  static void mute() { info._silent = true; }
-  static void unmute() { info._silent = false; }
+  static void mute() { _unmuted = false; }
+  static void unmute() { _unmuted = true; }
 
   // if true, the MPI rank can't write logs
   bool isSilent() {
-    if (!_silent) {
+    if (_type == lt_info && _unmuted) {
       return false;
     }
     if (_type == lt_perrank) {
@@ -124,7 +127,7 @@ public:
   static TimePoint start;
   static std::string outputdir;
   static std::ofstream *logFile;
-  static std::ofstream *rankLogFile;
+  static thread_local std::ofstream *rankLogFile;
   static std::ofstream *saveLogFile;
   static bool inited;
 };
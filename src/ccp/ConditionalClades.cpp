@@ -1,8 +1,13 @@
 #include "ConditionalClades.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <sstream>
 
 #include <IO/Logger.hpp>
@@ -283,6 +288,299 @@ static void fillCladeCounts(
   }
 }
 
+static const unsigned int NO_NODE = std::numeric_limits<unsigned int>::max();
+
+// a node of a newick string, parsed without building a corax tree
+struct NewickNode {
+  unsigned int parent;
+  std::vector<unsigned int> children;
+  unsigned int leafId;
+  double length;
+  CCPClade clade;
+};
+
+// a subclade occurence, to be added to the subclade counts and BLs
+struct NewickSplit {
+  CID parent;
+  CID child;
+  double bl;
+};
+
+static void skipNewickComment(const std::string &newick, size_t &i) {
+  while (i < newick.size() && newick[i] != ']') {
+    ++i;
+  }
+}
+
+static std::string readNewickLabel(const std::string &newick, size_t &i) {
+  std::string label;
+  if (i < newick.size() && newick[i] == '\'') {
+    auto end = newick.find('\'', i + 1);
+    if (end == std::string::npos) {
+      end = newick.size();
+    }
+    label = newick.substr(i + 1, end - i - 1);
+    i = end + 1;
+    return label;
+  }
+  while (i < newick.size()) {
+    auto c = newick[i];
+    if (c == '(' || c == ')' || c == ',' || c == ':' || c == ';' ||
+        c == '[' || isspace(c)) {
+      break;
+    }
+    label.push_back(c);
+    ++i;
+  }
+  return label;
+}
+
+/**
+ *  Parse a newick string token by token. The parents are stored
+ *  before their children, and nodes[0] is the top of the newick
+ *  string. The leaf IDs are assigned when leafToId is empty, and
+ *  checked against leafToId otherwise.
+ *  Return false if the string is not a binary tree with the leaves
+ *  of leafToId
+ */
+static bool
+parseNewick(const std::string &newick,
+            std::unordered_map<std::string, unsigned int> &leafToId,
+            std::vector<std::string> &idToLeaf,
+            std::vector<NewickNode> &nodes) {
+  bool addLeaves = leafToId.empty();
+  nodes.clear();
+  unsigned int current = NO_NODE; // the innermost open internal node
+  unsigned int last = NO_NODE;    // the last node read
+  bool closed = false;            // if last is an internal node
+  size_t i = 0;
+  while (i < newick.size() && newick[i] != ';') {
+    auto c = newick[i];
+    if (isspace(c)) {
+      ++i;
+    } else if (c == '[') {
+      skipNewickComment(newick, i);
+      ++i;
+    } else if (c == '(' || (c != ')' && c != ',' && c != ':' && !closed)) {
+      if (last != NO_NODE && current == NO_NODE) {
+        return false; // several trees
+      }
+      NewickNode node;
+      node.parent = current;
+      node.leafId = NO_NODE;
+      node.length = 0.0;
+      unsigned int index = nodes.size();
+      if (current != NO_NODE) {
+        nodes[current].children.push_back(index);
+      }
+      if (c == '(') {
+        current = index;
+        last = NO_NODE;
+        ++i;
+      } else {
+        auto label = readNewickLabel(newick, i);
+        auto it = leafToId.find(label);
+        if (it == leafToId.end()) {
+          if (!addLeaves || label.empty()) {
+            return false;
+          }
+          it = leafToId.insert({label, leafToId.size()}).first;
+          idToLeaf.push_back(label);
+        }
+        node.leafId = it->second;
+        last = index;
+      }
+      nodes.push_back(node);
+    } else if (c == ')') {
+      if (current == NO_NODE) {
+        return false;
+      }
+      last = current;
+      current = nodes[current].parent;
+      closed = true;
+      ++i;
+      while (i < newick.size() && isspace(newick[i])) {
+        ++i;
+      }
+      readNewickLabel(newick, i); // internal labels are not used
+    } else if (c == ',') {
+      closed = false;
+      ++i;
+    } else if (c == ':') {
+      if (last == NO_NODE) {
+        return false;
+      }
+      ++i;
+      const char *begin = newick.c_str() + i;
+      char *end = nullptr;
+      nodes[last].length = std::strtod(begin, &end);
+      if (end == begin) {
+        return false;
+      }
+      i += end - begin;
+    } else {
+      return false;
+    }
+  }
+  if (nodes.empty() || current != NO_NODE) {
+    return false;
+  }
+  for (auto &node : nodes) {
+    if (node.length <= 0.0) {
+      // same default as PLLUnrootedTree::setMissingBranchLengths
+      node.length = 0.1;
+    }
+    auto children = node.children.size();
+    if (node.leafId == NO_NODE && children != 2 &&
+        (node.parent != NO_NODE || children != 3)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// fill the clade of each node of a parsed newick string
+// return false if a leaf is missing or duplicated
+static bool computeNewickClades(std::vector<NewickNode> &nodes,
+                                unsigned int leafNumber) {
+  unsigned int leaves = 0;
+  for (unsigned int i = nodes.size(); i > 0; --i) {
+    auto &node = nodes[i - 1];
+    node.clade = CCPClade(leafNumber, false);
+    if (node.leafId != NO_NODE) {
+      node.clade.set(node.leafId);
+      leaves++;
+    } else {
+      for (auto child : node.children) {
+        node.clade |= nodes[child].clade;
+      }
+    }
+  }
+  return leaves == leafNumber && nodes[0].clade.count() == leafNumber;
+}
+
+static CID getTempCID(const CCPClade &clade, CladeToCID &cladeToCID,
+                      CIDToClade &cidToClade) {
+  auto it = cladeToCID.find(clade);
+  if (it != cladeToCID.end()) {
+    return it->second;
+  }
+  CID cid = cidToClade.size();
+  cidToClade.push_back(clade);
+  cladeToCID.insert({clade, cid});
+  return cid;
+}
+
+/**
+ *  Extract the subclade occurences of a newick string, without
+ *  building the corax tree. The CIDs are temporary IDs assigned
+ *  in order of appearance.
+ *  In unrooted mode, each branch gives two clades (one per side),
+ *  and each clade is a subclade of the root clade. In rooted mode,
+ *  the root clade is only split at the top of the newick string.
+ *  topology is filled with a sorted list of CIDs that identifies
+ *  the (rooted or unrooted) topology of the tree
+ *  Return false if the newick string is not valid
+ */
+static bool
+readNewickSplits(const std::string &newick, bool rooted,
+                 std::unordered_map<std::string, unsigned int> &leafToId,
+                 std::vector<std::string> &idToLeaf,
+                 std::vector<NewickNode> &nodes, CladeToCID &cladeToCID,
+                 CIDToClade &cidToClade, std::vector<NewickSplit> &splits,
+                 std::vector<CID> &topology) {
+  splits.clear();
+  topology.clear();
+  if (!parseNewick(newick, leafToId, idToLeaf, nodes) ||
+      !computeNewickClades(nodes, leafToId.size())) {
+    return false;
+  }
+  const auto &top = nodes[0];
+  if (top.leafId != NO_NODE) {
+    return false;
+  }
+  bool bifurcatingTop = top.children.size() == 2;
+  if (rooted && !bifurcatingTop) {
+    return false;
+  }
+  auto fullCID = getTempCID(top.clade, cladeToCID, cidToClade);
+  std::vector<CID> down(nodes.size());
+  for (unsigned int v = 0; v < nodes.size(); ++v) {
+    down[v] = getTempCID(nodes[v].clade, cladeToCID, cidToClade);
+  }
+  if (rooted) {
+    for (unsigned int v = 1; v < nodes.size(); ++v) {
+      topology.push_back(down[v]);
+      for (auto child : nodes[v].children) {
+        splits.push_back({down[v], down[child], nodes[child].length});
+      }
+    }
+    // same root BLs as PLLUnrootedTree::getRoot
+    for (auto child : top.children) {
+      splits.push_back({fullCID, down[child], nodes[child].length * 2.0});
+    }
+    std::sort(topology.begin(), topology.end());
+    return true;
+  }
+  // the unrooted tree is rooted at the top node, or at its first
+  // child if the top is bifurcating: its two children are then
+  // connected by a single branch
+  unsigned int root = bifurcatingTop ? top.children[0] : 0;
+  unsigned int rootSibling = bifurcatingTop ? top.children[1] : NO_NODE;
+  auto getParent = [&](unsigned int v) {
+    return v == rootSibling ? root : nodes[v].parent;
+  };
+  auto getLength = [&](unsigned int v) {
+    if (v == rootSibling) {
+      return nodes[root].length + nodes[rootSibling].length;
+    }
+    return nodes[v].length;
+  };
+  auto getChildren = [&](unsigned int v) {
+    auto children = nodes[v].children;
+    if (v == root && bifurcatingTop) {
+      children.push_back(rootSibling);
+    }
+    return children;
+  };
+  // up[v] is the clade on the other side of the branch above v
+  std::vector<CID> up(nodes.size(), fullCID);
+  for (unsigned int v = 0; v < nodes.size(); ++v) {
+    if (v != root && !(bifurcatingTop && v == 0)) {
+      auto clade = getComplementary(top.clade, nodes[v].clade);
+      up[v] = getTempCID(clade, cladeToCID, cidToClade);
+    }
+  }
+  for (unsigned int v = 0; v < nodes.size(); ++v) {
+    if (v == root || (bifurcatingTop && v == 0)) {
+      continue;
+    }
+    auto length = getLength(v);
+    auto parent = getParent(v);
+    topology.push_back(nodes[v].clade[0] ? up[v] : down[v]);
+    // the clade below the branch
+    splits.push_back({fullCID, down[v], length});
+    for (auto child : nodes[v].children) {
+      splits.push_back({down[v], down[child], getLength(child)});
+    }
+    // the clade above the branch
+    splits.push_back({fullCID, up[v], length});
+    if (nodes[parent].leafId != NO_NODE) {
+      continue;
+    }
+    for (auto child : getChildren(parent)) {
+      if (child != v) {
+        splits.push_back({up[v], down[child], getLength(child)});
+      }
+    }
+    if (parent != root) {
+      splits.push_back({up[v], up[parent], getLength(parent)});
+    }
+  }
+  std::sort(topology.begin(), topology.end());
+  return true;
+}
+
 ConditionalClades::ConditionalClades(const std::string &inputFile,
                                      const std::string &likelihoods,
                                      CCPRooting ccpRooting,
@@ -448,6 +746,138 @@ void ConditionalClades::buildFromGeneTrees(const std::string &inputFile,
                                            const std::string &likelihoods,
                                            CCPRooting ccpRooting,
                                            unsigned int sampleFrequency) {
+  _ccpRooting = ccpRooting;
+  if (madRooting()) {
+    // the MAD deviations are computed on the corax trees
+    buildFromPLLTrees(inputFile, likelihoods, ccpRooting, sampleFrequency);
+    return;
+  }
+  // stream the trees and count their subclades on the fly: only
+  // one tree is parsed at a time, and we only keep one key per
+  // unique topology to detect the duplicates
+  bool rooted = (ccpRooting == CCPRooting::ROOTED);
+  bool useLikelihoods = likelihoods.size();
+  std::ifstream infile(inputFile);
+  std::ifstream llFile;
+  if (useLikelihoods) {
+    llFile.open(likelihoods);
+  }
+  std::unordered_map<std::string, unsigned int> leafToId;
+  // temporary CIDs, in order of appearance
+  CladeToCID tempCladeToCID;
+  CIDToClade tempCIDToClade;
+  SubcladeCounts tempSubcladeCounts;
+  SubcladeBLs tempSubcladeBLs;
+  // for each unique topology, the likelihood and the newick
+  // string of its best tree (only stored with likelihoods)
+  std::map<std::vector<CID>, std::pair<double, std::string>> topologies;
+  std::vector<NewickNode> nodes;
+  std::vector<NewickSplit> splits;
+  std::vector<CID> topology;
+  std::string line;
+  unsigned int index = 0;
+  while (std::getline(infile, line)) {
+    if (index++ % sampleFrequency != 0) {
+      continue;
+    }
+    if (leafToId.empty() && parseNewick(line, leafToId, _idToLeaf, nodes)) {
+      // the leaf IDs (and thus the CIDs) follow the order of the
+      // labels, and not the order of the leaves in the first tree
+      std::sort(_idToLeaf.begin(), _idToLeaf.end());
+      for (unsigned int id = 0; id < _idToLeaf.size(); ++id) {
+        leafToId[_idToLeaf[id]] = id;
+      }
+    }
+    double ll = 0.0;
+    if (useLikelihoods) {
+      std::string llLine;
+      std::getline(llFile, llLine);
+      ll = std::stod(llLine);
+    }
+    if (!readNewickSplits(line, rooted, leafToId, _idToLeaf, nodes,
+                          tempCladeToCID, tempCIDToClade, splits, topology)) {
+      Logger::error << "Error, the trees in " << inputFile
+                    << " are not binary trees with the same unique leaf"
+                    << " labels" << std::endl;
+      _isValid = false;
+      return;
+    }
+    tempSubcladeCounts.resize(tempCIDToClade.size());
+    tempSubcladeBLs.resize(tempCIDToClade.size());
+    auto it = topologies.find(topology);
+    bool newTopology = (it == topologies.end());
+    if (newTopology) {
+      it = topologies.insert({topology, {ll, std::string()}}).first;
+    }
+    double frequency = useLikelihoods ? ll : 1.0;
+    for (const auto &split : splits) {
+      addSubclade(split.parent, split.child, tempSubcladeCounts, frequency,
+                  split.bl, useLikelihoods);
+    }
+    if (useLikelihoods) {
+      if (newTopology || ll > it->second.first) {
+        it->second = {ll, line};
+      }
+    } else if (newTopology) {
+      for (const auto &split : splits) {
+        addBL(split.parent, split.child, split.bl, tempSubcladeBLs);
+      }
+    }
+    _inputTrees++;
+  }
+  if (!_inputTrees) {
+    Logger::error << "Error, no tree could be read from " << inputFile
+                  << std::endl;
+    _isValid = false;
+    return;
+  }
+  _uniqueInputTrees = topologies.size();
+  if (useLikelihoods) {
+    // the BLs of a topology are the ones of its best tree
+    for (const auto &pair : topologies) {
+      readNewickSplits(pair.second.second, rooted, leafToId, _idToLeaf, nodes,
+                       tempCladeToCID, tempCIDToClade, splits, topology);
+      for (const auto &split : splits) {
+        addBL(split.parent, split.child, split.bl, tempSubcladeBLs);
+      }
+    }
+  }
+  // assign the final CIDs: a parent clade always comes after
+  // its child clades in the CID ordering
+  OrderedClades orderedClades(tempCIDToClade.begin(), tempCIDToClade.end());
+  for (const auto &clade : orderedClades) {
+    unsigned int cid = _CIDToClade.size();
+    _CIDToClade.push_back(clade);
+    _cladeToCID[clade] = cid;
+  }
+  std::vector<CID> tempToCID(tempCIDToClade.size());
+  for (CID tempCID = 0; tempCID < tempCIDToClade.size(); ++tempCID) {
+    tempToCID[tempCID] = _cladeToCID.at(tempCIDToClade[tempCID]);
+  }
+  for (auto pair : leafToId) {
+    CCPClade clade(leafToId.size(), false);
+    clade.set(pair.second);
+    _CIDToLeaf[_cladeToCID.at(clade)] = pair.first;
+  }
+  SubcladeCounts subcladeCounts(_CIDToClade.size());
+  SubcladeBLs subcladeBLs(_CIDToClade.size());
+  for (CID tempCID = 0; tempCID < tempCIDToClade.size(); ++tempCID) {
+    auto cid = tempToCID[tempCID];
+    for (const auto &pair : tempSubcladeCounts[tempCID]) {
+      subcladeCounts[cid][tempToCID[pair.first]] = pair.second;
+    }
+    for (auto &pair : tempSubcladeBLs[tempCID]) {
+      subcladeBLs[cid][tempToCID[pair.first]] = std::move(pair.second);
+    }
+  }
+  _fillCCP(subcladeCounts, subcladeBLs, useLikelihoods);
+}
+
+void ConditionalClades::buildFromPLLTrees(const std::string &inputFile,
+                                          const std::string &likelihoods,
+                                          CCPRooting ccpRooting,
+                                          unsigned int sampleFrequency) {
+  _ccpRooting = ccpRooting;
   std::unordered_map<std::string, unsigned int> leafToId;
   CCPClade emptyClade;
   CCPClade fullClade;
@@ -459,9 +889,11 @@ void ConditionalClades::buildFromGeneTrees(const std::string &inputFile,
     return;
   }
   auto &anyTree = *(weightedTrees.begin()->first.tree);
-  for (auto leaf : anyTree.getLabels()) {
+  auto labels = anyTree.getLabels();
+  _idToLeaf.assign(labels.begin(), labels.end());
+  std::sort(_idToLeaf.begin(), _idToLeaf.end());
+  for (auto leaf : _idToLeaf) {
     leafToId.insert({leaf, leafToId.size()});
-    _idToLeaf.push_back(leaf);
   }
   emptyClade = CCPClade(anyTree.getLeafNumber(), false);
   fullClade = CCPClade(anyTree.getLeafNumber(), true);
@@ -61,7 +61,9 @@ using CladeSplits = std::vector<CladeSplit>;
  */
 class ConditionalClades {
 public:
-  ConditionalClades() {}
+  ConditionalClades()
+      : _inputTrees(0), _uniqueInputTrees(0),
+        _ccpRooting(CCPRooting::UNIFORM), _isValid(true) {}
   ConditionalClades(const std::string &inputFile,
                     const std::string &likelihoods, CCPRooting ccpRooting,
                     unsigned int sampleFrequency = 1);
@@ -89,6 +91,14 @@ public:
   void buildFromGeneTrees(const std::string &inputFile,
                           const std::string &likelihoods, CCPRooting ccpRooting,
                           unsigned int sampleFrequency);
+  /**
+   *  Same as buildFromGeneTrees, but builds the corax trees of all
+   *  the sampled trees at once (slower and more memory-hungry).
+   *  buildFromGeneTrees only uses it for MAD rooting.
+   */
+  void buildFromPLLTrees(const std::string &inputFile,
+                         const std::string &likelihoods,
+                         CCPRooting ccpRooting, unsigned int sampleFrequency);
   void buildFromALEFormat(const std::string &inputFile, CCPRooting ccpRooting);
 
   bool madRooting() const { return _ccpRooting == CCPRooting::MAD; }
@@ -16,7 +16,7 @@ RootedSpeciesSplitScore::RootedSpeciesSplitScore(PLLRootedTree &speciesTree,
 
 void RootedSpeciesSplitScore::updateSpeciesTree(PLLRootedTree &speciesTree) {
   _speciesTree = &speciesTree;
-  _speciesTree->buildLCACache();
+  _speciesTree->buildLCAIndex();
   // map internal branches to branch ids
   SPID maxSpid = 0;
   for (auto node : _speciesTree->getLeaves()) {
@@ -79,8 +79,7 @@ double RootedSpeciesSplitScore::getScore() {
     if (!node->left) {
       continue;
     }
-    ParallelContext::sumDouble(score[spid]);
-    ParallelContext::sumDouble(denominator[spid]);
+    ParallelContext::sumDoubles({&score[spid], &denominator[spid]});
     res += score[spid];
   }
   return res / den;
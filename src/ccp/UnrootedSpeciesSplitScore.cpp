@@ -104,8 +104,7 @@ double UnrootedSpeciesSplitScore::getScoreHack() {
   }
   double res = 0;
   for (unsigned int i = 0; i < _bidToNodeIndex.size(); ++i) {
-    ParallelContext::sumDouble(score[i]);
-    ParallelContext::sumDouble(denominator[i]);
+    ParallelContext::sumDoubles({&score[i], &denominator[i]});
     auto ratio = score[i] / denominator[i];
     res += log(0.0001 + ratio);
   }
@@ -165,8 +164,7 @@ double UnrootedSpeciesSplitScore::getScore() {
   }
   double res = 0;
   for (unsigned int i = 0; i < _bidToNodeIndex.size(); ++i) {
-    ParallelContext::sumDouble(score[i]);
-    ParallelContext::sumDouble(denominator[i]);
+    ParallelContext::sumDoubles({&score[i], &denominator[i]});
     if (useDenominator) {
       if (denominator[i] != 0.0) {
         auto ratio = score[i] / denominator[i];
@@ -5,10 +5,12 @@
 #include "LibpllEvaluation.hpp"
 #include <IO/Logger.hpp>
 #include <IO/Model.hpp>
+#include <algorithm>
 #include <corax/corax.h>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <parallelization/ParallelContext.hpp>
 #include <sstream>
 #include <string>
 
@@ -40,56 +42,219 @@ void LibpllEvaluation::createAndSaveRandomTree(
 LibpllEvaluation::LibpllEvaluation(const std::string &newickStrOrFile,
                                    bool isNewickAFile,
                                    const std::string &alignmentFilename,
-                                   const std::string &modelStrOrFile)
+                                   const std::string &modelStrOrFile,
+                                   bool siteParallel)
     : _treeInfo(std::make_unique<PLLTreeInfo>(
-          newickStrOrFile, isNewickAFile, alignmentFilename, modelStrOrFile)) {}
+          newickStrOrFile, isNewickAFile, alignmentFilename, modelStrOrFile,
+          siteParallel ? ParallelContext::getTeamSize() : 1)) {
+  auto slices = _treeInfo->getSiteSlices();
+  if (slices.empty()) {
+    return;
+  }
+  _sliceComm = std::make_unique<ThreadComm>(slices.size());
+  for (unsigned int i = 0; i < slices.size(); ++i) {
+    _siteSlices.push_back(SiteSlice{slices[i], _sliceComm.get(), i});
+  }
+  // _siteSlices is not resized anymore: the contexts stay valid
+  for (auto &slice : _siteSlices) {
+    corax_treeinfo_set_parallel_context(slice.treeinfo, &slice,
+                                        reduceOverSlices);
+  }
+}
 
 double LibpllEvaluation::raxmlSPRRounds(unsigned int minRadius,
                                         unsigned int maxRadius,
                                         unsigned int thorough,
                                         unsigned int toKeep, double cutoff) {
-  cutoff_info_t cutoff_info;
-  if (cutoff != 0.0) {
-    cutoff_info.lh_dec_count = 0;
-    cutoff_info.lh_dec_sum = 0.;
-    cutoff_info.lh_cutoff = computeLikelihood(false) / -1000.0;
-  }
-  double lh_epsilon_brlen_triplet = 0.1;
-  return corax_algo_spr_round(
-      getTreeInfo(), static_cast<int>(minRadius), static_cast<int>(maxRadius),
-      static_cast<int>(toKeep),   // params.ntopol_keep
-      static_cast<int>(thorough), // THOROUGH
-      0,                          // int brlen_opt_method,
-      RAXML_BRLEN_MIN, RAXML_BRLEN_MAX, RAXML_BRLEN_SMOOTHINGS, 0.1,
-      (fabs(cutoff) < std::numeric_limits<double>::epsilon())
-          ? 0
-          : &cutoff_info, // cutoff_info_t * cutoff_info,
-      cutoff,             // double subtree_cutoff);
-      lh_epsilon_brlen_triplet);
+  return runOnSlices([=](corax_treeinfo_t *treeinfo) {
+    cutoff_info_t cutoff_info;
+    if (cutoff != 0.0) {
+      cutoff_info.lh_dec_count = 0;
+      cutoff_info.lh_dec_sum = 0.;
+      cutoff_info.lh_cutoff =
+          corax_treeinfo_compute_loglh(treeinfo, 0) / -1000.0;
+    }
+    double lh_epsilon_brlen_triplet = 0.1;
+    return corax_algo_spr_round(
+        treeinfo, static_cast<int>(minRadius), static_cast<int>(maxRadius),
+        static_cast<int>(toKeep),   // params.ntopol_keep
+        static_cast<int>(thorough), // THOROUGH
+        0,                          // int brlen_opt_method,
+        RAXML_BRLEN_MIN, RAXML_BRLEN_MAX, RAXML_BRLEN_SMOOTHINGS, 0.1,
+        (fabs(cutoff) < std::numeric_limits<double>::epsilon())
+            ? 0
+            : &cutoff_info, // cutoff_info_t * cutoff_info,
+        cutoff,             // double subtree_cutoff);
+        lh_epsilon_brlen_triplet);
+  });
+}
+
+double LibpllEvaluation::optimizeLocalBranches(
+    const std::vector<unsigned int> &nodeIndices, double tolerance,
+    unsigned int smoothings) {
+  return runOnSlices([&](corax_treeinfo_t *treeinfo) {
+    auto root = treeinfo->root;
+    // could be incremental and thus faster
+    double loglk = corax_treeinfo_compute_loglh(treeinfo, 0);
+    for (unsigned int j = 0; j < 2; ++j) {
+      for (auto nodeIndex : nodeIndices) {
+        corax_treeinfo_set_root(treeinfo, treeinfo->subnodes[nodeIndex]);
+        corax_treeinfo_compute_loglh(treeinfo, 1);
+        loglk = -1 * corax_opt_optimize_branch_lengths_local_multi(
+                         treeinfo->partitions, treeinfo->partition_count,
+                         treeinfo->root, treeinfo->param_indices,
+                         treeinfo->deriv_precomp, treeinfo->branch_lengths,
+                         treeinfo->brlen_scalers, RAXML_BRLEN_MIN,
+                         RAXML_BRLEN_MAX, tolerance,
+                         static_cast<int>(smoothings),
+                         0, /* radius */
+                         1, /* keep_update */
+                         CORAX_OPT_BLO_NEWTON_FAST, treeinfo->brlen_linkage,
+                         treeinfo->parallel_context,
+                         treeinfo->parallel_reduce_cb);
+      }
+    }
+    corax_treeinfo_set_root(treeinfo, root);
+    return loglk;
+  });
 }
 
 double LibpllEvaluation::computeLikelihood(bool incremental) {
-  return corax_treeinfo_compute_loglh(_treeInfo->getTreeInfo(), incremental);
+  return runOnSlices([incremental](corax_treeinfo_t *treeinfo) {
+    return corax_treeinfo_compute_loglh(treeinfo, incremental);
+  });
+}
+
+bool LibpllEvaluation::useSiteSlices() const {
+  return !_siteSlices.empty() &&
+         ParallelContext::getTeamSize() >= _siteSlices.size();
+}
+
+double LibpllEvaluation::runOnSlices(
+    const std::function<double(corax_treeinfo_t *)> &function) {
+  if (!useSiteSlices()) {
+    return function(_treeInfo->getTreeInfo());
+  }
+  pushToSlices();
+  std::vector<double> results(_siteSlices.size(), 0.0);
+  ParallelContext::teamRun([&](unsigned int thread) {
+    if (thread < _siteSlices.size()) {
+      results[thread] = function(_siteSlices[thread].treeinfo);
+    }
+  });
+  pullFromSlices();
+  return results[0];
+}
+
+/**
+ *  Copy the topology and branch lengths of the tree of from
+ *  into the tree of to (both trees have the same node indices),
+ *  and invalidate the CLVs and pmatrices of the changed nodes of to
+ */
+static void copyTree(const corax_treeinfo_t *from, corax_treeinfo_t *to) {
+  for (unsigned int i = 0; i < from->subnode_count; ++i) {
+    auto node = from->subnodes[i];
+    auto toNode = to->subnodes[i];
+    auto toBack = to->subnodes[node->back->node_index];
+    if (toNode->back != toBack || toNode->length != node->length ||
+        toNode->pmatrix_index != node->pmatrix_index) {
+      toNode->back = toBack;
+      toNode->length = node->length;
+      toNode->pmatrix_index = node->pmatrix_index;
+      corax_treeinfo_invalidate_clv(to, toNode);
+      corax_treeinfo_invalidate_pmatrix(to, toNode);
+    }
+    to->branch_lengths[0][node->pmatrix_index] =
+        from->branch_lengths[0][node->pmatrix_index];
+  }
+  corax_treeinfo_set_root(to, to->subnodes[from->root->node_index]);
+}
+
+void LibpllEvaluation::pushToSlices() {
+  auto treeinfo = _treeInfo->getTreeInfo();
+  auto &model = _treeInfo->getModel();
+  assign(model, treeinfo->partitions[0]);
+  auto modelStr = model.to_string(true);
+  bool modelChanged = (modelStr != _slicesModelStr);
+  _slicesModelStr = modelStr;
+  for (auto &slice : _siteSlices) {
+    // the other CLVs affected by a change of the tree were
+    // invalidated by the caller (see invalidateCLV)
+    copyTree(treeinfo, slice.treeinfo);
+    if (modelChanged) {
+      assign(slice.treeinfo->partitions[0], model);
+      slice.treeinfo->alphas[0] = treeinfo->alphas[0];
+      corax_treeinfo_invalidate_all(slice.treeinfo);
+    }
+  }
+}
+
+void LibpllEvaluation::pullFromSlices() {
+  auto treeinfo = _treeInfo->getTreeInfo();
+  auto slice = _siteSlices[0].treeinfo;
+  copyTree(slice, treeinfo);
+  auto &model = _treeInfo->getModel();
+  assign(model, slice->partitions[0]);
+  assign(treeinfo->partitions[0], model);
+  treeinfo->alphas[0] = slice->alphas[0];
+  _slicesModelStr = model.to_string(true);
+  // the main CLVs are not computed with slices
+  corax_treeinfo_invalidate_all(treeinfo);
+}
+
+void LibpllEvaluation::reduceOverSlices(void *context, double *data,
+                                        size_t size, int op) {
+  auto slice = static_cast<SiteSlice *>(context);
+  std::vector<std::vector<double>> allData;
+  slice->comm->allGather(slice->rank, std::vector<double>(data, data + size),
+                         allData);
+  // same order on all the slices, such that they get the same values
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = allData[0][i];
+    for (unsigned int rank = 1; rank < allData.size(); ++rank) {
+      switch (op) {
+      case CORAX_REDUCE_SUM:
+        data[i] += allData[rank][i];
+        break;
+      case CORAX_REDUCE_MAX:
+        data[i] = std::max(data[i], allData[rank][i]);
+        break;
+      case CORAX_REDUCE_MIN:
+        data[i] = std::min(data[i], allData[rank][i]);
+        break;
+      default:
+        assert(false);
+      }
+    }
+  }
 }
 
 double LibpllEvaluation::optimizeBranches(double tolerance) {
-  auto toOptimize = _treeInfo->getTreeInfo()->params_to_optimize[0];
-  _treeInfo->getTreeInfo()->params_to_optimize[0] =
-      CORAX_OPT_PARAM_BRANCHES_ITERATIVE;
-  double res = optimizeAllParameters(tolerance);
-  _treeInfo->getTreeInfo()->params_to_optimize[0] = toOptimize;
-  return res;
+  return runOnSlices([tolerance](corax_treeinfo_t *treeinfo) {
+    auto toOptimize = treeinfo->params_to_optimize[0];
+    treeinfo->params_to_optimize[0] = CORAX_OPT_PARAM_BRANCHES_ITERATIVE;
+    double res = optimizeTreeInfoParameters(treeinfo, tolerance);
+    treeinfo->params_to_optimize[0] = toOptimize;
+    return res;
+  });
 }
 
 double LibpllEvaluation::optimizeAllParameters(double tolerance) {
-  if (_treeInfo->getTreeInfo()->params_to_optimize[0] == 0) {
-    return computeLikelihood();
+  return runOnSlices([tolerance](corax_treeinfo_t *treeinfo) {
+    return optimizeTreeInfoParameters(treeinfo, tolerance);
+  });
+}
+
+double LibpllEvaluation::optimizeTreeInfoParameters(corax_treeinfo_t *treeinfo,
+                                                    double tolerance) {
+  if (treeinfo->params_to_optimize[0] == 0) {
+    return corax_treeinfo_compute_loglh(treeinfo, 0);
   }
-  double previousLogl = computeLikelihood();
+  double previousLogl = corax_treeinfo_compute_loglh(treeinfo, 0);
   double newLogl = previousLogl;
   do {
     previousLogl = newLogl;
-    newLogl = optimizeAllParametersOnce(_treeInfo->getTreeInfo(), tolerance);
+    newLogl = optimizeAllParametersOnce(treeinfo, tolerance);
   } while (newLogl - previousLogl > tolerance);
   return newLogl;
 }
@@ -176,4 +341,9 @@ void LibpllEvaluation::invalidateCLV(unsigned int nodeIndex) {
   corax_treeinfo_invalidate_clv(_treeInfo->getTreeInfo(), getNode(nodeIndex));
   corax_treeinfo_invalidate_pmatrix(_treeInfo->getTreeInfo(),
                                     getNode(nodeIndex));
+  for (auto &slice : _siteSlices) {
+    auto node = slice.treeinfo->subnodes[nodeIndex];
+    corax_treeinfo_invalidate_clv(slice.treeinfo, node);
+    corax_treeinfo_invalidate_pmatrix(slice.treeinfo, node);
+  }
 }
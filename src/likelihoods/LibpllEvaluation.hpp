@@ -3,8 +3,10 @@
 #include <IO/LibpllParsers.hpp>
 #include <corax/corax.h>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <parallelization/ThreadComm.hpp>
 #include <string>
 #include <trees/PLLTreeInfo.hpp>
 #include <trees/PLLUnrootedTree.hpp>
@@ -19,6 +21,16 @@ struct LibpllAlignmentInfo {
 
 /*
  * Libpll wraper to compute the phylogenetic likelihood of a tree.
+ *
+ * With site slices (see the constructor), all the computations,
+ * including the optimizations and the SPR rounds, run on the
+ * slices: one thread of the team of the calling rank per slice,
+ * the slices summing their partial results with each other through
+ * the libpll parallel reduction callback. The main treeinfo
+ * (getTreeInfo) holds the reference topology, branch lengths and
+ * model: it is copied to the slices before each computation (their
+ * CLVs are kept when nothing changed) and updated from them after,
+ * but its own CLVs are not computed.
  */
 class LibpllEvaluation {
 public:
@@ -39,10 +51,18 @@ public:
    * @param alignmentFilename path to the msa file
    * @param modelStrOrFile a std::string representing the model (GTR,
    * DAYOFF...), or a file containing it
+   * @param siteParallel if true, split the site patterns of long
+   * alignments over the thread team of the calling rank (see
+   * ParallelContext::setTeamSize). Must be false if the caller runs
+   * libpll routines on getTreeInfo() directly, because its CLVs are
+   * then not computed. As with the main treeinfo, the incremental
+   * computations rely on the CLV invalidations of the caller (see
+   * invalidateCLV), which are forwarded to the slices
    */
   LibpllEvaluation(const std::string &newickStrOrFile, bool isNewickAFile,
                    const std::string &alignmentFilename,
-                   const std::string &modelStrOrFile);
+                   const std::string &modelStrOrFile,
+                   bool siteParallel = false);
 
   /*
    *  Compute the likelihood of the tree given the alignment
@@ -58,6 +78,16 @@ public:
   double optimizeAllParameters(double tolerance = TOLERANCE);
   double optimizeBranches(double tolerance = TOLERANCE);
 
+  /**
+   *  Optimize the lengths of the branches of the nodes with the
+   *  given indices, one after another (two passes over the nodes).
+   *  Cheaper than optimizeBranches when only a few branches changed,
+   *  for instance around an SPR move
+   *  @return the log likelihood of the tree
+   */
+  double optimizeLocalBranches(const std::vector<unsigned int> &nodeIndices,
+                               double tolerance, unsigned int smoothings);
+
   double raxmlSPRRounds(unsigned int minRadius, unsigned int maxRadius,
                         unsigned int thorough, unsigned int toKeep,
                         double cutoff);
@@ -91,13 +121,57 @@ private:
    */
   LibpllEvaluation() {}
 
+  static double optimizeTreeInfoParameters(corax_treeinfo_t *treeinfo,
+                                           double tolerance);
   static double optimizeAllParametersOnce(corax_treeinfo_t *treeinfo,
                                           double tolerance);
 
+  /**
+   *  Run function on the main treeinfo, or on each site slice if
+   *  they can be used, and return its result (the same on all
+   *  the slices, since their likelihoods are reduced)
+   */
+  double
+  runOnSlices(const std::function<double(corax_treeinfo_t *)> &function);
+
+  /**
+   *  The slices can only be used if the team of the calling rank
+   *  has one thread per slice
+   */
+  bool useSiteSlices() const;
+
+  /**
+   *  Copy the topology, branch lengths and model of the main
+   *  treeinfo into the slices, invalidating their CLVs if any
+   *  of them changed
+   */
+  void pushToSlices();
+
+  /**
+   *  Copy the topology, branch lengths and model of the first
+   *  slice into the main treeinfo
+   */
+  void pullFromSlices();
+
+  /**
+   *  libpll parallel reduction callback of the slices
+   */
+  static void reduceOverSlices(void *context, double *data, size_t size,
+                               int op);
+
   corax_unode_t *getNode(unsigned int nodeIndex) {
     return _treeInfo->getTreeInfo()->subnodes[nodeIndex];
   }
 
 private:
+  struct SiteSlice {
+    corax_treeinfo_t *treeinfo;
+    ThreadComm *comm;
+    unsigned int rank;
+  };
   std::unique_ptr<PLLTreeInfo> _treeInfo;
+  std::unique_ptr<ThreadComm> _sliceComm;
+  std::vector<SiteSlice> _siteSlices;
+  // model string of the slices, to detect model changes
+  std::string _slicesModelStr;
 };
@@ -4,6 +4,7 @@
 #include <likelihoods/reconciliation_models/SimpleDSModel.hpp>
 #include <likelihoods/reconciliation_models/UndatedDLModel.hpp>
 #include <likelihoods/reconciliation_models/UndatedDTLModel.hpp>
+#include <mutex>
 
 ReconciliationEvaluation::ReconciliationEvaluation(
     PLLRootedTree &speciesTree, PLLUnrootedTree &initialGeneTree,
@@ -12,30 +13,66 @@ ReconciliationEvaluation::ReconciliationEvaluation(
     : _speciesTree(speciesTree), _initialGeneTree(initialGeneTree),
       _geneSpeciesMapping(geneSpeciesMapping), _recModelInfo(recModelInfo),
       _infinitePrecision(true), _forcedRootedGeneTree(forcedRootedGeneTree) {
+  if (_recModelInfo.gammaCategories > 1 &&
+      !_recModelInfo.hasGammaCategories()) {
+    // the option is ignored: warn once, and not for each family
+    static std::once_flag warned;
+    std::call_once(warned, []() {
+      Logger::info << "Warning: gamma rate categories are only supported "
+                      "by the undated DL and DTL models, the option is "
+                      "ignored"
+                   << std::endl;
+    });
+  }
   _evaluators = buildRecModelObject(_recModelInfo.model, _infinitePrecision);
 }
 
 ReconciliationEvaluation::~ReconciliationEvaluation() { delete _evaluators; }
 
 void ReconciliationEvaluation::setRates(const Parameters &parameters) {
+  if (fillRatesVector(parameters)) {
+    _evaluators->setRates(_rates);
+  }
+}
+
+double ReconciliationEvaluation::evaluateAfterRatesChange(
+    const Parameters &parameters) {
+  if (!fillRatesVector(parameters)) {
+    return evaluate();
+  }
+  return _evaluators->computeLogLikelihoodAfterRatesChange(_rates);
+}
+
+bool ReconciliationEvaluation::supportsLocalRatesChange() const {
+  return _evaluators->supportsLocalRatesChange();
+}
+
+bool ReconciliationEvaluation::fillRatesVector(const Parameters &parameters) {
   unsigned int freeParameters = Enums::freeParameters(_recModelInfo.model);
   if (!freeParameters) {
-    return;
+    return false;
   }
   assert(parameters.dimensions());
-  assert(0 == parameters.dimensions() % freeParameters);
-  _rates.resize(freeParameters);
+  // the gamma shape parameter is stored after the (per-species) rates
+  bool gamma = _recModelInfo.hasGammaCategories();
+  auto ratesDimensions = parameters.dimensions() - (gamma ? 1 : 0);
+  assert(ratesDimensions);
+  assert(0 == ratesDimensions % freeParameters);
+  _rates.resize(freeParameters + (gamma ? 1 : 0));
   for (auto &r : _rates) {
     r.resize(_speciesTree.getNodeNumber());
   }
   // this handles both per-species and global rates
-  for (unsigned int d = 0; d < _rates.size(); ++d) {
+  for (unsigned int d = 0; d < freeParameters; ++d) {
     for (unsigned int e = 0; e < _speciesTree.getNodeNumber(); ++e) {
-      (_rates[d])[e] =
-          parameters[(e * _rates.size() + d) % parameters.dimensions()];
+      (_rates[d])[e] = parameters[(e * freeParameters + d) % ratesDimensions];
     }
   }
-  _evaluators->setRates(_rates);
+  if (gamma) {
+    std::fill(_rates.back().begin(), _rates.back().end(),
+              parameters[parameters.dimensions() - 1]);
+  }
+  return true;
 }
 
 corax_unode_t *ReconciliationEvaluation::getRoot() {
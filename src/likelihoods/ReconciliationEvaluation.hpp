@@ -58,6 +58,22 @@ public:
    */
   double evaluate();
 
+  /**
+   *  Set the rates and return the reconciliation likelihood.
+   *  Must only be called if nothing but the rates changed since the
+   *  last likelihood computation: the models can then only recompute
+   *  the species nodes affected by the rates change
+   */
+  double evaluateAfterRatesChange(const Parameters &parameters);
+
+  /**
+   *  Return true if evaluateAfterRatesChange only recomputes the
+   *  species nodes affected by the rates change. Otherwise, it
+   *  costs as much as evaluate (e.g. with transfers, all species
+   *  nodes depend on the rates of each species node)
+   */
+  bool supportsLocalRatesChange() const;
+
   bool implementsTransfers() {
     return Enums::accountsForTransfers(_recModelInfo.model);
   }
@@ -86,6 +102,7 @@ public:
   void sampleReconciliations(unsigned int samples,
                              std::vector<std::shared_ptr<Scenario>> &scenarios);
 
+  PLLRootedTree &getSpeciesTree() { return _speciesTree; }
   RecModel getRecModel() const { return _recModelInfo.model; }
   const RecModelInfo &getRecModelInfo() const { return _recModelInfo; }
 
@@ -106,6 +123,11 @@ private:
                                                      bool infinitePrecision);
   corax_unode_t *computeMLRoot();
   void updatePrecision(bool infinitePrecision);
+  /**
+   *  Expand the parameters into the per-species rates vector.
+   *  Return false if the model does not have free parameters
+   */
+  bool fillRatesVector(const Parameters &parameters);
 };
 
 using Evaluations = std::vector<std::shared_ptr<ReconciliationEvaluation>>;
@@ -5,7 +5,12 @@ BaseReconciliationModel::BaseReconciliationModel(
     const RecModelInfo &recModelInfo)
     : _info(recModelInfo), _speciesTree(speciesTree),
       _geneNameToSpeciesName(geneSpeciesMapping.getMap()),
-      _numberOfCoveredSpecies(0), _allSpeciesNodesInvalid(true) {
+      _numberOfCoveredSpecies(0),
+      _categoryRates(recModelInfo.hasGammaCategories()
+                         ? recModelInfo.gammaCategories
+                         : 1,
+                     1.0),
+      _allSpeciesNodesInvalid(true) {
   initSpeciesTree();
   setFractionMissingGenes(_info.fractionMissingFile);
 }
@@ -24,25 +29,22 @@ void BaseReconciliationModel::onSpeciesTreeChange(
       }
     }
   }
-  // full species tree representation
-  _allSpeciesNodes.clear();
-  fillNodesPostOrder(_speciesTree.getRoot(), _allSpeciesNodes);
-  for (auto speciesNode : getAllSpeciesNodes()) {
-    auto e = speciesNode->node_index;
-    _speciesLeft[e] = speciesNode->left;
-    _speciesRight[e] = speciesNode->right;
-    _speciesParent[e] = speciesNode->parent;
-  }
+  // full species tree representation, shared with the other models
+  _topology = _speciesTree.getTopologySnapshot();
   _prunedRoot = _speciesTree.getRoot();
   // pruned species tree representation
+  bool usePrunedTree = prunedMode() && _speciesCoverage.size();
+  if (usePrunedTree) {
+    auto N = getAllSpeciesNodeNumber();
+    _prunedLeft.assign(N, nullptr);
+    _prunedRight.assign(N, nullptr);
+    _prunedParent.assign(N, nullptr);
+  }
   if (_speciesCoverage.size()) {
     std::fill(_speciesToPrunedNode.begin(), _speciesToPrunedNode.end(),
               nullptr);
     for (auto speciesNode : getAllSpeciesNodes()) {
       auto e = speciesNode->node_index;
-      if (prunedMode()) {
-        _speciesLeft[e] = _speciesRight[e] = _speciesParent[e] = nullptr;
-      }
       if (!speciesNode->left) { // leaf node
         if (_speciesCoverage[e] > 0) {
           _speciesToPrunedNode[e] = speciesNode;
@@ -52,11 +54,11 @@ void BaseReconciliationModel::onSpeciesTreeChange(
         auto prunedRight = _speciesToPrunedNode[speciesNode->right->node_index];
         if (prunedLeft && prunedRight) { // the node belongs to pruned nodes
           _speciesToPrunedNode[e] = speciesNode;
-          if (prunedMode()) {
-            _speciesLeft[e] = prunedLeft;
-            _speciesRight[e] = prunedRight;
-            _speciesParent[prunedLeft->node_index] = speciesNode;
-            _speciesParent[prunedRight->node_index] = speciesNode;
+          if (usePrunedTree) {
+            _prunedLeft[e] = prunedLeft;
+            _prunedRight[e] = prunedRight;
+            _prunedParent[prunedLeft->node_index] = speciesNode;
+            _prunedParent[prunedRight->node_index] = speciesNode;
             _prunedRoot = speciesNode;
           }
         } else if (prunedLeft) { // the node maps to its left pruned child
@@ -67,22 +69,40 @@ void BaseReconciliationModel::onSpeciesTreeChange(
       }
     }
   }
-  _prunedSpeciesNodes.clear();
-  fillPrunedNodesPostOrder(getPrunedRoot(), _prunedSpeciesNodes);
+  if (usePrunedTree) {
+    _speciesLeft = &_prunedLeft;
+    _speciesRight = &_prunedRight;
+    _speciesParent = &_prunedParent;
+    _prunedPostOrder.clear();
+    fillPrunedNodesPostOrder(getPrunedRoot(), _prunedPostOrder);
+    _prunedSpeciesNodes = &_prunedPostOrder;
+  } else {
+    _speciesLeft = &_topology->left;
+    _speciesRight = &_topology->right;
+    _speciesParent = &_topology->parent;
+    _prunedSpeciesNodes = &_topology->postOrder;
+  }
   assert(getAllSpeciesNodeNumber());
   assert(getPrunedSpeciesNodeNumber());
 }
 
+void BaseReconciliationModel::updateCategoryRates(
+    const RatesVector &rates, unsigned int modelParameters) {
+  if (getCategoryNumber() == 1) {
+    assert(rates.size() == modelParameters);
+    return;
+  }
+  assert(rates.size() == modelParameters + 1);
+  assert(rates.back().size());
+  // very small shape values lead to numerical issues
+  auto alpha = std::max(0.02, rates.back()[0]);
+  corax_compute_gamma_cats(alpha, getCategoryNumber(), &_categoryRates[0],
+                           CORAX_GAMMA_RATES_MEAN);
+}
+
 void BaseReconciliationModel::initSpeciesTree() {
-  // fill the list of the species nodes
-  _allSpeciesNodes.clear();
-  fillNodesPostOrder(_speciesTree.getRoot(), _allSpeciesNodes);
-  assert(getAllSpeciesNodeNumber());
   // build the species tree structure representation
-  _speciesToPrunedNode.resize(getAllSpeciesNodeNumber(), nullptr);
-  _speciesLeft.resize(getAllSpeciesNodeNumber(), nullptr);
-  _speciesRight.resize(getAllSpeciesNodeNumber(), nullptr);
-  _speciesParent.resize(getAllSpeciesNodeNumber(), nullptr);
+  _speciesToPrunedNode.resize(_speciesTree.getNodeNumber(), nullptr);
   onSpeciesTreeChange(nullptr);
   // fill _speciesNameToId
   _speciesNameToId.clear();
@@ -93,16 +113,6 @@ void BaseReconciliationModel::initSpeciesTree() {
   }
 }
 
-void BaseReconciliationModel::fillNodesPostOrder(
-    corax_rnode_t *node, std::vector<corax_rnode_t *> &nodes) {
-  if (node->left) {
-    assert(node->right);
-    fillNodesPostOrder(node->left, nodes);
-    fillNodesPostOrder(node->right, nodes);
-  }
-  nodes.push_back(node);
-}
-
 void BaseReconciliationModel::fillPrunedNodesPostOrder(
     corax_rnode_t *node, std::vector<corax_rnode_t *> &nodes) {
   if (getSpeciesLeft(node)) {
@@ -159,8 +169,8 @@ size_t BaseReconciliationModel::getTreeHashRec(const corax_rnode_t *node,
   if (!node->left) {
     return hash_fn(node->node_index);
   }
-  auto hash1 = getTreeHashRec(_speciesLeft[node->node_index], i + 1);
-  auto hash2 = getTreeHashRec(_speciesRight[node->node_index], i + 1);
+  auto hash1 = getTreeHashRec((*_speciesLeft)[node->node_index], i + 1);
+  auto hash2 = getTreeHashRec((*_speciesRight)[node->node_index], i + 1);
   auto m = std::min(hash1, hash2);
   auto M = std::max(hash1, hash2);
   auto res = hash_fn(m * i + M);
@@ -91,16 +91,16 @@ protected:
    */
   PLLRootedTree &getSpeciesTree() { return _speciesTree; }
   unsigned int getAllSpeciesNodeNumber() const {
-    return _allSpeciesNodes.size();
+    return getAllSpeciesNodes().size();
   }
   unsigned int getPrunedSpeciesNodeNumber() const {
-    return _prunedSpeciesNodes.size();
+    return getPrunedSpeciesNodes().size();
   }
-  std::vector<corax_rnode_t *> &getAllSpeciesNodes() {
-    return _allSpeciesNodes;
+  const std::vector<corax_rnode_t *> &getAllSpeciesNodes() const {
+    return _topology->postOrder;
   }
-  std::vector<corax_rnode_t *> &getPrunedSpeciesNodes() {
-    return _prunedSpeciesNodes;
+  const std::vector<corax_rnode_t *> &getPrunedSpeciesNodes() const {
+    return *_prunedSpeciesNodes;
   }
   bool prunedMode() const { return _info.pruneSpeciesTree; }
   size_t getSpeciesTreeHash() const;
@@ -109,16 +109,33 @@ protected:
    *  Accessors to the internal species tree representation
    */
   corax_rnode_t *getSpeciesLeft(corax_rnode_t *node) {
-    return _speciesLeft[node->node_index];
+    return (*_speciesLeft)[node->node_index];
   }
   corax_rnode_t *getSpeciesRight(corax_rnode_t *node) {
-    return _speciesRight[node->node_index];
+    return (*_speciesRight)[node->node_index];
   }
   corax_rnode_t *getSpeciesParent(corax_rnode_t *node) {
-    return _speciesParent[node->node_index];
+    return (*_speciesParent)[node->node_index];
   }
   corax_rnode_t *getPrunedRoot() { return _prunedRoot; }
 
+  /**
+   *  Number of gamma categories of rate heterogeneity among families.
+   *  The model values of species node e and category c are stored
+   *  at index e * getCategoryNumber() + c
+   */
+  unsigned int getCategoryNumber() const {
+    return static_cast<unsigned int>(_categoryRates.size());
+  }
+
+  /**
+   *  Update the rate multipliers of the gamma categories. If
+   *  there are several categories, the gamma shape parameter
+   *  is stored in rates after the modelParameters model rates
+   */
+  void updateCategoryRates(const RatesVector &rates,
+                           unsigned int modelParameters);
+
   /**
    *  Return the LCA of all species covered by the gene family
    */
@@ -143,20 +160,11 @@ private:
    */
   void initSpeciesTree();
 
-  /**
-   *  Fill the nodes vector with all the children of the given node based
-   *  on the pointers of the node.
-   *  Nodes are filled in the postorder fashion.
-   *  Used to fill _allSpeciesNodes
-   */
-  void fillNodesPostOrder(corax_rnode_t *node,
-                          std::vector<corax_rnode_t *> &nodes);
-
   /**
    *  Fill the nodes vector with all the children of the given node based
    *  on the model's species tree representation.
    *  Nodes are filled in the postorder fashion.
-   *  Used to fill _prunedSpeciesNodes
+   *  Used to fill _prunedPostOrder
    */
   void fillPrunedNodesPostOrder(corax_rnode_t *node,
                                 std::vector<corax_rnode_t *> &nodes);
@@ -183,9 +191,9 @@ protected:
   RecModelInfo _info;
   // reference to the species tree
   PLLRootedTree &_speciesTree;
-  // list of all species nodes in postorder used for likelihood computation
-  std::vector<corax_rnode_t *> _allSpeciesNodes;
-  std::vector<corax_rnode_t *> _prunedSpeciesNodes;
+  // description of the full species tree, shared with all the models
+  // reading the same species tree
+  std::shared_ptr<const PLLRootedTree::TopologySnapshot> _topology;
   // map species leaf names to species leaf indices. Species leaf indices run
   // from 0 to (_speciesTree.getLeafNumber() - 1)
   std::map<std::string, unsigned int> _speciesNameToId;
@@ -202,6 +210,8 @@ protected:
   unsigned int _numberOfCoveredSpecies;
   // fraction of missing genes, indexed by species leaf indices
   std::vector<double> _fm;
+  // rate multiplier of each gamma category (mean 1.0)
+  std::vector<double> _categoryRates;
   // if true, updating a CLV will recompute its values for all species nodes
   bool _allSpeciesNodesInvalid;
   // species nodes for which values of a CLV will be recomputed on its update
@@ -209,10 +219,18 @@ protected:
   // map each species node not covered by the gene family to its closest
   // covered child if any or nullptr, covered nodes are mapped to themselves
   std::vector<corax_rnode_t *> _speciesToPrunedNode;
-  // internal representation of the current species tree. Always use these
-  // pointers to be compliant with the pruned species tree mode
-  std::vector<corax_rnode_t *> _speciesLeft;
-  std::vector<corax_rnode_t *> _speciesRight;
-  std::vector<corax_rnode_t *> _speciesParent;
+  // internal representation of the current species tree. Always use the
+  // accessors to be compliant with the pruned species tree mode. They
+  // point to the shared topology, or to the pruned species tree below
+  const std::vector<corax_rnode_t *> *_speciesLeft;
+  const std::vector<corax_rnode_t *> *_speciesRight;
+  const std::vector<corax_rnode_t *> *_speciesParent;
+  const std::vector<corax_rnode_t *> *_prunedSpeciesNodes;
   corax_rnode_t *_prunedRoot;
+  // representation of the pruned species tree, only filled in the
+  // pruned mode, once the species coverage is known
+  std::vector<corax_rnode_t *> _prunedLeft;
+  std::vector<corax_rnode_t *> _prunedRight;
+  std::vector<corax_rnode_t *> _prunedParent;
+  std::vector<corax_rnode_t *> _prunedPostOrder;
 };
@@ -24,6 +24,25 @@ public:
   virtual void invalidateCLV(unsigned int geneNodeIndex) = 0;
   virtual void enableMADRooting(bool enable) = 0;
   virtual corax_unode_t *computeMLRoot() = 0;
+
+  /**
+   *  Set the per-species branch rates and return the reconciliation
+   *  likelihood. The caller guarantees that nothing but the rates
+   *  changed since the last likelihood computation, such that
+   *  implementations can only recompute the species nodes affected
+   *  by the rates change
+   */
+  virtual double
+  computeLogLikelihoodAfterRatesChange(const RatesVector &rates) {
+    setRates(rates);
+    return computeLogLikelihood();
+  }
+
+  /**
+   *  Return true if computeLogLikelihoodAfterRatesChange only
+   *  recomputes the species nodes affected by the rates change
+   */
+  virtual bool supportsLocalRatesChange() const { return false; }
 };
 
 template <class REAL>
@@ -60,6 +79,13 @@ public:
   virtual REAL getGeneRootLikelihood(corax_unode_t *root) const = 0;
   virtual REAL getGeneRootLikelihood(corax_unode_t *root,
                                      corax_rnode_t *speciesRoot) = 0;
+  // Likelihood of the root restricted to one gamma category.
+  // Must be overloaded by the models supporting several categories
+  virtual REAL getGeneRootCategoryLikelihood(corax_unode_t *root,
+                                             unsigned int category) const {
+    (void)(category);
+    return getGeneRootLikelihood(root);
+  }
   // Called by inferMLScenario
   // fills scenario with the best likelihood set of events that
   // would lead to the subtree of geneNode under speciesNode
@@ -105,6 +131,7 @@ private:
   virtual void computeLikelihoods();
   double getSumLikelihood();
   bool _computeScenario(Scenario &scenario, bool stochastic = false);
+  unsigned int chooseScenarioCategory(bool stochastic);
 
 protected:
   corax_unode_t *_geneRoot;
@@ -124,6 +151,8 @@ protected:
   PLLUnrootedTree *_pllUnrootedTree;
   bool _madRootingEnabled;
   std::vector<double> _madProbabilities;
+  // gamma category in which the scenarios are backtraced
+  unsigned int _scenarioCategory;
 };
 
 static corax_unode_t *getOther(corax_unode_t *ref, corax_unode_t *n1,
@@ -162,7 +191,8 @@ GTBaseReconciliationModel<REAL>::GTBaseReconciliationModel(
     : GTBaseReconciliationInterface(speciesTree, geneSpeciesMapping,
                                     recModelInfo),
       _geneRoot(nullptr), _forcedGeneRoot(nullptr), _maxGeneId(1),
-      _pllUnrootedTree(nullptr), _madRootingEnabled(false) {}
+      _pllUnrootedTree(nullptr), _madRootingEnabled(false),
+      _scenarioCategory(0) {}
 
 template <class REAL>
 void GTBaseReconciliationModel<REAL>::initFromUtree(corax_utree_t *tree) {
@@ -438,7 +468,7 @@ void GTBaseReconciliationModel<REAL>::computeMLRoot(
   REAL max =
       isParsimony() ? REAL(-std::numeric_limits<double>::infinity()) : REAL();
   for (auto root : roots) {
-    for (auto speciesNode : this->_allSpeciesNodes) {
+    for (auto speciesNode : this->getAllSpeciesNodes()) {
       REAL ll = getGeneRootLikelihood(root, speciesNode);
       if (_madRootingEnabled) {
         ll *= _madProbabilities[root->node_index];
@@ -547,6 +577,7 @@ bool GTBaseReconciliationModel<REAL>::_computeScenario(Scenario &scenario,
   computeLikelihoods();
   auto ll = getSumLikelihood();
   assert(ll == 0.0 || (std::isnormal(ll) && ll <= 0.0));
+  _scenarioCategory = chooseScenarioCategory(stochastic);
 
   corax_unode_t *geneRoot = 0;
   corax_rnode_t *speciesRoot = 0;
@@ -563,6 +594,34 @@ bool GTBaseReconciliationModel<REAL>::_computeScenario(Scenario &scenario,
   return backtrace(&virtualRoot, speciesRoot, scenario, true, stochastic);
 }
 
+/**
+ *  Return the most likely gamma category, or a category sampled
+ *  according to its likelihood in stochastic mode
+ */
+template <class REAL>
+unsigned int
+GTBaseReconciliationModel<REAL>::chooseScenarioCategory(bool stochastic) {
+  auto categories = this->getCategoryNumber();
+  if (categories == 1) {
+    return 0;
+  }
+  std::vector<REAL> likelihoods(categories, REAL());
+  std::vector<corax_unode_t *> roots;
+  getRoots(roots, _geneIds);
+  for (auto root : roots) {
+    for (unsigned int c = 0; c < categories; ++c) {
+      likelihoods[c] += getGeneRootCategoryLikelihood(root, c);
+    }
+  }
+  if (stochastic) {
+    auto index = sampleIndex<std::vector<REAL>, REAL>(likelihoods);
+    return index == -1 ? 0 : static_cast<unsigned int>(index);
+  }
+  return static_cast<unsigned int>(std::distance(
+      likelihoods.begin(),
+      std::max_element(likelihoods.begin(), likelihoods.end())));
+}
+
 template <class REAL>
 bool GTBaseReconciliationModel<REAL>::backtrace(corax_unode_t *geneNode,
                                                 corax_rnode_t *speciesNode,
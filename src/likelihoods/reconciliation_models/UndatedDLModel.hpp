@@ -21,7 +21,8 @@ public:
                  const GeneSpeciesMapping &geneSpeciesMappingp,
                  const RecModelInfo &recModelInfo)
       : GTBaseReconciliationModel<REAL>(speciesTree, geneSpeciesMappingp,
-                                        recModelInfo) {}
+                                        recModelInfo),
+        _partialSpeciesUpdate(false) {}
 
   UndatedDLModel(const UndatedDLModel &) = delete;
   UndatedDLModel &operator=(const UndatedDLModel &) = delete;
@@ -31,6 +32,10 @@ public:
 
   // overloaded from parent
   virtual void setRates(const RatesVector &rates);
+  // overloaded from parent
+  virtual double
+  computeLogLikelihoodAfterRatesChange(const RatesVector &rates);
+  virtual bool supportsLocalRatesChange() const { return true; }
 
 protected:
   // overload from parent
@@ -41,10 +46,10 @@ protected:
   // overload from parent
   virtual REAL getGeneRootLikelihood(corax_unode_t *root) const;
   virtual REAL getGeneRootLikelihood(corax_unode_t *root,
-                                     corax_rnode_t *speciesRoot) {
-    return _dlclvs[root->node_index + this->_maxGeneId + 1]
-                  [speciesRoot->node_index];
-  }
+                                     corax_rnode_t *speciesRoot);
+  // overload from parent
+  virtual REAL getGeneRootCategoryLikelihood(corax_unode_t *root,
+                                             unsigned int category) const;
   // overload from parent
   virtual void recomputeSpeciesProbabilities();
   virtual REAL getLikelihoodFactor() const;
@@ -59,17 +64,45 @@ protected:
                                   bool stochastic = false);
 
 private:
-  std::vector<double> _PD; // Duplication probability, per species branch
-  std::vector<double> _PL; // Loss probability, per species branch
-  std::vector<double> _PS; // Speciation probability, per species branch
-  std::vector<double> _uE; // Extinction probability, per species branch
+  // all the values below are stored per species branch and per gamma
+  // category, the categories of a species branch being contiguous
+  std::vector<double> _PD; // Duplication probability
+  std::vector<double> _PL; // Loss probability
+  std::vector<double> _PS; // Speciation probability
+  std::vector<double> _uE; // Extinction probability
 
   typedef std::vector<REAL> DLCLV;
   std::vector<DLCLV> _dlclvs;
 
+  // Without transfers, the values of a species node only depend on the
+  // rates in its subtree. After a rates change, if _partialSpeciesUpdate
+  // is set, we only recompute the species nodes whose rates changed and
+  // their ancestors (_affectedSpeciesNodes, in postorder), for the CLVs
+  // that were valid before the change (_isCLVValid)
+  bool _partialSpeciesUpdate;
+  std::vector<corax_rnode_t *> _affectedSpeciesNodes;
+  std::vector<bool> _isCLVValid;
+
 private:
-  std::vector<corax_rnode_s *> &getSpeciesNodesToUpdate() {
-    return this->_allSpeciesNodes;
+  void setEventProbabilities(const RatesVector &rates);
+  void computeCategoryProbability(corax_unode_t *geneNode,
+                                  corax_rnode_t *speciesNode,
+                                  unsigned int category, REAL &proba,
+                                  bool isVirtualRoot = false,
+                                  Scenario::Event *event = nullptr,
+                                  bool stochastic = false);
+  const std::vector<corax_rnode_s *> &getSpeciesNodesToUpdate() const {
+    if (_partialSpeciesUpdate) {
+      return _affectedSpeciesNodes;
+    }
+    return this->getAllSpeciesNodes();
+  }
+  const std::vector<corax_rnode_s *> &
+  getSpeciesNodesToUpdate(unsigned int clvIndex) const {
+    if (_partialSpeciesUpdate && _isCLVValid[clvIndex]) {
+      return _affectedSpeciesNodes;
+    }
+    return this->getAllSpeciesNodes();
   }
 };
 
@@ -79,49 +112,116 @@ void UndatedDLModel<REAL>::setInitialGeneTree(PLLUnrootedTree &tree,
   GTBaseReconciliationModel<REAL>::setInitialGeneTree(tree, forcedGeneRoot);
   assert(this->getPrunedSpeciesNodeNumber());
   assert(this->_maxGeneId);
-  std::vector<REAL> zeros(this->getPrunedSpeciesNodeNumber());
+  std::vector<REAL> zeros(this->getPrunedSpeciesNodeNumber() *
+                          this->getCategoryNumber());
   _dlclvs = std::vector<std::vector<REAL>>(2 * (this->_maxGeneId + 1), zeros);
 }
 
 template <class REAL>
 void UndatedDLModel<REAL>::setRates(const RatesVector &rates) {
-  assert(rates.size() == 2);
+  setEventProbabilities(rates);
+  recomputeSpeciesProbabilities();
+  this->invalidateAllCLVs();
+  this->invalidateAllSpeciesCLVs();
+}
+
+template <class REAL>
+void UndatedDLModel<REAL>::setEventProbabilities(const RatesVector &rates) {
+  this->updateCategoryRates(rates, 2);
   auto &dupRates = rates[0];
   auto &lossRates = rates[1];
   assert(this->getPrunedSpeciesNodeNumber() == dupRates.size());
   assert(this->getPrunedSpeciesNodeNumber() == lossRates.size());
-  _PD = dupRates;
-  _PL = lossRates;
-  _PS = std::vector<double>(this->getPrunedSpeciesNodeNumber(), 1.0);
+  auto K = this->getCategoryNumber();
+  _PD.resize(dupRates.size() * K);
+  _PL.resize(dupRates.size() * K);
+  _PS.resize(dupRates.size() * K);
   this->_geneRoot = 0;
-  for (unsigned int e = 0; e < this->getPrunedSpeciesNodeNumber(); ++e) {
-    double sum = _PD[e] + _PL[e] + _PS[e];
-    _PD[e] /= sum;
-    _PL[e] /= sum;
-    _PS[e] /= sum;
+  for (unsigned int e = 0; e < dupRates.size(); ++e) {
+    for (unsigned int c = 0; c < K; ++c) {
+      auto ec = e * K + c;
+      _PD[ec] = dupRates[e] * this->_categoryRates[c];
+      _PL[ec] = lossRates[e] * this->_categoryRates[c];
+      double sum = _PD[ec] + _PL[ec] + 1.0;
+      _PD[ec] /= sum;
+      _PL[ec] /= sum;
+      _PS[ec] = 1.0 / sum;
+    }
+  }
+}
+
+template <class REAL>
+double UndatedDLModel<REAL>::computeLogLikelihoodAfterRatesChange(
+    const RatesVector &rates) {
+  auto previousPD = _PD;
+  auto previousPL = _PL;
+  bool partial = _uE.size() && this->_invalidatedNodes.empty() &&
+                 previousPD.size() == this->getPrunedSpeciesNodeNumber() *
+                                          this->getCategoryNumber();
+  if (!partial) {
+    setRates(rates);
+    return this->computeLogLikelihood();
+  }
+  // the CLVs computed with the previous rates
+  _isCLVValid.assign(_dlclvs.size(), false);
+  for (auto gid : this->_geneIds) {
+    _isCLVValid[gid] = this->_isCLVUpdated[gid];
+  }
+  std::vector<corax_unode_t *> roots;
+  this->getRoots(roots, this->_geneIds);
+  for (auto root : roots) {
+    _isCLVValid[root->node_index + this->_maxGeneId + 1] =
+        _isCLVValid[root->node_index] && _isCLVValid[root->back->node_index];
+  }
+  setEventProbabilities(rates);
+  auto K = this->getCategoryNumber();
+  std::vector<bool> affected(this->getAllSpeciesNodeNumber(), false);
+  _affectedSpeciesNodes.clear();
+  for (auto speciesNode : this->getPrunedSpeciesNodes()) {
+    auto e = speciesNode->node_index;
+    for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+      affected[e] = affected[e] || _PD[ec] != previousPD[ec] ||
+                    _PL[ec] != previousPL[ec];
+    }
+    if (this->getSpeciesLeft(speciesNode)) {
+      affected[e] = affected[e] ||
+                    affected[this->getSpeciesLeft(speciesNode)->node_index] ||
+                    affected[this->getSpeciesRight(speciesNode)->node_index];
+    }
+    if (affected[e]) {
+      _affectedSpeciesNodes.push_back(speciesNode);
+    }
   }
+  _partialSpeciesUpdate = true;
   recomputeSpeciesProbabilities();
   this->invalidateAllCLVs();
-  this->invalidateAllSpeciesCLVs();
+  auto res = this->computeLogLikelihood();
+  _partialSpeciesUpdate = false;
+  return res;
 }
 
 template <class REAL>
 void UndatedDLModel<REAL>::recomputeSpeciesProbabilities() {
+  auto K = this->getCategoryNumber();
   if (!_uE.size()) {
-    _uE = std::vector<double>(this->getPrunedSpeciesNodeNumber(), 0.0);
+    _uE = std::vector<double>(this->getPrunedSpeciesNodeNumber() * K, 0.0);
   }
   for (auto speciesNode : getSpeciesNodesToUpdate()) {
     auto e = speciesNode->node_index;
-    double a = _PD[e];
-    double b = -1.0;
-    double c = _PL[e];
-    if (this->getSpeciesLeft(speciesNode)) {
-      c += _PS[e] * _uE[this->getSpeciesLeft(speciesNode)->node_index] *
-           _uE[this->getSpeciesRight(speciesNode)->node_index];
+    for (unsigned int cat = 0; cat < K; ++cat) {
+      auto ec = e * K + cat;
+      double a = _PD[ec];
+      double b = -1.0;
+      double c = _PL[ec];
+      if (this->getSpeciesLeft(speciesNode)) {
+        auto f = this->getSpeciesLeft(speciesNode)->node_index;
+        auto g = this->getSpeciesRight(speciesNode)->node_index;
+        c += _PS[ec] * _uE[f * K + cat] * _uE[g * K + cat];
+      }
+      double proba = solveSecondDegreePolynome(a, b, c);
+      ASSERT_PROBA(proba)
+      _uE[ec] = proba;
     }
-    double proba = solveSecondDegreePolynome(a, b, c);
-    ASSERT_PROBA(proba)
-    _uE[speciesNode->node_index] = proba;
   }
 }
 
@@ -130,18 +230,28 @@ template <class REAL> UndatedDLModel<REAL>::~UndatedDLModel() {}
 template <class REAL>
 void UndatedDLModel<REAL>::updateCLV(corax_unode_t *geneNode) {
   assert(geneNode);
-  for (auto speciesNode : getSpeciesNodesToUpdate()) {
-    computeProbability(geneNode, speciesNode,
-                       _dlclvs[geneNode->node_index][speciesNode->node_index]);
+  auto K = this->getCategoryNumber();
+  auto &clv = _dlclvs[geneNode->node_index];
+  for (auto speciesNode : getSpeciesNodesToUpdate(geneNode->node_index)) {
+    auto e = speciesNode->node_index;
+    for (unsigned int c = 0; c < K; ++c) {
+      computeCategoryProbability(geneNode, speciesNode, c, clv[e * K + c]);
+    }
   }
 }
 
 template <class REAL>
 void UndatedDLModel<REAL>::computeProbability(
     corax_unode_t *geneNode, corax_rnode_t *speciesNode, REAL &proba,
-    bool isVirtualRoot, Scenario *, Scenario::Event *event, bool stochastic)
+    bool isVirtualRoot, Scenario *, Scenario::Event *event, bool stochastic) {
+  computeCategoryProbability(geneNode, speciesNode, this->_scenarioCategory,
+                             proba, isVirtualRoot, event, stochastic);
+}
 
-{
+template <class REAL>
+void UndatedDLModel<REAL>::computeCategoryProbability(
+    corax_unode_t *geneNode, corax_rnode_t *speciesNode, unsigned int category,
+    REAL &proba, bool isVirtualRoot, Scenario::Event *event, bool stochastic) {
   auto gid = geneNode->node_index;
   corax_unode_t *leftGeneNode = 0;
   corax_unode_t *rightGeneNode = 0;
@@ -151,6 +261,7 @@ void UndatedDLModel<REAL>::computeProbability(
     rightGeneNode = this->getRight(geneNode, isVirtualRoot);
   }
   bool isSpeciesLeaf = !this->getSpeciesLeft(speciesNode);
+  auto K = this->getCategoryNumber();
   auto e = speciesNode->node_index;
   unsigned int f = 0;
   unsigned int g = 0;
@@ -158,6 +269,10 @@ void UndatedDLModel<REAL>::computeProbability(
     f = this->getSpeciesLeft(speciesNode)->node_index;
     g = this->getSpeciesRight(speciesNode)->node_index;
   }
+  // indices of the values of the current category
+  auto ec = e * K + category;
+  auto fc = f * K + category;
+  auto gc = g * K + category;
 
   if (event) {
     event->geneNode = gid;
@@ -172,7 +287,7 @@ void UndatedDLModel<REAL>::computeProbability(
     }
     // present
     if (e == this->_geneToSpecies[gid]) {
-      proba = REAL(_PS[e]);
+      proba = REAL(_PS[ec]);
     } else {
       proba = REAL();
     }
@@ -189,37 +304,37 @@ void UndatedDLModel<REAL>::computeProbability(
     auto u_right = rightGeneNode->node_index;
     if (not isSpeciesLeaf) {
       // S event
-      values[0] = _dlclvs[u_left][f];
-      values[1] = _dlclvs[u_left][g];
-      values[0] *= _dlclvs[u_right][g];
-      values[1] *= _dlclvs[u_right][f];
-      values[0] *= _PS[e];
-      values[1] *= _PS[e];
+      values[0] = _dlclvs[u_left][fc];
+      values[1] = _dlclvs[u_left][gc];
+      values[0] *= _dlclvs[u_right][gc];
+      values[1] *= _dlclvs[u_right][fc];
+      values[0] *= _PS[ec];
+      values[1] *= _PS[ec];
       scale(values[0]);
       scale(values[1]);
       proba += values[0];
       proba += values[1];
     }
     // D event
-    values[2] = _dlclvs[u_left][e];
-    values[2] *= _dlclvs[u_right][e];
-    values[2] *= _PD[e];
+    values[2] = _dlclvs[u_left][ec];
+    values[2] *= _dlclvs[u_right][ec];
+    values[2] *= _PD[ec];
     scale(values[2]);
     proba += values[2];
   }
   if (not isSpeciesLeaf) {
     // SL event
-    values[3] = _dlclvs[gid][f];
-    values[3] *= (_uE[g] * _PS[e]);
+    values[3] = _dlclvs[gid][fc];
+    values[3] *= (_uE[gc] * _PS[ec]);
     scale(values[3]);
-    values[4] = _dlclvs[gid][g];
-    values[4] *= (_uE[f] * _PS[e]);
+    values[4] = _dlclvs[gid][gc];
+    values[4] *= (_uE[fc] * _PS[ec]);
     scale(values[4]);
     proba += values[3];
     proba += values[4];
   }
   // DL event
-  proba /= (1.0 - 2.0 * _PD[e] * _uE[e]);
+  proba /= (1.0 - 2.0 * _PD[ec] * _uE[ec]);
   // ASSERT_PROBA(proba);
 
   if (event) {
@@ -270,11 +385,40 @@ void UndatedDLModel<REAL>::computeProbability(
 
 template <class REAL>
 REAL UndatedDLModel<REAL>::getGeneRootLikelihood(corax_unode_t *root) const {
+  // average over the gamma categories
   REAL sum = REAL();
   auto u = root->node_index + this->_maxGeneId + 1;
-  for (auto speciesNode : this->_allSpeciesNodes) {
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
     auto e = speciesNode->node_index;
-    sum += _dlclvs[u][e];
+    for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+      sum += _dlclvs[u][ec];
+    }
+  }
+  return sum / double(K);
+}
+
+template <class REAL>
+REAL UndatedDLModel<REAL>::getGeneRootLikelihood(corax_unode_t *root,
+                                                 corax_rnode_t *speciesRoot) {
+  REAL sum = REAL();
+  auto u = root->node_index + this->_maxGeneId + 1;
+  auto e = speciesRoot->node_index;
+  auto K = this->getCategoryNumber();
+  for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+    sum += _dlclvs[u][ec];
+  }
+  return sum / double(K);
+}
+
+template <class REAL>
+REAL UndatedDLModel<REAL>::getGeneRootCategoryLikelihood(
+    corax_unode_t *root, unsigned int category) const {
+  REAL sum = REAL();
+  auto u = root->node_index + this->_maxGeneId + 1;
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
+    sum += _dlclvs[u][speciesNode->node_index * K + category];
   }
   return sum;
 }
@@ -283,17 +427,24 @@ template <class REAL>
 void UndatedDLModel<REAL>::computeGeneRootLikelihood(
     corax_unode_t *virtualRoot) {
   auto u = virtualRoot->node_index;
-  for (auto speciesNode : getSpeciesNodesToUpdate()) {
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : getSpeciesNodesToUpdate(u)) {
     auto e = speciesNode->node_index;
-    computeProbability(virtualRoot, speciesNode, _dlclvs[u][e], true);
+    for (unsigned int c = 0; c < K; ++c) {
+      computeCategoryProbability(virtualRoot, speciesNode, c,
+                                 _dlclvs[u][e * K + c], true);
+    }
   }
 }
 
 template <class REAL> REAL UndatedDLModel<REAL>::getLikelihoodFactor() const {
   REAL factor(0.0);
-  for (auto speciesNode : this->_allSpeciesNodes) {
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
     auto e = speciesNode->node_index;
-    factor += (REAL(1.0) - REAL(_uE[e]));
+    for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+      factor += (REAL(1.0) - REAL(_uE[ec])) / double(K);
+    }
   }
   return factor;
 }
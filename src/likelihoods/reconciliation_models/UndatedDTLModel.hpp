@@ -42,10 +42,10 @@ protected:
   // overload from parent
   virtual void computeGeneRootLikelihood(corax_unode_t *virtualRoot);
   virtual REAL getGeneRootLikelihood(corax_unode_t *root,
-                                     corax_rnode_t *speciesRoot) {
-    return _dtlclvs[root->node_index + this->_maxGeneId + 1]
-        ._uq[speciesRoot->node_index];
-  }
+                                     corax_rnode_t *speciesRoot);
+  // overloaded from parent
+  virtual REAL getGeneRootCategoryLikelihood(corax_unode_t *root,
+                                             unsigned int category) const;
   virtual REAL getLikelihoodFactor() const;
   virtual void computeProbability(corax_unode_t *geneNode,
                                   corax_rnode_t *speciesNode, REAL &proba,
@@ -55,7 +55,8 @@ protected:
                                   bool stochastic = false);
 
 private:
-  // model
+  // model. All the values are stored per branch and per gamma category,
+  // the categories of a branch being contiguous
   std::vector<double> _PD; // Duplication probability, per branch
   std::vector<double> _PL; // Loss probability, per branch
   std::vector<double> _PT; // Transfer probability, per branch
@@ -72,18 +73,19 @@ private:
    * children genes
    */
   struct DTLCLV {
-    DTLCLV() : _survivingTransferSums(REAL()) {}
+    DTLCLV() {}
 
-    DTLCLV(unsigned int speciesNumber)
-        : _uq(speciesNumber, REAL()), _correctionSum(speciesNumber, REAL()),
-          _survivingTransferSums(REAL()) {}
+    DTLCLV(unsigned int speciesNumber, unsigned int categories)
+        : _uq(speciesNumber * categories, REAL()),
+          _correctionSum(speciesNumber * categories, REAL()),
+          _survivingTransferSums(categories, REAL()) {}
     // probability of a gene node rooted at a species node
     std::vector<REAL> _uq;
     std::vector<REAL> _correctionSum;
 
-    // sum of transfer probabilities. Can be computed only once
-    // for all species, to reduce computation complexity
-    REAL _survivingTransferSums;
+    // sum of transfer probabilities, per category. Can be computed
+    // only once for all species, to reduce computation complexity
+    std::vector<REAL> _survivingTransferSums;
   };
 
   // Current DTLCLV values
@@ -92,39 +94,53 @@ private:
   std::vector<unsigned int> _orderedSpeciesRanks;
 
 private:
+  void computeCategoryProbability(corax_unode_t *geneNode,
+                                  corax_rnode_t *speciesNode,
+                                  unsigned int category, REAL &proba,
+                                  bool isVirtualRoot = false,
+                                  Scenario *scenario = nullptr,
+                                  Scenario::Event *event = nullptr,
+                                  bool stochastic = false);
   void getBestTransfer(corax_unode_t *parentGeneNode,
-                       corax_rnode_t *originSpeciesNode, bool isVirtualRoot,
-                       corax_unode_t *&transferedGene,
+                       corax_rnode_t *originSpeciesNode, unsigned int category,
+                       bool isVirtualRoot, corax_unode_t *&transferedGene,
                        corax_unode_t *&stayingGene,
                        corax_rnode_t *&recievingSpecies, REAL &proba,
                        bool stochastic = false);
   void getBestTransferLoss(Scenario &scenario, corax_unode_t *parentGeneNode,
                            corax_rnode_t *originSpeciesNode,
+                           unsigned int category,
                            corax_rnode_t *&recievingSpecies, REAL &proba,
                            bool stochastic = false);
   unsigned int getIterationsNumber() const { return 4; }
 
+  /**
+   *  speciesCategory is the index of the species in the category
+   *  (speciesId * categories + category)
+   */
   REAL getCorrectedTransferSum(unsigned int geneId,
-                               unsigned int speciesId) const {
+                               unsigned int speciesCategory,
+                               unsigned int category) const {
     switch (_transferConstraint) {
     case TransferConstaint::NONE:
-      return (_dtlclvs[geneId]._survivingTransferSums -
-              _dtlclvs[geneId]._uq[speciesId] *
-                  (1.0 / double(this->_allSpeciesNodes.size()))) *
-             _PT[speciesId];
+      return (_dtlclvs[geneId]._survivingTransferSums[category] -
+              _dtlclvs[geneId]._uq[speciesCategory] *
+                  (1.0 / double(this->getAllSpeciesNodes().size()))) *
+             _PT[speciesCategory];
     case TransferConstaint::PARENTS:
-      return (_dtlclvs[geneId]._survivingTransferSums -
-              _dtlclvs[geneId]._correctionSum[speciesId]) *
-             _PT[speciesId];
+      return (_dtlclvs[geneId]._survivingTransferSums[category] -
+              _dtlclvs[geneId]._correctionSum[speciesCategory]) *
+             _PT[speciesCategory];
     case TransferConstaint::RELDATED:
-      return _dtlclvs[geneId]._correctionSum[speciesId] * _PT[speciesId];
+      return _dtlclvs[geneId]._correctionSum[speciesCategory] *
+             _PT[speciesCategory];
     default:
       assert(false);
     }
   }
 
-  std::vector<corax_rnode_s *> &getSpeciesNodesToUpdateSafe() {
-    return this->_allSpeciesNodes;
+  const std::vector<corax_rnode_s *> &getSpeciesNodesToUpdateSafe() const {
+    return this->getAllSpeciesNodes();
   }
 };
 
@@ -132,14 +148,15 @@ template <class REAL>
 void UndatedDTLModel<REAL>::setInitialGeneTree(PLLUnrootedTree &tree,
                                                corax_unode_t *forcedGeneRoot) {
   GTBaseReconciliationModel<REAL>::setInitialGeneTree(tree, forcedGeneRoot);
-  DTLCLV nullCLV(this->_allSpeciesNodes.size());
+  DTLCLV nullCLV(this->getAllSpeciesNodes().size(),
+                 this->getCategoryNumber());
   _dtlclvs = std::vector<DTLCLV>(2 * (this->_maxGeneId + 1), nullCLV);
 }
 
 template <class REAL>
 void UndatedDTLModel<REAL>::setRates(const RatesVector &rates) {
   this->_geneRoot = 0;
-  assert(rates.size() == 3);
+  this->updateCategoryRates(rates, 3);
   auto &dupRates = rates[0];
   auto &lossRates = rates[1];
   auto &transferRates = rates[2];
@@ -148,19 +165,24 @@ void UndatedDTLModel<REAL>::setRates(const RatesVector &rates) {
   assert(this->getPrunedSpeciesNodeNumber() == lossRates.size());
   assert(this->getPrunedSpeciesNodeNumber() == transferRates.size());
   */
-  _PD = dupRates;
-  _PL = lossRates;
-  _PT = transferRates;
-  _PS.resize(_PD.size());
-  for (unsigned int e = 0; e < _PD.size(); ++e) {
-    if (this->_info.noDup) {
-      _PD[e] = 0.0;
+  auto K = this->getCategoryNumber();
+  _PD.resize(dupRates.size() * K);
+  _PL.resize(dupRates.size() * K);
+  _PT.resize(dupRates.size() * K);
+  _PS.resize(dupRates.size() * K);
+  for (unsigned int e = 0; e < dupRates.size(); ++e) {
+    for (unsigned int c = 0; c < K; ++c) {
+      auto ec = e * K + c;
+      auto categoryRate = this->_categoryRates[c];
+      _PD[ec] = this->_info.noDup ? 0.0 : dupRates[e] * categoryRate;
+      _PL[ec] = lossRates[e] * categoryRate;
+      _PT[ec] = transferRates[e] * categoryRate;
+      auto sum = _PD[ec] + _PL[ec] + _PT[ec] + 1.0;
+      _PD[ec] /= sum;
+      _PL[ec] /= sum;
+      _PT[ec] /= sum;
+      _PS[ec] = 1.0 / sum;
     }
-    auto sum = _PD[e] + _PL[e] + _PT[e] + 1.0;
-    _PD[e] /= sum;
-    _PL[e] /= sum;
-    _PT[e] /= sum;
-    _PS[e] = 1.0 / sum;
   }
   recomputeSpeciesProbabilities();
   this->invalidateAllCLVs();
@@ -182,64 +204,80 @@ void UndatedDTLModel<REAL>::recomputeSpeciesProbabilities() {
       _orderedSpeciesRanks[leaf->node_index] = rank;
     }
   }
+  auto K = this->getCategoryNumber();
   _uE.resize(_PD.size());
   for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
-    _uE[speciesNode->node_index] = 0.0;
+    auto e = speciesNode->node_index;
+    std::fill(_uE.begin() + e * K, _uE.begin() + (e + 1) * K, 0.0);
   }
-  std::vector<double> transferExtinctionSums(this->_allSpeciesNodes.size(),
-                                             REAL());
+  std::vector<double> transferExtinctionSums(
+      this->getAllSpeciesNodes().size() * K, REAL());
   for (unsigned int it = 0; it < getIterationsNumber(); ++it) {
     for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
       auto e = speciesNode->node_index;
-      if (it + 1 == getIterationsNumber() && !speciesNode->left) {
-        _uE[e] = _uE[e] * (1.0 - this->_fm[e]) + this->_fm[e];
-        continue;
-      }
-      double proba = _PL[e] + (_PD[e] * _uE[e] * _uE[e]) +
-                     _PT[e] * transferExtinctionSums[e] * _uE[e];
-      if (this->getSpeciesLeft(speciesNode)) {
-        proba += _uE[this->getSpeciesLeft(speciesNode)->node_index] *
-                 _uE[this->getSpeciesRight(speciesNode)->node_index] * _PS[e];
+      for (unsigned int c = 0; c < K; ++c) {
+        auto ec = e * K + c;
+        if (it + 1 == getIterationsNumber() && !speciesNode->left) {
+          _uE[ec] = _uE[ec] * (1.0 - this->_fm[e]) + this->_fm[e];
+          continue;
+        }
+        double proba = _PL[ec] + (_PD[ec] * _uE[ec] * _uE[ec]) +
+                       _PT[ec] * transferExtinctionSums[ec] * _uE[ec];
+        if (this->getSpeciesLeft(speciesNode)) {
+          auto fc = this->getSpeciesLeft(speciesNode)->node_index * K + c;
+          auto gc = this->getSpeciesRight(speciesNode)->node_index * K + c;
+          proba += _uE[fc] * _uE[gc] * _PS[ec];
+        }
+        _uE[ec] = proba;
       }
-      _uE[speciesNode->node_index] = proba;
     }
     std::fill(transferExtinctionSums.begin(), transferExtinctionSums.end(),
               0.0);
-    auto transferExtinctionSum = 0.0;
-    double N = this->_allSpeciesNodes.size();
+    double N = this->getAllSpeciesNodes().size();
     if (this->_transferConstraint == TransferConstaint::NONE ||
         this->_transferConstraint == TransferConstaint::PARENTS) {
       // TODO: TransferConstaint::PARENTS should have another treatment...
+      std::vector<double> transferExtinctionSum(K, 0.0);
       for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
         auto e = speciesNode->node_index;
-        transferExtinctionSum += _uE[e];
+        for (unsigned int c = 0; c < K; ++c) {
+          transferExtinctionSum[c] += _uE[e * K + c];
+        }
       }
-      transferExtinctionSum /= N;
       for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
         auto e = speciesNode->node_index;
-        transferExtinctionSums[e] = transferExtinctionSum;
+        for (unsigned int c = 0; c < K; ++c) {
+          transferExtinctionSums[e * K + c] = transferExtinctionSum[c] / N;
+        }
       }
     } else if (this->_transferConstraint == TransferConstaint::RELDATED) {
-      std::vector<double> softDatedSums(N, 0.0);
-      double softDatedSum = 0.0;
+      std::vector<double> softDatedSums(N * K, 0.0);
+      std::vector<double> softDatedSum(K, 0.0);
       for (auto leaf : this->_speciesTree.getLeaves()) {
         auto e = leaf->node_index;
-        softDatedSum += _uE[e];
+        for (unsigned int c = 0; c < K; ++c) {
+          softDatedSum[c] += _uE[e * K + c];
+        }
       }
       for (auto it = this->_orderedSpeciations.rbegin();
            it != this->_orderedSpeciations.rend(); ++it) {
         auto e = (*it)->node_index;
-        softDatedSums[e] = softDatedSum;
-        softDatedSum += _uE[e];
+        for (unsigned int c = 0; c < K; ++c) {
+          softDatedSums[e * K + c] = softDatedSum[c];
+          softDatedSum[c] += _uE[e * K + c];
+        }
       }
-      for (auto node : this->_allSpeciesNodes) {
+      for (auto node : this->getAllSpeciesNodes()) {
         auto e = node->node_index;
         auto p = node->parent ? node->parent->node_index : e;
-        transferExtinctionSums[e] = softDatedSums[p];
-        if (e != p) {
-          transferExtinctionSums[e] = transferExtinctionSums[e] - _uE[e];
+        for (unsigned int c = 0; c < K; ++c) {
+          auto ec = e * K + c;
+          transferExtinctionSums[ec] = softDatedSums[p * K + c];
+          if (e != p) {
+            transferExtinctionSums[ec] = transferExtinctionSums[ec] - _uE[ec];
+          }
+          transferExtinctionSums[ec] /= N;
         }
-        transferExtinctionSums[e] /= N;
       }
     } else {
       assert(false);
@@ -254,87 +292,99 @@ void UndatedDTLModel<REAL>::updateCLV(corax_unode_t *geneNode) {
   auto &clv = _dtlclvs[gid];
   auto &uq = clv._uq;
   auto &correctionSum = clv._correctionSum;
+  auto K = this->getCategoryNumber();
 
-  auto &parentsCache = this->_speciesTree.getParentsCache(lca);
-
-  auto N = static_cast<double>(this->_allSpeciesNodes.size());
+  auto N = static_cast<double>(this->getAllSpeciesNodes().size());
   std::fill(uq.begin(), uq.end(), REAL());
   std::fill(correctionSum.begin(), correctionSum.end(), REAL());
-  REAL sum = REAL();
-  for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
+  std::vector<REAL> sum(K, REAL());
+  // only the species nodes that are ancestors or descendants of the
+  // LCA can have a non-null probability: scan them word by word, in
+  // post order, and skip the other ones
+  auto &speciesNodes = getSpeciesNodesToUpdateSafe();
+  auto &parentsRow = this->_speciesTree.getPostOrderParentsRow(lca);
+  assert(parentsRow.size() == speciesNodes.size());
+  PLLRootedTree::forEachSetBit(parentsRow, [&](size_t i) {
+    auto speciesNode = speciesNodes[i];
     auto e = speciesNode->node_index;
-    if (parentsCache[e]) {
-      // if (ancestorsLeft[e] || ancestorsRight[e]) {
-      computeProbability(geneNode, speciesNode, uq[e]);
+    for (unsigned int c = 0; c < K; ++c) {
+      computeCategoryProbability(geneNode, speciesNode, c, uq[e * K + c]);
+      sum[c] += uq[e * K + c];
     }
-    sum += uq[e];
-    //}
-  }
+  });
   if (_transferConstraint == TransferConstaint::PARENTS) {
     auto postOrder = this->_speciesTree.getPostOrderNodes();
     for (auto it = postOrder.rbegin(); it != postOrder.rend(); ++it) {
       auto speciesNode = *it;
       auto e = speciesNode->node_index;
-      auto parent = speciesNode;
-      while (parent) {
-        auto p = parent->node_index;
-        correctionSum[e] += uq[p];
-        parent = parent->parent;
+      for (unsigned int c = 0; c < K; ++c) {
+        auto parent = speciesNode;
+        while (parent) {
+          auto p = parent->node_index;
+          correctionSum[e * K + c] += uq[p * K + c];
+          parent = parent->parent;
+        }
+        correctionSum[e * K + c] /= N;
       }
-      correctionSum[e] /= N;
     }
   }
   if (_transferConstraint == TransferConstaint::RELDATED) {
-    std::vector<REAL> softDatedSums(N, REAL());
-    std::vector<double> possibleTransfers(N, REAL());
-    double currentPossibleTransfers =
-        static_cast<double>(this->_speciesTree.getLeafNumber()) - 1.0;
-    REAL softDatedSum = REAL();
+    std::vector<REAL> softDatedSums(N * K, REAL());
+    std::vector<REAL> softDatedSum(K, REAL());
     for (auto leaf : this->_speciesTree.getLeaves()) {
       auto e = leaf->node_index;
-      softDatedSum += uq[e];
-      possibleTransfers[e] = currentPossibleTransfers;
+      for (unsigned int c = 0; c < K; ++c) {
+        softDatedSum[c] += uq[e * K + c];
+      }
     }
     for (auto it = this->_orderedSpeciations.rbegin();
          it != this->_orderedSpeciations.rend(); ++it) {
       auto node = (*it);
       auto e = node->node_index;
-      softDatedSums[e] = softDatedSum;
-      possibleTransfers[e] = currentPossibleTransfers;
-      softDatedSum += uq[e];
-      currentPossibleTransfers += 1.0;
+      for (unsigned int c = 0; c < K; ++c) {
+        softDatedSums[e * K + c] = softDatedSum[c];
+        softDatedSum[c] += uq[e * K + c];
+      }
     }
-    for (auto node : this->_allSpeciesNodes) {
+    for (auto node : this->getAllSpeciesNodes()) {
       auto e = node->node_index;
       auto p = node->parent ? node->parent->node_index : e;
-      if (e != p) {
-        correctionSum[e] = softDatedSums[p];
+      for (unsigned int c = 0; c < K; ++c) {
+        if (e != p) {
+          correctionSum[e * K + c] = softDatedSums[p * K + c];
+        }
+        correctionSum[e * K + c] /= N;
       }
-      correctionSum[e] /= N;
     }
   }
-  sum /= N;
-  clv._survivingTransferSums = sum;
+  for (unsigned int c = 0; c < K; ++c) {
+    clv._survivingTransferSums[c] = sum[c] / N;
+  }
 }
 
 template <class REAL>
 void UndatedDTLModel<REAL>::computeGeneRootLikelihood(
     corax_unode_t *virtualRoot) {
   auto u = virtualRoot->node_index;
-  _dtlclvs[u]._survivingTransferSums = REAL();
+  auto K = this->getCategoryNumber();
+  std::fill(_dtlclvs[u]._survivingTransferSums.begin(),
+            _dtlclvs[u]._survivingTransferSums.end(), REAL());
   std::fill(_dtlclvs[u]._uq.begin(), _dtlclvs[u]._uq.end(), REAL());
   /*
   auto geneLeft = this->getLeft(virtualRoot, true);
   auto geneRight = this->getRight(virtualRoot, true);
   auto lcaRight = this->_geneToSpeciesLCA[geneLeft->node_index];
   auto lcaLeft = this->_geneToSpeciesLCA[geneRight->node_index];
-  auto &ancestorsLeft = this->_speciesTree.getAncestorssCache(lcaLeft);
-  auto &ancestorsRight = this->_speciesTree.getAncestorssCache(lcaRight);
+  auto &ancestorsLeft = this->_speciesTree.getAncestorsRow(lcaLeft);
+  auto &ancestorsRight = this->_speciesTree.getAncestorsRow(lcaRight);
   */
   for (auto speciesNode : getSpeciesNodesToUpdateSafe()) {
     unsigned int e = speciesNode->node_index;
     // if (ancestorsLeft[e] || ancestorsRight[e]) {
-    computeProbability(virtualRoot, speciesNode, _dtlclvs[u]._uq[e], true);
+    for (unsigned int c = 0; c < K; ++c) {
+      computeCategoryProbability(virtualRoot, speciesNode, c,
+                                 _dtlclvs[u]._uq[e * K + c], true);
+    }
     //}
   }
 }
@@ -346,9 +396,20 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
                                                Scenario *scenario,
                                                Scenario::Event *event,
                                                bool stochastic) {
+  computeCategoryProbability(geneNode, speciesNode, this->_scenarioCategory,
+                             proba, isVirtualRoot, scenario, event,
+                             stochastic);
+}
+
+template <class REAL>
+void UndatedDTLModel<REAL>::computeCategoryProbability(
+    corax_unode_t *geneNode, corax_rnode_t *speciesNode, unsigned int category,
+    REAL &proba, bool isVirtualRoot, Scenario *scenario,
+    Scenario::Event *event, bool stochastic) {
 
   auto gid = geneNode->node_index;
   auto e = speciesNode->node_index;
+  auto K = this->getCategoryNumber();
   bool isGeneLeaf = !geneNode->next;
   bool isSpeciesLeaf = !this->getSpeciesLeft(speciesNode);
 
@@ -358,8 +419,10 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
     event->type = ReconciliationEventType::EVENT_None;
   }
 
+  // index of the values of the current category
+  auto ec = e * K + category;
   if (isSpeciesLeaf and isGeneLeaf and e == this->_geneToSpecies[gid]) {
-    proba = REAL(_PS[e]);
+    proba = REAL(_PS[ec]);
     if (event) {
       event->label = std::string(geneNode->label);
     }
@@ -386,6 +449,8 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
     f = this->getSpeciesLeft(speciesNode)->node_index;
     g = this->getSpeciesRight(speciesNode)->node_index;
   }
+  auto fc = f * K + category;
+  auto gc = g * K + category;
 
   if (not isGeneLeaf) {
     // S event
@@ -393,41 +458,41 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
     auto u_right = rightGeneNode->node_index;
     if (not isSpeciesLeaf) {
       //  speciation event
-      values[0] = _dtlclvs[u_left]._uq[f];
-      values[1] = _dtlclvs[u_left]._uq[g];
-      values[0] *= _dtlclvs[u_right]._uq[g];
-      values[1] *= _dtlclvs[u_right]._uq[f];
-      values[0] *= _PS[e];
-      values[1] *= _PS[e];
+      values[0] = _dtlclvs[u_left]._uq[fc];
+      values[1] = _dtlclvs[u_left]._uq[gc];
+      values[0] *= _dtlclvs[u_right]._uq[gc];
+      values[1] *= _dtlclvs[u_right]._uq[fc];
+      values[0] *= _PS[ec];
+      values[1] *= _PS[ec];
       scale(values[0]);
       scale(values[1]);
       proba += values[0];
       proba += values[1];
     }
     // D event
-    values[2] = _dtlclvs[u_left]._uq[e];
-    values[2] *= _dtlclvs[u_right]._uq[e];
-    values[2] *= _PD[e];
+    values[2] = _dtlclvs[u_left]._uq[ec];
+    values[2] *= _dtlclvs[u_right]._uq[ec];
+    values[2] *= _PD[ec];
     scale(values[2]);
     proba += values[2];
 
     // T event
-    values[5] = getCorrectedTransferSum(u_left, e);
-    values[5] *= _dtlclvs[u_right]._uq[e];
+    values[5] = getCorrectedTransferSum(u_left, ec, category);
+    values[5] *= _dtlclvs[u_right]._uq[ec];
     scale(values[5]);
-    values[6] = getCorrectedTransferSum(u_right, e);
-    values[6] *= _dtlclvs[u_left]._uq[e];
+    values[6] = getCorrectedTransferSum(u_right, ec, category);
+    values[6] *= _dtlclvs[u_left]._uq[ec];
     scale(values[6]);
     proba += values[5];
     proba += values[6];
   }
   if (not isSpeciesLeaf) {
     // SL event
-    values[3] = _dtlclvs[gid]._uq[f];
-    values[3] *= (_uE[g] * _PS[e]);
+    values[3] = _dtlclvs[gid]._uq[fc];
+    values[3] *= (_uE[gc] * _PS[ec]);
     scale(values[3]);
-    values[4] = _dtlclvs[gid]._uq[g];
-    values[4] *= _uE[f] * _PS[e];
+    values[4] = _dtlclvs[gid]._uq[gc];
+    values[4] *= _uE[fc] * _PS[ec];
     scale(values[4]);
     proba += values[3];
     proba += values[4];
@@ -439,8 +504,9 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
     corax_rnode_t *recievingSpecies = 0;
     values[5] = values[6] = REAL(); // invalidate these ones
     if (!isGeneLeaf) {
-      getBestTransfer(geneNode, speciesNode, isVirtualRoot, transferedGene,
-                      stayingGene, recievingSpecies, values[5], stochastic);
+      getBestTransfer(geneNode, speciesNode, category, isVirtualRoot,
+                      transferedGene, stayingGene, recievingSpecies, values[5],
+                      stochastic);
     }
     int maxValueIndex = 0;
     if (!stochastic) {
@@ -503,20 +569,52 @@ void UndatedDTLModel<REAL>::computeProbability(corax_unode_t *geneNode,
 
 template <class REAL>
 REAL UndatedDTLModel<REAL>::getGeneRootLikelihood(corax_unode_t *root) const {
+  // average over the gamma categories
   REAL sum = REAL();
   auto u = root->node_index + this->_maxGeneId + 1;
-  for (auto speciesNode : this->_allSpeciesNodes) {
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
     auto e = speciesNode->node_index;
-    sum += _dtlclvs[u]._uq[e];
+    for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+      sum += _dtlclvs[u]._uq[ec];
+    }
+  }
+  return sum / double(K);
+}
+
+template <class REAL>
+REAL UndatedDTLModel<REAL>::getGeneRootLikelihood(corax_unode_t *root,
+                                                  corax_rnode_t *speciesRoot) {
+  REAL sum = REAL();
+  auto u = root->node_index + this->_maxGeneId + 1;
+  auto e = speciesRoot->node_index;
+  auto K = this->getCategoryNumber();
+  for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+    sum += _dtlclvs[u]._uq[ec];
+  }
+  return sum / double(K);
+}
+
+template <class REAL>
+REAL UndatedDTLModel<REAL>::getGeneRootCategoryLikelihood(
+    corax_unode_t *root, unsigned int category) const {
+  REAL sum = REAL();
+  auto u = root->node_index + this->_maxGeneId + 1;
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
+    sum += _dtlclvs[u]._uq[speciesNode->node_index * K + category];
   }
   return sum;
 }
 
 template <class REAL> REAL UndatedDTLModel<REAL>::getLikelihoodFactor() const {
   REAL factor(0.0);
-  for (auto speciesNode : this->_allSpeciesNodes) {
+  auto K = this->getCategoryNumber();
+  for (auto speciesNode : this->getAllSpeciesNodes()) {
     auto e = speciesNode->node_index;
-    factor += (REAL(1.0) - REAL(_uE[e]));
+    for (auto ec = e * K; ec < (e + 1) * K; ++ec) {
+      factor += (REAL(1.0) - REAL(_uE[ec])) / double(K);
+    }
   }
   return factor;
 }
@@ -524,6 +622,7 @@ template <class REAL> REAL UndatedDTLModel<REAL>::getLikelihoodFactor() const {
 template <class REAL>
 void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
                                             corax_rnode_t *originSpeciesNode,
+                                            unsigned int category,
                                             bool isVirtualRoot,
                                             corax_unode_t *&transferedGene,
                                             corax_unode_t *&stayingGene,
@@ -533,6 +632,8 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
   ;
   proba = REAL();
   auto e = originSpeciesNode->node_index;
+  auto K = this->getCategoryNumber();
+  auto ec = e * K + category;
   std::unordered_set<unsigned int> parents;
   if (_transferConstraint == TransferConstaint::PARENTS) {
     auto parent = originSpeciesNode;
@@ -544,8 +645,8 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
   auto u_left = this->getLeft(parentGeneNode, isVirtualRoot);
   auto u_right = this->getRight(parentGeneNode, isVirtualRoot);
   std::vector<REAL> transferProbas(speciesNumber * 2, REAL());
-  double factor = _PT[e] / static_cast<double>(speciesNumber);
-  for (auto species : this->_allSpeciesNodes) {
+  double factor = _PT[ec] / static_cast<double>(speciesNumber);
+  for (auto species : this->getAllSpeciesNodes()) {
     auto h = species->node_index;
     if (_transferConstraint == TransferConstaint::PARENTS) {
       if (parents.end() != parents.find(h)) {
@@ -566,12 +667,14 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
       }
     }
 
-    transferProbas[h] = (_dtlclvs[u_left->node_index]._uq[h] *
-                         _dtlclvs[u_right->node_index]._uq[e]) *
+    auto hc = h * K + category;
+    transferProbas[h] = (_dtlclvs[u_left->node_index]._uq[hc] *
+                         _dtlclvs[u_right->node_index]._uq[ec]) *
                         factor;
-    transferProbas[h + speciesNumber] = (_dtlclvs[u_right->node_index]._uq[h] *
-                                         _dtlclvs[u_left->node_index]._uq[e]) *
-                                        factor;
+    transferProbas[h + speciesNumber] =
+        (_dtlclvs[u_right->node_index]._uq[hc] *
+         _dtlclvs[u_left->node_index]._uq[ec]) *
+        factor;
   }
   if (stochastic) {
     // stochastic sample: proba will be set to the sum of probabilities
@@ -589,7 +692,7 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
     stayingGene = !left ? u_left : u_right;
     // I am not sure I can find the species from
     // its index in the species array, so I keep it safe here
-    for (auto species : this->_allSpeciesNodes) {
+    for (auto species : this->getAllSpeciesNodes()) {
       if (species->node_index == bestIndex % speciesNumber) {
         recievingSpecies = species;
       }
@@ -597,7 +700,7 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
   } else {
     // find the max
     REAL sum = REAL();
-    for (auto species : this->_allSpeciesNodes) {
+    for (auto species : this->getAllSpeciesNodes()) {
       auto h = species->node_index;
       if (parents.end() != parents.find(h)) {
         continue;
@@ -622,26 +725,28 @@ void UndatedDTLModel<REAL>::getBestTransfer(corax_unode_t *parentGeneNode,
 template <class REAL>
 void UndatedDTLModel<REAL>::getBestTransferLoss(
     Scenario &scenario, corax_unode_t *parentGeneNode,
-    corax_rnode_t *originSpeciesNode, corax_rnode_t *&recievingSpecies,
-    REAL &proba, bool stochastic) {
+    corax_rnode_t *originSpeciesNode, unsigned int category,
+    corax_rnode_t *&recievingSpecies, REAL &proba, bool stochastic) {
   proba = REAL();
   auto e = originSpeciesNode->node_index;
   auto u = parentGeneNode->node_index;
+  auto K = this->getCategoryNumber();
+  auto ec = e * K + category;
 
   unsigned int speciesNumber = this->_speciesTree.getNodeNumber();
   ;
   std::vector<REAL> transferProbas(speciesNumber, REAL());
-  REAL factor =
-      _uE[e] * (_PT[e] / static_cast<double>(this->_allSpeciesNodes.size()));
-  for (auto species : this->_allSpeciesNodes) {
+  REAL factor = _uE[ec] * (_PT[ec] / static_cast<double>(
+                                        this->getAllSpeciesNodeNumber()));
+  for (auto species : this->getAllSpeciesNodes()) {
     auto h = species->node_index;
     if (h == e) {
       continue;
     }
-    transferProbas[h] = _dtlclvs[u]._uq[h] * factor;
+    transferProbas[h] = _dtlclvs[u]._uq[h * K + category] * factor;
   }
   if (!stochastic) {
-    for (auto species : this->_allSpeciesNodes) {
+    for (auto species : this->getAllSpeciesNodes()) {
       auto h = species->node_index;
       if (proba < transferProbas[h]) {
         if (!scenario.isBlacklisted(u, h)) {
@@ -664,7 +769,7 @@ void UndatedDTLModel<REAL>::getBestTransferLoss(
         proba = REAL();
         return;
       }
-      for (auto species : this->_allSpeciesNodes) {
+      for (auto species : this->getAllSpeciesNodes()) {
         h = species->node_index;
         if (static_cast<unsigned int>(bestIndex) == h) {
           recievingSpecies = species;
@@ -2,9 +2,10 @@
 
 #include <cmath>
 
-std::mt19937_64 Random::_rng;
-std::uniform_int_distribution<int> Random::_uniint(0);
-std::uniform_real_distribution<double> Random::_uniproba(0.0, 1.0);
+thread_local std::mt19937_64 Random::_rng;
+thread_local std::uniform_int_distribution<int> Random::_uniint(0);
+thread_local std::uniform_real_distribution<double> Random::_uniproba(0.0,
+                                                                      1.0);
 
 void Random::setSeed(unsigned int seed) { _rng.seed(seed); }
 
@@ -16,7 +16,9 @@ public:
   static double getProba();
 
 private:
-  static std::mt19937_64 _rng;
-  static std::uniform_int_distribution<int> _uniint;
-  static std::uniform_real_distribution<double> _uniproba;
+  // one generator per thread, for the threads-as-ranks backend
+  // of ParallelContext
+  static thread_local std::mt19937_64 _rng;
+  static thread_local std::uniform_int_distribution<int> _uniint;
+  static thread_local std::uniform_real_distribution<double> _uniproba;
 };
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <cmath>
 #include <corax/optimize/opt_generic.h>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <likelihoods/ReconciliationEvaluation.hpp>
@@ -9,6 +10,7 @@
 #include <optimizers/DTLOptimizer.hpp>
 #include <parallelization/ParallelContext.hpp>
 #include <parallelization/PerCoreGeneTrees.hpp>
+#include <unordered_map>
 #ifdef WITH_GSL
 #include <gsl/gsl_multimin.h>
 #endif
@@ -151,6 +153,69 @@ private:
   FunctionToOptimize &_fun;
 };
 
+/**
+ *  Gradient descent that can be run one iteration at a time, such
+ *  that several descents can be run in lockstep
+ */
+class GradientDescent {
+public:
+  /**
+   *  startingParameters must have been evaluated
+   */
+  GradientDescent(FunctionToOptimize &function,
+                  const Parameters &startingParameters,
+                  OptimizationSettings &settings)
+      : _function(function), _settings(settings),
+        _currentRates(startingParameters),
+        _gradient(startingParameters.dimensions()), _llComputationsGrad(0),
+        _llComputationsLine(0) {}
+
+  /**
+   *  Return the (independent) points to evaluate to compute
+   *  the gradient of the next iteration
+   */
+  std::vector<Parameters> getGradientPoints() const {
+    std::vector<Parameters> closeRates(_currentRates.dimensions(),
+                                       _currentRates);
+    for (unsigned int i = 0; i < closeRates.size(); ++i) {
+      closeRates[i][i] += _settings.epsilon;
+    }
+    return closeRates;
+  }
+
+  /**
+   *  Compute the gradient from the evaluated gradient points and
+   *  run the line search. Return false if the descent converged
+   */
+  bool step(const std::vector<Parameters> &closeRates) {
+    auto epsilon = _settings.epsilon;
+    _llComputationsGrad += closeRates.size();
+    for (unsigned int i = 0; i < closeRates.size(); ++i) {
+      _gradient[i] =
+          (_currentRates.getScore() - closeRates[i].getScore()) / (-epsilon);
+    }
+    double oldScore = _currentRates.getScore();
+    bool stop = !lineSearchParameters(_function, _currentRates, _gradient,
+                                      _llComputationsLine, _settings);
+    stop |= (_currentRates.getScore() - oldScore) <
+            _settings.optimizationMinImprovement;
+    if (!stop) {
+      _settings.onBetterParametersFoundCallback();
+    }
+    return !stop;
+  }
+
+  const Parameters &getCurrentRates() const { return _currentRates; }
+
+private:
+  FunctionToOptimize &_function;
+  OptimizationSettings &_settings;
+  Parameters _currentRates;
+  Parameters _gradient;
+  unsigned int _llComputationsGrad;
+  unsigned int _llComputationsLine;
+};
+
 static Parameters
 optimizeParametersGradient(FunctionToOptimize &function,
                            const Parameters &startingParameters,
@@ -158,38 +223,22 @@ optimizeParametersGradient(FunctionToOptimize &function,
   if (startingParameters.dimensions() == 0) {
     return Parameters();
   }
-  double epsilon = settings.epsilon;
   Parameters currentRates = startingParameters;
   function.evaluate(currentRates);
-  unsigned int llComputationsGrad = 0;
-  unsigned int llComputationsLine = 0;
-  unsigned int dimensions = startingParameters.dimensions();
-  Parameters gradient(dimensions);
   if (settings.verbose) {
     Logger::timed << "Starting gradient descent search" << std::endl;
-    Logger::info << "gradient epsilon=" << epsilon << std::endl;
+    Logger::info << "gradient epsilon=" << settings.epsilon << std::endl;
   }
+  GradientDescent descent(function, currentRates, settings);
   bool stop = false;
   while (!stop) {
-    std::vector<Parameters> closeRates(dimensions, currentRates);
-    for (unsigned int i = 0; i < dimensions; ++i) {
-      Parameters closeRates = currentRates;
-      closeRates[i] += epsilon;
-      function.evaluate(closeRates);
-      llComputationsGrad++;
-      gradient[i] =
-          (currentRates.getScore() - closeRates.getScore()) / (-epsilon);
-    }
-    double oldScore = currentRates.getScore();
-    stop |= !lineSearchParameters(function, currentRates, gradient,
-                                  llComputationsLine, settings);
-    stop |= (currentRates.getScore() - oldScore) <
-            settings.optimizationMinImprovement;
-    if (!stop) {
-      settings.onBetterParametersFoundCallback();
-    }
+    // the finite differences are independent from each other, and
+    // are evaluated in one batch
+    auto closeRates = descent.getGradientPoints();
+    function.evaluateBatch(closeRates);
+    stop = !descent.step(closeRates);
   }
-  auto res = currentRates;
+  auto res = descent.getCurrentRates();
   function.evaluate(res);
   if (settings.verbose) {
     Logger::timed << "opt_params=" << res << std::endl;
@@ -234,16 +283,48 @@ optimizeParametersIndividually(FunctionToOptimize &function,
   return currentParameters;
 }
 
+/**
+ *  Run rounds of individual parameter optimization until the
+ *  likelihood improvement gets too small
+ */
+static Parameters refineParametersIndividually(FunctionToOptimize &function,
+                                               Parameters res,
+                                               OptimizationSettings settings) {
+  if (res.dimensions() <= 1) {
+    return res;
+  }
+  double llDiff = 0.0;
+  unsigned int it = 0;
+  do {
+    auto ll = res.getScore();
+    res = optimizeParametersIndividually(function, res, settings);
+    llDiff = res.getScore() - ll;
+    ll = res.getScore();
+    ++it;
+    if (settings.verbose) {
+      Logger::timed << "llDiff after one round of individual opt: " << llDiff
+                    << std::endl;
+    }
+  } while (llDiff > settings.individualParamOptMinImprovement &&
+           it < settings.individualParamOptMaxIt);
+  return res;
+}
+
 class PerCoreFunction : public FunctionToOptimize {
 public:
   PerCoreFunction(PerCoreEvaluations &evaluations)
       : _evaluations(evaluations) {}
   virtual double evaluate(Parameters &parameters) {
     parameters.ensurePositivity();
+    std::vector<double> lls(_evaluations.size(), 0.0);
+    prepareTeamEvaluation();
+    ParallelContext::teamParallelFor(lls.size(), [&](unsigned int i) {
+      _evaluations[i]->setRates(parameters);
+      lls[i] = _evaluations[i]->evaluate();
+    });
     double ll = 0.0;
-    for (auto evaluation : _evaluations) {
-      evaluation->setRates(parameters);
-      ll += evaluation->evaluate();
+    for (auto familyLL : lls) {
+      ll += familyLL;
     }
     ParallelContext::sumDouble(ll);
     if (!isValidLikelihood(ll)) {
@@ -253,16 +334,254 @@ public:
     return ll;
   }
 
+  /**
+   *  Evaluate all parameter sets at once: the families are
+   *  evaluated concurrently by the team of the rank (see
+   *  ParallelContext::setTeamSize), each family for all the
+   *  sets, and the likelihoods of all sets are reduced with
+   *  one single collective
+   */
+  virtual void evaluateBatch(std::vector<Parameters> &parameters) {
+    for (auto &p : parameters) {
+      p.ensurePositivity();
+    }
+    std::vector<std::vector<double>> familyLLs(
+        _evaluations.size(), std::vector<double>(parameters.size(), 0.0));
+    prepareTeamEvaluation();
+    ParallelContext::teamParallelFor(
+        familyLLs.size(), [&](unsigned int family) {
+          auto evaluation = _evaluations[family];
+          for (unsigned int i = 0; i < parameters.size(); ++i) {
+            evaluation->setRates(parameters[i]);
+            familyLLs[family][i] = evaluation->evaluate();
+          }
+        });
+    // sum in the family order, whatever the team size
+    std::vector<double> lls(parameters.size(), 0.0);
+    for (const auto &familyLL : familyLLs) {
+      for (unsigned int i = 0; i < parameters.size(); ++i) {
+        lls[i] += familyLL[i];
+      }
+    }
+    if (lls.size()) {
+      ParallelContext::sumVectorDouble(lls);
+    }
+    for (unsigned int i = 0; i < parameters.size(); ++i) {
+      if (!isValidLikelihood(lls[i])) {
+        lls[i] = -std::numeric_limits<double>::infinity();
+      }
+      parameters[i].setScore(lls[i]);
+    }
+  }
+
 private:
+  // the team threads read the species tree concurrently
+  void prepareTeamEvaluation() {
+    if (ParallelContext::getTeamSize() > 1) {
+      for (auto evaluation : _evaluations) {
+        evaluation->getSpeciesTree().buildLazyStructures();
+      }
+    }
+  }
   PerCoreEvaluations &_evaluations;
 };
 
+/**
+ *  Memoization layer around a function: parameters that were already
+ *  evaluated (up to the tolerance) are not evaluated again.
+ *
+ *  All parallel ranks follow the same optimization path, and thus
+ *  hit the cache at the same time: the collective communications of
+ *  the wrapped function stay consistent between the ranks.
+ */
+class CachedFunction : public FunctionToOptimize {
+public:
+  CachedFunction(FunctionToOptimize &function, double tolerance = 1.0e-10,
+                 unsigned int maxEntries = 128)
+      : _function(function), _tolerance(tolerance), _maxEntries(maxEntries),
+        _hasCurrent(false) {}
+
+  virtual ~CachedFunction() {}
+
+  virtual double evaluate(Parameters &parameters) {
+    auto key = getKey(parameters);
+    auto it = _cache.find(key);
+    if (it != _cache.end()) {
+      parameters = it->second;
+      return parameters.getScore();
+    }
+    auto res = _function.evaluate(parameters);
+    save(key, parameters);
+    return res;
+  }
+
+  virtual void evaluateBatch(std::vector<Parameters> &parameters) {
+    std::vector<Parameters> misses;
+    std::vector<unsigned int> missIndices;
+    for (unsigned int i = 0; i < parameters.size(); ++i) {
+      auto it = _cache.find(getKey(parameters[i]));
+      if (it != _cache.end()) {
+        parameters[i] = it->second;
+      } else {
+        misses.push_back(parameters[i]);
+        missIndices.push_back(i);
+      }
+    }
+    if (misses.empty()) {
+      return;
+    }
+    _function.evaluateBatch(misses);
+    for (unsigned int j = 0; j < misses.size(); ++j) {
+      auto &p = parameters[missIndices[j]];
+      auto key = getKey(p);
+      p = misses[j];
+      save(key, p);
+    }
+  }
+
+  /**
+   *  Evaluating the wrapped function can have side effects (e.g.
+   *  setting the rates of the reconciliation models). Make sure
+   *  that its last evaluation was done with these parameters
+   */
+  void restore(Parameters &parameters) {
+    if (!_hasCurrent || getKey(_current) != getKey(parameters)) {
+      auto key = getKey(parameters);
+      _function.evaluate(parameters);
+      save(key, parameters);
+    }
+  }
+
+private:
+  using Key = std::vector<long long>;
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t res = 0;
+      for (auto v : key) {
+        res ^= std::hash<long long>()(v) + 0x9e3779b9 + (res << 6) +
+               (res >> 2);
+      }
+      return res;
+    }
+  };
+
+  Key getKey(const Parameters &parameters) const {
+    Key key(parameters.dimensions());
+    for (unsigned int i = 0; i < parameters.dimensions(); ++i) {
+      key[i] = std::llround(parameters[i] / _tolerance);
+    }
+    return key;
+  }
+
+  void save(const Key &key, const Parameters &evaluated) {
+    _current = evaluated;
+    _hasCurrent = true;
+    if (_cache.insert({key, evaluated}).second) {
+      _insertionOrder.push_back(key);
+    }
+    if (_insertionOrder.size() > _maxEntries) {
+      _cache.erase(_insertionOrder.front());
+      _insertionOrder.pop_front();
+    }
+  }
+
+  FunctionToOptimize &_function;
+  double _tolerance;
+  unsigned int _maxEntries;
+  std::unordered_map<Key, Parameters, KeyHash> _cache;
+  std::deque<Key> _insertionOrder;
+  // the parameters of the last evaluation of _function
+  Parameters _current;
+  bool _hasCurrent;
+};
+
+static Parameters optimizeCachedFunction(CachedFunction &function,
+                                         const Parameters &startingParameters,
+                                         OptimizationSettings settings) {
+  auto res = DTLOptimizer::optimizeParameters(function, startingParameters,
+                                              settings);
+  function.restore(res);
+  return res;
+}
+
+/**
+ *  Run one gradient descent per starting point, in lockstep: the
+ *  gradients of all running descents are evaluated in one batch.
+ *  After settings.racingMinRounds iterations, the descents that are
+ *  more than settings.racingMargin log-likelihood units behind the
+ *  best one are cancelled. Return the best parameters
+ */
+static Parameters raceGradientDescents(CachedFunction &function,
+                                       std::vector<Parameters> startingRates,
+                                       OptimizationSettings settings) {
+  function.evaluateBatch(startingRates);
+  std::vector<GradientDescent> descents;
+  for (auto &rates : startingRates) {
+    descents.push_back(GradientDescent(function, rates, settings));
+  }
+  std::vector<bool> running(descents.size(), true);
+  unsigned int runningNumber = descents.size();
+  unsigned int rounds = 0;
+  while (runningNumber) {
+    std::vector<Parameters> points;
+    std::vector<unsigned int> offsets;
+    for (unsigned int i = 0; i < descents.size(); ++i) {
+      offsets.push_back(points.size());
+      if (running[i]) {
+        auto closeRates = descents[i].getGradientPoints();
+        points.insert(points.end(), closeRates.begin(), closeRates.end());
+      }
+    }
+    offsets.push_back(points.size());
+    function.evaluateBatch(points);
+    for (unsigned int i = 0; i < descents.size(); ++i) {
+      if (running[i]) {
+        std::vector<Parameters> closeRates(points.begin() + offsets[i],
+                                           points.begin() + offsets[i + 1]);
+        running[i] = descents[i].step(closeRates);
+      }
+    }
+    rounds++;
+    double bestScore = -std::numeric_limits<double>::infinity();
+    for (auto &descent : descents) {
+      bestScore = std::max(bestScore, descent.getCurrentRates().getScore());
+    }
+    runningNumber = 0;
+    for (unsigned int i = 0; i < descents.size(); ++i) {
+      auto score = descents[i].getCurrentRates().getScore();
+      if (running[i] && rounds >= settings.racingMinRounds &&
+          bestScore - score > settings.racingMargin) {
+        if (settings.verbose) {
+          Logger::info << "Cancel the descent from " << startingRates[i]
+                       << " (ll=" << score << ", best ll=" << bestScore << ")"
+                       << std::endl;
+        }
+        running[i] = false;
+      }
+      runningNumber += running[i];
+    }
+  }
+  Parameters best;
+  best.setScore(-std::numeric_limits<double>::infinity());
+  for (auto &descent : descents) {
+    if (descent.getCurrentRates().getScore() > best.getScore()) {
+      best = descent.getCurrentRates();
+    }
+  }
+  if (settings.individualParamOpt) {
+    best = refineParametersIndividually(function, best, settings);
+  }
+  function.restore(best);
+  return best;
+}
+
 Parameters
 DTLOptimizer::optimizeParameters(PerCoreEvaluations &evaluations,
                                  const Parameters &startingParameters,
                                  OptimizationSettings settings) {
   PerCoreFunction function(evaluations);
-  return optimizeParameters(function, startingParameters, settings);
+  CachedFunction cachedFunction(function);
+  return optimizeCachedFunction(cachedFunction, startingParameters, settings);
 }
 
 ModelParameters DTLOptimizer::optimizeModelParameters(
@@ -297,10 +616,14 @@ DTLOptimizer::optimizeParametersGlobalDTL(PerCoreEvaluations &evaluations,
                                           const Parameters *startingParameters,
                                           OptimizationSettings settings) {
   unsigned int freeParameters = 0;
+  unsigned int gammaParameters = 0;
   if (evaluations.size()) {
-    freeParameters = evaluations[0]->getRecModelInfo().modelFreeParameters();
+    auto &info = evaluations[0]->getRecModelInfo();
+    freeParameters = info.modelFreeParameters();
+    gammaParameters = info.hasGammaCategories() ? 1 : 0;
   }
   ParallelContext::maxUInt(freeParameters);
+  ParallelContext::maxUInt(gammaParameters);
   if (freeParameters == 0) {
     return Parameters();
   }
@@ -308,6 +631,9 @@ DTLOptimizer::optimizeParametersGlobalDTL(PerCoreEvaluations &evaluations,
   if (startingParameters) {
     startingRates.push_back(*startingParameters);
   }
+  auto firstPreset = startingRates.size();
+  // the gamma shape parameter is appended to the presets below
+  freeParameters -= gammaParameters;
   if (freeParameters == 1) {
     Parameters p(1);
     p[0] = 0.1;
@@ -333,11 +659,24 @@ DTLOptimizer::optimizeParametersGlobalDTL(PerCoreEvaluations &evaluations,
     startingRates.push_back(Parameters(0.2, 0.2, 0.0, 0.1));
     startingRates.push_back(Parameters(0.01, 0.01, 0.01, 0.01));
   }
+  if (gammaParameters) {
+    for (auto i = firstPreset; i < startingRates.size(); ++i) {
+      startingRates[i].addValue(1.0);
+    }
+  }
   ParallelContext::barrier();
+  // share the evaluations between the different starting points
+  PerCoreFunction function(evaluations);
+  CachedFunction cachedFunction(function);
+  // only the gradient descent can be run one iteration at a time
+  if (settings.strategy == RecOpt::Gradient && startingRates.size() > 1) {
+    return raceGradientDescents(cachedFunction, startingRates, settings);
+  }
   Parameters best;
   best.setScore(-10000000000);
   for (auto rates : startingRates) {
-    Parameters newRates = optimizeParameters(evaluations, rates, settings);
+    Parameters newRates =
+        optimizeCachedFunction(cachedFunction, rates, settings);
     bool stop = (fabs(newRates.getScore() - best.getScore()) <
                  settings.optimizationMinImprovement);
     stop = false;
@@ -351,13 +690,133 @@ DTLOptimizer::optimizeParametersGlobalDTL(PerCoreEvaluations &evaluations,
   return best;
 }
 
+/**
+ *  Restriction of the per-species rates function to the blockSize
+ *  rates starting at blockOffset (the rates of one species node, or
+ *  the gamma shape parameter), the other rates being fixed.
+ *  Consecutive evaluations only differ in the block, such that the
+ *  models only recompute the species nodes affected by the block
+ */
+class PerSpeciesBlockFunction : public FunctionToOptimize {
+public:
+  PerSpeciesBlockFunction(PerCoreEvaluations &evaluations,
+                          const Parameters &allRates, unsigned int blockOffset,
+                          unsigned int blockSize)
+      : _evaluations(evaluations), _allRates(allRates),
+        _blockOffset(blockOffset), _blockSize(blockSize) {}
+
+  virtual double evaluate(Parameters &parameters) {
+    std::vector<Parameters> batch(1, parameters);
+    evaluateBatch(batch);
+    parameters = batch[0];
+    return parameters.getScore();
+  }
+
+  virtual void evaluateBatch(std::vector<Parameters> &parameters) {
+    std::vector<double> lls(parameters.size(), 0.0);
+    std::vector<Parameters> allRates;
+    for (auto &p : parameters) {
+      p.ensurePositivity();
+      allRates.push_back(getAllRates(p));
+    }
+    for (auto evaluation : _evaluations) {
+      for (unsigned int i = 0; i < allRates.size(); ++i) {
+        lls[i] += evaluation->evaluateAfterRatesChange(allRates[i]);
+      }
+    }
+    if (lls.size()) {
+      ParallelContext::sumVectorDouble(lls);
+    }
+    for (unsigned int i = 0; i < parameters.size(); ++i) {
+      if (!isValidLikelihood(lls[i])) {
+        lls[i] = -std::numeric_limits<double>::infinity();
+      }
+      parameters[i].setScore(lls[i]);
+    }
+  }
+
+  Parameters getBlockRates() const {
+    return _allRates.getSubParameters(_blockOffset, _blockSize);
+  }
+
+  Parameters getAllRates(const Parameters &blockRates) const {
+    auto res = _allRates;
+    for (unsigned int i = 0; i < _blockSize; ++i) {
+      res[_blockOffset + i] = blockRates[i];
+    }
+    res.setScore(blockRates.getScore());
+    return res;
+  }
+
+private:
+  PerCoreEvaluations &_evaluations;
+  Parameters _allRates;
+  unsigned int _blockOffset;
+  unsigned int _blockSize;
+};
+
 Parameters
 DTLOptimizer::optimizeParametersPerSpecies(PerCoreEvaluations &evaluations,
                                            unsigned int speciesNodesNumber) {
   Parameters globalRates = optimizeParametersGlobalDTL(evaluations);
-  Parameters startingSpeciesRates(speciesNodesNumber, globalRates);
-  Parameters rates =
-      DTLOptimizer::optimizeParameters(evaluations, startingSpeciesRates);
+  unsigned int gammaParameters = 0;
+  if (evaluations.size() &&
+      evaluations[0]->getRecModelInfo().hasGammaCategories()) {
+    gammaParameters = 1;
+  }
+  ParallelContext::maxUInt(gammaParameters);
+  if (globalRates.dimensions() == 0) {
+    return globalRates;
+  }
+  // per-species rates, followed by the gamma shape parameter shared
+  // by all species nodes
+  unsigned int blockSize = globalRates.dimensions() - gammaParameters;
+  Parameters rates(speciesNodesNumber,
+                   globalRates.getSubParameters(0, blockSize));
+  if (gammaParameters) {
+    rates.addValue(globalRates[blockSize]);
+  }
+  bool localRatesChange = true;
+  for (auto evaluation : evaluations) {
+    localRatesChange &= evaluation->supportsLocalRatesChange();
+  }
+  ParallelContext::parallelAnd(localRatesChange);
+  if (!localRatesChange) {
+    // the rates of one species node affect all species nodes (e.g.
+    // with transfers): a block evaluation would cost as much as a
+    // full evaluation, so we optimize all rates at once
+    Logger::info << "The reconciliation model does not support local rate "
+                    "updates, optimizing all per-species rates jointly"
+                 << std::endl;
+    return DTLOptimizer::optimizeParameters(evaluations, rates);
+  }
+  OptimizationSettings settings;
+  // start from a full likelihood computation, the evaluations
+  // only recompute what changed from then on
+  PerCoreFunction function(evaluations);
+  function.evaluate(rates);
+  // block-coordinate ascent: optimize the rates of one species node
+  // at a time, until a round over all species nodes does not improve
+  // the likelihood enough
+  double llDiff = 0.0;
+  do {
+    auto ll = rates.getScore();
+    for (unsigned int block = 0; block < speciesNodesNumber + gammaParameters;
+         ++block) {
+      auto isGammaBlock = block == speciesNodesNumber;
+      PerSpeciesBlockFunction blockFunction(
+          evaluations, rates, block * blockSize, isGammaBlock ? 1 : blockSize);
+      CachedFunction cachedFunction(blockFunction);
+      auto blockRates = optimizeCachedFunction(
+          cachedFunction, blockFunction.getBlockRates(), settings);
+      rates = blockFunction.getAllRates(blockRates);
+    }
+    llDiff = rates.getScore() - ll;
+    if (settings.verbose) {
+      Logger::timed << "Per-species rates round: ll=" << rates.getScore()
+                    << ", llDiff=" << llDiff << std::endl;
+    }
+  } while (llDiff > settings.optimizationMinImprovement);
   return rates;
 }
 
@@ -520,21 +979,8 @@ Parameters DTLOptimizer::optimizeParameters(FunctionToOptimize &function,
     assert(false);
     break;
   }
-  if (settings.individualParamOpt && startingParameters.dimensions() > 1) {
-    double llDiff = 0.0;
-    unsigned int it = 0;
-    do {
-      auto ll = res.getScore();
-      res = optimizeParametersIndividually(function, res, settings);
-      llDiff = res.getScore() - ll;
-      ll = res.getScore();
-      ++it;
-      if (settings.verbose) {
-        Logger::timed << "llDiff after one round of individual opt: " << llDiff
-                      << std::endl;
-      }
-    } while (llDiff > settings.individualParamOptMinImprovement &&
-             it < settings.individualParamOptMaxIt);
+  if (settings.individualParamOpt) {
+    res = refineParametersIndividually(function, res, settings);
   }
   return res;
 }
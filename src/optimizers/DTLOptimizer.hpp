@@ -8,6 +8,7 @@ class PerCoreGeneTrees;
 #include <memory>
 #include <string>
 #include <util/enums.hpp>
+#include <vector>
 
 class RootedTree;
 
@@ -32,7 +33,8 @@ struct OptimizationSettings {
         optimizationMinImprovement(3.0), minAlpha(0.0000001),
         startingAlpha(0.1), epsilon(0.0000001), verbose(false),
         individualParamOpt(false), individualParamOptMinImprovement(10.0),
-        individualParamOptMaxIt(3), factr(LBFGSBPrecision::HIGH) {}
+        individualParamOptMaxIt(3), racingMargin(100.0), racingMinRounds(2),
+        factr(LBFGSBPrecision::HIGH) {}
 
   RecOpt strategy;
   double lineSearchMinImprovement;
@@ -44,6 +46,13 @@ struct OptimizationSettings {
   bool individualParamOpt;
   double individualParamOptMinImprovement;
   unsigned int individualParamOptMaxIt;
+  // when optimizing from several starting points, cancel the starting
+  // points that are more than racingMargin log-likelihood units behind
+  // the best one after racingMinRounds iterations. Only used with the
+  // Gradient strategy: the other optimizers run each starting point to
+  // convergence
+  double racingMargin;
+  unsigned int racingMinRounds;
   std::vector<DTLOptimizerListener *> listeners;
   LBFGSBPrecision factr;
 
@@ -58,6 +67,17 @@ class FunctionToOptimize {
 public:
   virtual ~FunctionToOptimize() {};
   virtual double evaluate(Parameters &parameters) = 0;
+
+  /**
+   *  Evaluate several independent parameter sets and set their
+   *  scores. Implementations can override it to share the work
+   *  (and the parallel reductions) between the parameter sets
+   */
+  virtual void evaluateBatch(std::vector<Parameters> &parameters) {
+    for (auto &p : parameters) {
+      evaluate(p);
+    }
+  }
 };
 
 class DTLOptimizer {
@@ -92,6 +112,12 @@ public:
    *  @param startingParameters if not set, several preselected starting
    *                            parameters will be tried
    *  @return The parameters that maximize the function
+   *
+   *  With the Gradient strategy, the descents from the different
+   *  starting points are raced (see OptimizationSettings::racingMargin).
+   *  The LBFGSB and simplex optimizers run their iterations inside
+   *  their own loop, and optimize each starting point one after the
+   *  other without racing.
    */
   static Parameters optimizeParametersGlobalDTL(
       PerCoreEvaluations &evaluations,
@@ -108,6 +134,8 @@ public:
 
   /**
    * Finds the per-species parameters that maximize  evaluations
+   * Starts from the best global parameters, and then optimizes the
+   * parameters of one species node at a time
    *  @param evaluations the subset of functions allocated to the
    *                     current core
    *  @param speciesNodesNumber number of species nodes
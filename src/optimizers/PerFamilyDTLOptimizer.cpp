@@ -23,75 +23,102 @@ static void updateLL(Parameters &rates, JointTree &jointTree) {
   }
 }
 
-void PerFamilyDTLOptimizer::findBestRatesDL(JointTree &jointTree, double minDup,
-                                            double maxDup, double minLoss,
-                                            double maxLoss, unsigned int steps,
-                                            double &bestDup, double &bestLoss,
-                                            double &bestLL) {
-  bestLL = std::numeric_limits<double>::lowest();
-  auto totalSteps = steps * steps;
-  auto begin = ParallelContext::getBegin(totalSteps);
-  auto end = ParallelContext::getEnd(totalSteps);
-  for (auto s = begin; s < end; ++s) {
-    auto i = s / steps;
-    auto j = s % steps;
-    double dup = minDup + (maxDup - minDup) * double(i) / double(steps);
-    double loss = minLoss + (maxLoss - minLoss) * double(j) / double(steps);
-    Parameters rates(dup, loss);
-    rates.ensurePositivity();
-    jointTree.setRates(rates);
-    double newLL = jointTree.computeReconciliationLoglk();
-    if (!isValidLikelihood(newLL)) {
-      continue;
-    }
-    if (newLL > bestLL) {
-      bestDup = rates[0];
-      bestLoss = rates[1];
-      bestLL = newLL;
+/*
+ *  Evaluate the candidate rates and return the best ones.
+ *  Parallelized over the candidates
+ */
+static Parameters findBestCandidate(const std::vector<Parameters> &candidates,
+                                    JointTree &jointTree) {
+  double bestLL = std::numeric_limits<double>::lowest();
+  unsigned int bestI = 0;
+  auto begin = ParallelContext::getBegin(candidates.size());
+  auto end = ParallelContext::getEnd(candidates.size());
+  for (auto i = begin; i < end; ++i) {
+    Parameters rates = candidates[i];
+    updateLL(rates, jointTree);
+    if (rates.getScore() > bestLL) {
+      bestLL = rates.getScore();
+      bestI = i;
     }
   }
   unsigned int bestRank = 0;
   ParallelContext::getMax(bestLL, bestRank);
-  ParallelContext::broadcastDouble(bestRank, bestDup);
-  ParallelContext::broadcastDouble(bestRank, bestLoss);
-  jointTree.setRates(Parameters(bestDup, bestLoss));
+  ParallelContext::broadcastUInt(bestRank, bestI);
+  Parameters best = candidates[bestI];
+  best.ensurePositivity();
+  best.setScore(bestLL);
+  return best;
+}
+
+/*
+ *  Fill the candidates with all the points of the grid made of
+ *  steps values per dimension between minRates and maxRates
+ */
+static void fillGrid(const Parameters &minRates, const Parameters &maxRates,
+                     unsigned int steps, Parameters &current,
+                     unsigned int dimension,
+                     std::vector<Parameters> &candidates) {
+  if (dimension == current.dimensions()) {
+    candidates.push_back(current);
+    return;
+  }
+  auto width = maxRates[dimension] - minRates[dimension];
+  for (unsigned int i = 0; i < steps; ++i) {
+    current[dimension] =
+        minRates[dimension] + width * double(i) / double(steps);
+    fillGrid(minRates, maxRates, steps, current, dimension + 1, candidates);
+  }
 }
 
-void PerFamilyDTLOptimizer::findBestRatesDTL(
-    JointTree &jointTree, double minDup, double maxDup, double minLoss,
-    double maxLoss, double minTrans, double maxTrans, unsigned int steps,
-    double &bestDup, double &bestLoss, double &bestTrans, double &bestLL) {
-  bestLL = std::numeric_limits<double>::lowest();
-  unsigned int totalSteps = steps * steps * steps;
-  auto begin = ParallelContext::getBegin(totalSteps);
-  auto end = ParallelContext::getEnd(totalSteps);
-  for (auto s = begin; s < end; ++s) {
-    auto i = s / (steps * steps);
-    auto j = (s / steps) % steps;
-    auto k = s % steps;
-    double dup = minDup + (maxDup - minDup) * double(i) / double(steps);
-    double loss = minLoss + (maxLoss - minLoss) * double(j) / double(steps);
-    double trans = minTrans + (maxTrans - minTrans) * double(k) / double(steps);
-    Parameters rates(dup, loss, trans);
-    rates.ensurePositivity();
-    jointTree.setRates(rates);
-    double newLL = jointTree.computeReconciliationLoglk();
-    if (!isValidLikelihood(newLL)) {
+/*
+ *  Fill the candidates with the neighbours of center, that are
+ *  obtained by adding -spacing, 0 or +spacing to each dimension
+ */
+static void fillNeighbours(const Parameters &center, double spacing,
+                           Parameters &current, unsigned int dimension,
+                           std::vector<Parameters> &candidates) {
+  if (dimension == current.dimensions()) {
+    if (current.distance(center) > 0.0) {
+      candidates.push_back(current);
+    }
+    return;
+  }
+  for (auto offset : {-spacing, 0.0, spacing}) {
+    current[dimension] = center[dimension] + offset;
+    if (current[dimension] < 0.0) {
       continue;
     }
-    if (newLL > bestLL) {
-      bestDup = rates[0];
-      bestLoss = rates[1];
-      bestTrans = rates[2];
-      bestLL = newLL;
+    fillNeighbours(center, spacing, current, dimension + 1, candidates);
+  }
+}
+
+Parameters PerFamilyDTLOptimizer::findBestRatesAdaptiveGrid(
+    JointTree &jointTree, const Parameters &minRates,
+    const Parameters &maxRates, unsigned int steps, double minSpacing) {
+  // coarse grid over the whole range
+  std::vector<Parameters> candidates;
+  Parameters current(minRates.dimensions());
+  fillGrid(minRates, maxRates, steps, current, 0, candidates);
+  auto best = findBestCandidate(candidates, jointTree);
+  // refine around the best point: move to the best neighbour as long
+  // as it improves the likelihood, and halve the spacing otherwise
+  double spacing = (maxRates[0] - minRates[0]) / double(steps);
+  for (unsigned int i = 1; i < minRates.dimensions(); ++i) {
+    spacing = std::min(spacing, (maxRates[i] - minRates[i]) / double(steps));
+  }
+  spacing /= 2.0;
+  while (spacing > minSpacing) {
+    candidates.clear();
+    fillNeighbours(best, spacing, current, 0, candidates);
+    auto bestNeighbour = findBestCandidate(candidates, jointTree);
+    if (bestNeighbour.getScore() > best.getScore()) {
+      best = bestNeighbour;
+    } else {
+      spacing /= 2.0;
     }
   }
-  unsigned int bestRank = 0;
-  ParallelContext::getMax(bestLL, bestRank);
-  ParallelContext::broadcastDouble(bestRank, bestDup);
-  ParallelContext::broadcastDouble(bestRank, bestLoss);
-  ParallelContext::broadcastDouble(bestRank, bestTrans);
-  jointTree.setRates(Parameters(bestDup, bestLoss, bestTrans));
+  jointTree.setRates(best);
+  return best;
 }
 
 void PerFamilyDTLOptimizer::optimizeDTLRates(JointTree &jointTree,
@@ -134,29 +161,13 @@ void PerFamilyDTLOptimizer::optimizeDLRates(JointTree &jointTree,
 
 void PerFamilyDTLOptimizer::optimizeDLRatesWindow(JointTree &jointTree) {
   Logger::timed << "Start optimizing DL rates" << std::endl;
-
-  double bestLL = std::numeric_limits<double>::lowest();
-  double newLL = 0;
-  double bestDup = 0.0;
-  double bestLoss = 0.0;
-  double minDup = 0.0;
-  double maxDup = 2.0;
-  double minLoss = 0.0;
-  double maxLoss = 2.0;
-  unsigned int steps = 10;
-  double epsilon = 0.001;
-  do {
-    bestLL = newLL;
-    findBestRatesDL(jointTree, minDup, maxDup, minLoss, maxLoss, steps, bestDup,
-                    bestLoss, newLL);
-    double offsetDup = (maxDup - minDup) / steps;
-    double offsetLoss = (maxLoss - minLoss) / steps;
-    minDup = std::max(0.0, bestDup - offsetDup);
-    maxDup = bestDup + offsetDup;
-    minLoss = std::max(0.0, bestLoss - offsetLoss);
-    maxLoss = bestLoss + offsetLoss;
-  } while (fabs(newLL - bestLL) > epsilon);
-  Logger::info << " best rates: " << bestDup << " " << bestLoss << " " << newLL
+  unsigned int steps = 5;
+  double minSpacing = 0.001;
+  auto best = findBestRatesAdaptiveGrid(jointTree, Parameters(0.0, 0.0),
+                                        Parameters(2.0, 2.0), steps,
+                                        minSpacing);
+  auto newLL = best.getScore();
+  Logger::info << " best rates: " << best[0] << " " << best[1] << " " << newLL
                << std::endl;
   if (!isValidLikelihood(newLL)) {
     Logger::error << "Invalid likelihood " << newLL << std::endl;
@@ -166,33 +177,12 @@ void PerFamilyDTLOptimizer::optimizeDLRatesWindow(JointTree &jointTree) {
 
 void PerFamilyDTLOptimizer::optimizeDTLRatesWindow(JointTree &jointTree) {
   Logger::timed << "Start optimizing DTL rates" << std::endl;
-  double bestLL = std::numeric_limits<double>::lowest();
-  double newLL = 0;
-  double bestDup = 0.0;
-  double bestLoss = 0.0;
-  double bestTrans = 0.0;
-  double minDup = 0.0;
-  double maxDup = 1.0;
-  double minLoss = 0.0;
-  double maxLoss = 1.0;
-  double minTrans = 0.0;
-  double maxTrans = 1.0;
-  unsigned int steps = 5;
-  double epsilon = 0.01;
-  do {
-    bestLL = newLL;
-    findBestRatesDTL(jointTree, minDup, maxDup, minLoss, maxLoss, minTrans,
-                     maxTrans, steps, bestDup, bestLoss, bestTrans, newLL);
-    double offsetDup = (maxDup - minDup) / steps;
-    double offsetLoss = (maxLoss - minLoss) / steps;
-    double offsetTrans = (maxTrans - minTrans) / steps;
-    minDup = std::max(0.0, bestDup - offsetDup);
-    maxDup = bestDup + offsetDup;
-    minLoss = std::max(0.0, bestLoss - offsetLoss);
-    maxLoss = bestLoss + offsetLoss;
-    minTrans = std::max(0.0, bestTrans - offsetTrans);
-    maxTrans = bestTrans + offsetTrans;
-  } while (fabs(newLL - bestLL) > epsilon);
+  unsigned int steps = 4;
+  double minSpacing = 0.001;
+  auto best = findBestRatesAdaptiveGrid(jointTree, Parameters(0.0, 0.0, 0.0),
+                                        Parameters(1.0, 1.0, 1.0), steps,
+                                        minSpacing);
+  auto newLL = best.getScore();
   if (!isValidLikelihood(newLL)) {
     Logger::error << "Invalid likelihood " << newLL << std::endl;
     ParallelContext::abort(10);
@@ -2,6 +2,7 @@
 
 class JointTree;
 #include <likelihoods/ReconciliationEvaluation.hpp>
+#include <maths/Parameters.hpp>
 #include <string>
 #include <util/enums.hpp>
 
@@ -15,17 +16,19 @@ public:
   static void optimizeDTLRates(JointTree &jointTree, RecOpt method);
 
 private:
-  static void findBestRatesDTL(JointTree &jointTree, double minDup,
-                               double maxDup, double minLoss, double maxLoss,
-                               double minTrans, double maxTrans,
-                               unsigned int steps, double &bestDup,
-                               double &bestLoss, double &bestTrans,
-                               double &bestLL);
+  /**
+   * Coarse-to-fine search of the rates maximizing the family
+   * likelihood: a coarse grid with steps values per dimension
+   * between minRates and maxRates, followed by a pattern search
+   * around the best point, until the spacing between the points
+   * gets below minSpacing. Set and return the best rates.
+   */
+  static Parameters findBestRatesAdaptiveGrid(JointTree &jointTree,
+                                              const Parameters &minRates,
+                                              const Parameters &maxRates,
+                                              unsigned int steps,
+                                              double minSpacing);
 
-  static void findBestRatesDL(JointTree &jointTree, double minDup,
-                              double maxDup, double minLoss, double maxLoss,
-                              unsigned int steps, double &bestDup,
-                              double &bestLoss, double &bestLL);
   static void optimizeRateSimplex(JointTree &jointTree, bool transfers);
   static void optimizeDLRatesWindow(JointTree &jointTree);
   static void optimizeDTLRatesWindow(JointTree &jointTree);
@@ -3,7 +3,7 @@
 #include "DTLOptimizer.hpp"
 #include <IO/FileSystem.hpp>
 #include <algorithm>
-#include <cstdio>
+#include <chrono>
 #include <fstream>
 #include <routines/Routines.hpp>
 #include <search/SpeciesSPRSearch.hpp>
@@ -34,11 +34,15 @@ SpeciesTreeOptimizer::SpeciesTreeOptimizer(
       _firstOptimizeRatesCall(true), _userDTLRates(userDTLRates),
       _modelRates(startingRates, 1, recModelInfo), _searchParams(searchParams),
       _okForClades(0), _koForClades(0),
+      _previousTeamSize(ParallelContext::getTeamSize()),
       _searchState(
           *_speciesTree,
           Paths::getSpeciesTreeFile(_outputDir, "inferred_species_tree.newick"),
           _geneTrees->getTrees().size()) {
 
+  if (_searchParams.threadsPerRank != _previousTeamSize) {
+    ParallelContext::setTeamSize(_searchParams.threadsPerRank);
+  }
   _modelRates.info.perFamilyRates = false; // we set it back a few
                                            // lines later
   updateEvaluations();
@@ -65,6 +69,7 @@ void SpeciesTreeOptimizer::optimize(SpeciesSearchStrategy strategy) {
   switch (strategy) {
   case SpeciesSearchStrategy::SPR:
     for (unsigned int radius = 1; radius <= _searchParams.sprRadius; ++radius) {
+      rebalanceFamilies();
       _searchState.bestLL = _evaluator.optimizeModelRates();
       sprSearch(radius);
     }
@@ -87,6 +92,7 @@ void SpeciesTreeOptimizer::optimize(SpeciesSearchStrategy strategy) {
       rootSearch(_searchParams.rootSmallRadius, false);
     }
     do {
+      rebalanceFamilies();
       if (index++ % 2 == 0) {
         transferSearch();
       } else {
@@ -115,6 +121,9 @@ void SpeciesTreeOptimizer::optimize(SpeciesSearchStrategy strategy) {
 
 SpeciesTreeOptimizer::~SpeciesTreeOptimizer() {
   _speciesTree->removeListener(this);
+  if (ParallelContext::getTeamSize() != _previousTeamSize) {
+    ParallelContext::setTeamSize(_previousTeamSize);
+  }
 }
 
 double SpeciesTreeOptimizer::rootSearch(unsigned int maxDepth,
@@ -213,11 +222,33 @@ void SpeciesTreeOptimizer::updateEvaluations() {
   }
   _previousGeneRoots.resize(_evaluations.size());
   std::fill(_previousGeneRoots.begin(), _previousGeneRoots.end(), nullptr);
-  _evaluator.init(_evaluations, *_geneTrees, _modelRates,
-                  _modelRates.info.rootedGeneTree,
+  _evaluator.init(_evaluations, _speciesTree->getTree(), *_geneTrees,
+                  _modelRates, _modelRates.info.rootedGeneTree,
                   _modelRates.info.pruneSpeciesTree, _userDTLRates);
 }
 
+void SpeciesTreeOptimizer::rebalanceFamilies() {
+  if (ParallelContext::getSize() == 1 || _modelRates.info.perFamilyRates) {
+    // per-family rates are indexed with the local families
+    return;
+  }
+  // do not move the families before we measured enough
+  const double minMeasuredTime = 10.0;
+  const double minGain = 0.1;
+  const auto &times = _evaluator.getEvaluationTimes();
+  double maxTime = std::accumulate(times.begin(), times.end(), 0.0);
+  unsigned int maxRank = 0;
+  ParallelContext::getMax(maxTime, maxRank);
+  if (maxTime < minMeasuredTime) {
+    return;
+  }
+  if (_geneTrees->rebalance(_initialFamilies, times, minGain)) {
+    updateEvaluations();
+    _searchState.setLocalFamilies(_geneTrees->getGlobalIndices());
+  }
+  _evaluator.resetEvaluationTimes();
+}
+
 void SpeciesTreeOptimizer::onSpeciesDatesChange() {
   for (auto &evaluation : _evaluations) {
     evaluation->onSpeciesDatesChange();
@@ -231,13 +262,7 @@ void SpeciesTreeOptimizer::onSpeciesTreeChange(
   }
 }
 
-std::string getCladesSetPath(const std::string &outputDir, int rank) {
-  std::string basePath = "clades_" + std::to_string(rank) + ".txt";
-  return FileSystem::joinPaths(outputDir, basePath);
-}
-
 void SpeciesTreeOptimizer::_computeAllGeneClades() {
-  ParallelContext::barrier();
   // Compute local clades
   auto speciesLabelToInt = _speciesTree->getTree().getLeafLabelToId();
   CladeSet allClades;
@@ -246,25 +271,16 @@ void SpeciesTreeOptimizer::_computeAllGeneClades() {
         Clade::buildCladeSet(*tree.geneTree, tree.mapping, speciesLabelToInt);
     allClades.insert(cladesSet.begin(), cladesSet.end());
   }
-  // Write local clades
-  std::ofstream os(getCladesSetPath(_outputDir, ParallelContext::getRank()));
-  for (auto clade : allClades) {
-    os << clade << " ";
-  }
-  os.close();
-  ParallelContext::barrier();
-  // Load all clades
-  _geneClades.clear();
-  for (unsigned int rank = 0; rank < ParallelContext::getSize(); ++rank) {
-    std::ifstream is(getCladesSetPath(_outputDir, rank));
-    unsigned int clade = 0;
-    while (is >> clade) {
-      _geneClades.insert(clade);
-    }
-  }
+  // Gather the sorted clades of all ranks, and merge them
+  std::vector<unsigned long> localClades(allClades.begin(), allClades.end());
+  std::vector<unsigned long> globalClades;
+  ParallelContext::concatenateHeterogeneousULongVectors(localClades,
+                                                        globalClades);
+  std::sort(globalClades.begin(), globalClades.end());
+  auto last = std::unique(globalClades.begin(), globalClades.end());
+  // the input is sorted: the set is built in linear time
+  _geneClades = CladeSet(globalClades.begin(), last);
   assert(ParallelContext::isIntEqual(_geneClades.size()));
-  ParallelContext::barrier();
-  std::remove(getCladesSetPath(_outputDir, ParallelContext::getRank()).c_str());
 }
 
 unsigned int SpeciesTreeOptimizer::_unsupportedCladesNumber() {
@@ -273,19 +289,6 @@ unsigned int SpeciesTreeOptimizer::_unsupportedCladesNumber() {
   return speciesClades.size() - intersectionSize;
 }
 
-static std::string getSubtreeID(corax_rnode_t *subtree) {
-  if (!subtree->left) {
-    return std::string(subtree->label);
-  }
-  std::string res("(");
-  std::string id1 = getSubtreeID(subtree->left);
-  std::string id2 = getSubtreeID(subtree->right);
-  if (id1 > id2) {
-    std::swap(id1, id2);
-  }
-  return std::string("(") + id1 + "," + id2 + ")";
-}
-
 void SpeciesTreeOptimizer::savePerFamilyLikelihoods(
     const TreePerFamLLVec &treePerFamLLVec, const std::string &treesOutput,
     const std::string &llOutput) {
@@ -314,30 +317,51 @@ void SpeciesTreeOptimizer::savePerFamilyLikelihoods(
 }
 
 double SpeciesTreeLikelihoodEvaluator::computeLikelihood(PerFamLL *perFamLL) {
+  auto sumLL = computeLocalLikelihood(perFamLL);
+  ParallelContext::sumDouble(sumLL);
+  return sumLL;
+}
+
+double
+SpeciesTreeLikelihoodEvaluator::computeLocalLikelihood(PerFamLL *perFamLL) {
   if (_rootedGeneTrees) {
     for (auto evaluation : *_evaluations) {
       evaluation->setRoot(nullptr);
     }
   }
+  if (ParallelContext::getTeamSize() > 1) {
+    // the families are evaluated concurrently by the team
+    _speciesTree->buildLazyStructures();
+  }
+  std::vector<double> lls(_evaluations->size(), 0.0);
+  ParallelContext::teamParallelFor(lls.size(), [&](unsigned int i) {
+    auto start = std::chrono::steady_clock::now();
+    lls[i] = (*_evaluations)[i]->evaluate();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    _evaluationTimes[i] += elapsed.count();
+  });
   if (perFamLL) {
-    perFamLL->clear();
+    *perFamLL = lls;
   }
   double sumLL = 0.0;
-  for (auto &evaluation : *_evaluations) {
-    auto ll = evaluation->evaluate();
-    if (perFamLL) {
-      perFamLL->push_back(ll);
-    }
+  for (auto ll : lls) {
     sumLL += ll;
   }
-  ParallelContext::sumDouble(sumLL);
   return sumLL;
 }
 
 double SpeciesTreeLikelihoodEvaluator::computeLikelihoodFast() {
+  if (ParallelContext::getTeamSize() > 1) {
+    // the families are evaluated concurrently by the team
+    _speciesTree->buildLazyStructures();
+  }
+  std::vector<double> lls(_evaluations->size(), 0.0);
+  ParallelContext::teamParallelFor(lls.size(), [&](unsigned int i) {
+    lls[i] = (*_evaluations)[i]->evaluate();
+  });
   double sumLL = 0.0;
-  for (auto &evaluation : *_evaluations) {
-    auto ll = evaluation->evaluate();
+  for (auto ll : lls) {
     sumLL += ll;
   }
   ParallelContext::sumDouble(sumLL);
@@ -32,10 +32,13 @@ struct SpeciesTreeSearchParams {
   SpeciesTreeSearchParams()
       : sprRadius(DEFAULT_SPECIES_SPR_RADIUS),
         rootSmallRadius(DEFAULT_SPECIES_SMALL_ROOT_RADIUS),
-        rootBigRadius(DEFAULT_SPECIES_BIG_ROOT_RADIUS) {}
+        rootBigRadius(DEFAULT_SPECIES_BIG_ROOT_RADIUS), threadsPerRank(1) {}
   unsigned int sprRadius;
   unsigned int rootSmallRadius;
   unsigned int rootBigRadius;
+  // size of the thread team of each rank during the search
+  // (see ParallelContext::setTeamSize)
+  unsigned int threadsPerRank;
 };
 
 struct MovesBlackList;
@@ -44,15 +47,17 @@ class SpeciesTreeLikelihoodEvaluator
     : public SpeciesTreeLikelihoodEvaluatorInterface {
 public:
   SpeciesTreeLikelihoodEvaluator() {}
-  void init(PerCoreEvaluations &evaluations, PerCoreGeneTrees &geneTrees,
-            ModelParameters &modelRates, bool rootedGeneTrees,
-            bool pruneSpeciesTree, bool userDTLRates) {
+  void init(PerCoreEvaluations &evaluations, PLLRootedTree &speciesTree,
+            PerCoreGeneTrees &geneTrees, ModelParameters &modelRates,
+            bool rootedGeneTrees, bool pruneSpeciesTree, bool userDTLRates) {
     _evaluations = &evaluations;
+    _speciesTree = &speciesTree;
     _geneTrees = &geneTrees;
     _modelRates = &modelRates;
     _rootedGeneTrees = rootedGeneTrees;
     _pruneSpeciesTree = pruneSpeciesTree;
     _userDTLRates = userDTLRates;
+    resetEvaluationTimes();
   }
   virtual ~SpeciesTreeLikelihoodEvaluator() {}
   virtual double computeLikelihood(PerFamLL *perFamLL = nullptr);
@@ -69,14 +74,34 @@ public:
                          PerCorePotentialTransfers &potentialTransfers);
   virtual bool pruneSpeciesTree() const { return _pruneSpeciesTree; }
 
+  /**
+   *  Time (in seconds) spent evaluating each family of the current
+   *  parallel core since the last resetEvaluationTimes call
+   */
+  const std::vector<double> &getEvaluationTimes() const {
+    return _evaluationTimes;
+  }
+  void resetEvaluationTimes() {
+    _evaluationTimes.assign(_evaluations->size(), 0.0);
+  }
+
 private:
+  /**
+   *  Likelihood of the families of the current parallel core,
+   *  without reduction over the cores
+   */
+  double computeLocalLikelihood(PerFamLL *perFamLL);
+
   PerCoreGeneTrees *_geneTrees;
   PerCoreEvaluations *_evaluations;
+  // shared by the evaluations
+  PLLRootedTree *_speciesTree;
   ModelParameters *_modelRates;
   std::stack<std::vector<corax_unode_t *>> _previousGeneRoots;
   bool _rootedGeneTrees;
   bool _pruneSpeciesTree;
   bool _userDTLRates;
+  std::vector<double> _evaluationTimes;
 };
 
 class SpeciesTreeOptimizer : public SpeciesTree::Listener {
@@ -133,12 +158,15 @@ private:
   SpeciesTreeSearchParams _searchParams;
   unsigned int _okForClades;
   unsigned int _koForClades;
+  // team size to restore at the end of the search
+  unsigned int _previousTeamSize;
   SpeciesSearchState _searchState;
 
 private:
   void _computeAllGeneClades();
   unsigned int _unsupportedCladesNumber();
   void updateEvaluations();
+  void rebalanceFamilies();
   std::string getSpeciesTreePath(const std::string &speciesId);
   void reGenerateEvaluations();
   double transferSearch();
@@ -7,14 +7,147 @@
 
 #include <IO/Logger.hpp>
 #include <maths/Random.hpp>
+#include <atomic>
+#include <parallelization/ThreadComm.hpp>
+#include <parallelization/ThreadTeam.hpp>
+#include <thread>
 
 std::ofstream ParallelContext::sink("/dev/null");
 bool ParallelContext::ownMPIContext(true);
 std::stack<MPI_Comm> ParallelContext::_commStack;
 std::stack<bool> ParallelContext::_ownsMPIContextStack;
 bool ParallelContext::_mpiEnabled = false;
+thread_local std::stack<ParallelContext::DynamicTasks>
+    ParallelContext::_dynamicTasks;
+thread_local std::stack<ParallelContext::ThreadRank>
+    ParallelContext::_threadRanks;
+thread_local std::unique_ptr<ThreadTeam> ParallelContext::_team;
+thread_local ThreadTeam *ParallelContext::_currentTeam = nullptr;
+thread_local unsigned int ParallelContext::_teamThread = 0;
+
+template <typename T>
+void ParallelContext::threadAllGather(const std::vector<T> &localValues,
+                                      std::vector<std::vector<T>> &allValues) {
+  auto &threadRank = _threadRanks.top();
+  threadRank.comm->allGather(threadRank.rank, localValues, allValues);
+}
+
+template <typename T>
+void ParallelContext::threadConcatenate(const std::vector<T> &localVector,
+                                        std::vector<T> &globalVector) {
+  std::vector<std::vector<T>> allVectors;
+  threadAllGather(localVector, allVectors);
+  globalVector.clear();
+  for (const auto &v : allVectors) {
+    globalVector.insert(globalVector.end(), v.begin(), v.end());
+  }
+}
+
+template <typename T, typename Op>
+void ParallelContext::threadReduce(std::vector<T> &values, Op op) {
+  std::vector<std::vector<T>> allValues;
+  threadAllGather(values, allValues);
+  // all threads reduce in the same order and get the same result
+  values = allValues[0];
+  for (unsigned int rank = 1; rank < allValues.size(); ++rank) {
+    assert(allValues[rank].size() == values.size());
+    for (unsigned int i = 0; i < values.size(); ++i) {
+      values[i] = op(values[i], allValues[rank][i]);
+    }
+  }
+}
+
+template <typename T>
+void ParallelContext::threadBroadcast(unsigned int fromRank, T &value) {
+  std::vector<std::vector<T>> allValues;
+  threadAllGather(std::vector<T>(1, value), allValues);
+  value = allValues[fromRank][0];
+}
+
+void ParallelContext::runThreadRanks(unsigned int threads,
+                                     const std::function<void()> &function) {
+  assert(threads);
+  auto comm = std::make_shared<ThreadComm>(threads);
+  auto runRank = [comm, &function](unsigned int rank) {
+    _threadRanks.push(ThreadRank{comm, rank});
+    function();
+    _threadRanks.pop();
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int rank = 1; rank < threads; ++rank) {
+    workers.push_back(std::thread(runRank, rank));
+  }
+  runRank(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void ParallelContext::setTeamSize(unsigned int threads) {
+  assert(threads);
+  assert(!_currentTeam);
+  _team.reset();
+  if (threads > 1) {
+    _team = std::make_unique<ThreadTeam>(threads);
+  }
+}
+
+unsigned int ParallelContext::getTeamSize() {
+  return _team ? _team->getSize() : 1;
+}
+
+void ParallelContext::teamRun(
+    const std::function<void(unsigned int)> &function) {
+  assert(!_currentTeam);
+  if (!_team) {
+    function(0);
+    return;
+  }
+  auto team = _team.get();
+  team->run([team, &function](unsigned int thread) {
+    _currentTeam = team;
+    _teamThread = thread;
+    function(thread);
+    _currentTeam = nullptr;
+    _teamThread = 0;
+  });
+}
+
+void ParallelContext::teamParallelFor(
+    unsigned int elems, const std::function<void(unsigned int)> &function) {
+  std::atomic<unsigned int> next(0);
+  teamRun([&](unsigned int) {
+    for (auto i = next++; i < elems; i = next++) {
+      function(i);
+    }
+  });
+}
+
+unsigned int ParallelContext::getTeamThread() { return _teamThread; }
+
+void ParallelContext::teamBarrier() {
+  if (_currentTeam) {
+    _currentTeam->getComm().barrier();
+  }
+}
+
+void ParallelContext::teamSumDouble(double &value) {
+  if (!_currentTeam) {
+    return;
+  }
+  std::vector<std::vector<double>> allValues;
+  _currentTeam->getComm().allGather(_teamThread, std::vector<double>(1, value),
+                                    allValues);
+  value = 0.0;
+  for (const auto &threadValue : allValues) {
+    value += threadValue[0];
+  }
+}
 
 void ParallelContext::init(void *commPtr) {
+  if (isThreadRank()) {
+    return;
+  }
   if (commPtr && *static_cast<int *>(commPtr) == -1) {
     _mpiEnabled = false;
     Logger::info << "Warning: this program was compiled without MPI. Make sure "
@@ -44,7 +177,7 @@ void ParallelContext::init(void *commPtr) {
 }
 
 void ParallelContext::finalize() {
-  if (!_mpiEnabled) {
+  if (isThreadRank() || !_mpiEnabled) {
     return;
   }
 #ifdef WITH_MPI
@@ -59,6 +192,10 @@ void ParallelContext::finalize() {
 }
 
 void ParallelContext::pushSequentialContext() {
+  if (isThreadRank()) {
+    _threadRanks.push(ThreadRank{std::make_shared<ThreadComm>(1), 0});
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -71,6 +208,11 @@ void ParallelContext::pushSequentialContext() {
 }
 
 void ParallelContext::popContext() {
+  if (isThreadRank()) {
+    _threadRanks.pop();
+    assert(isThreadRank());
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -82,6 +224,9 @@ void ParallelContext::popContext() {
 }
 
 unsigned int ParallelContext::getRank() {
+  if (isThreadRank()) {
+    return _threadRanks.top().rank;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return 0;
@@ -95,6 +240,9 @@ unsigned int ParallelContext::getRank() {
 }
 
 unsigned int ParallelContext::getSize() {
+  if (isThreadRank()) {
+    return _threadRanks.top().comm->getSize();
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return 1;
@@ -130,49 +278,139 @@ unsigned int ParallelContext::getEnd(unsigned int elems) {
   return std::min(elems, ((getRank() + 1) * elems) / getSize());
 }
 
+void ParallelContext::startDynamicTasks() {
+  _dynamicTasks.push(DynamicTasks());
+  auto &tasks = _dynamicTasks.top();
+  tasks.localCounter = 0;
+  tasks.counter = &tasks.localCounter;
+  if (isThreadRank()) {
+    auto &threadRank = _threadRanks.top();
+    tasks.threadComm = threadRank.comm;
+    if (threadRank.rank == 0) {
+      threadRank.comm->getTasksCounter() = 0;
+    }
+    barrier();
+    return;
+  }
+  if (!_mpiEnabled) {
+    return;
+  }
+#ifdef WITH_MPI
+  // the counter lives in the window of rank 0
+  MPI_Aint size = getRank() == 0 ? sizeof(unsigned int) : 0;
+  MPI_Win_allocate(size, sizeof(unsigned int), MPI_INFO_NULL, getComm(),
+                   &tasks.counter, &tasks.window);
+  MPI_Win_lock_all(0, tasks.window);
+  if (getRank() == 0) {
+    *tasks.counter = 0;
+    MPI_Win_sync(tasks.window);
+  }
+  barrier();
+#else
+  assert(false);
+#endif
+}
+
+unsigned int ParallelContext::getNextTask() {
+  assert(_dynamicTasks.size());
+  auto &tasks = _dynamicTasks.top();
+  if (tasks.threadComm) {
+    return tasks.threadComm->getTasksCounter()++;
+  }
+  if (!_mpiEnabled) {
+    return (*tasks.counter)++;
+  }
+#ifdef WITH_MPI
+  unsigned int one = 1;
+  unsigned int task = 0;
+  MPI_Fetch_and_op(&one, &task, MPI_UNSIGNED, 0, 0, MPI_SUM, tasks.window);
+  MPI_Win_flush(0, tasks.window);
+  return task;
+#else
+  assert(false);
+  return 0;
+#endif
+}
+
+void ParallelContext::endDynamicTasks() {
+  assert(_dynamicTasks.size());
+  if (isThreadRank()) {
+    // the counter must not be reset before all threads are done
+    barrier();
+    _dynamicTasks.pop();
+    return;
+  }
+  if (_mpiEnabled) {
+#ifdef WITH_MPI
+    auto &tasks = _dynamicTasks.top();
+    MPI_Win_unlock_all(tasks.window);
+    MPI_Win_free(&tasks.window);
+#endif
+  }
+  _dynamicTasks.pop();
+}
+
 void ParallelContext::sumDouble(double &value) {
+  if (isThreadRank()) {
+    std::vector<double> values(1, value);
+    threadReduce(values, std::plus<double>());
+    value = values[0];
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   double sum = 0;
-  barrier();
   MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, getComm());
   value = sum;
 #endif
 }
 
 void ParallelContext::sumUInt(unsigned int &value) {
+  if (isThreadRank()) {
+    std::vector<unsigned int> values(1, value);
+    threadReduce(values, std::plus<unsigned int>());
+    value = values[0];
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   unsigned int sum = 0;
-  barrier();
   MPI_Allreduce(&value, &sum, 1, MPI_UNSIGNED, MPI_SUM, getComm());
   value = sum;
 #endif
 }
 
 void ParallelContext::sumULong(unsigned long &value) {
+  if (isThreadRank()) {
+    std::vector<unsigned long> values(1, value);
+    threadReduce(values, std::plus<unsigned long>());
+    value = values[0];
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   unsigned long sum = 0;
-  barrier();
   MPI_Allreduce(&value, &sum, 1, MPI_UNSIGNED_LONG, MPI_SUM, getComm());
   value = sum;
 #endif
 }
 
 void ParallelContext::sumVectorDouble(std::vector<double> &value) {
+  if (isThreadRank()) {
+    threadReduce(value, std::plus<double>());
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   std::vector<double> sum(value.size());
-  barrier();
   MPI_Allreduce(&(value[0]), &(sum[0]), static_cast<int>(value.size()),
                 MPI_DOUBLE, MPI_SUM, getComm());
   value = sum;
@@ -180,12 +418,15 @@ void ParallelContext::sumVectorDouble(std::vector<double> &value) {
 }
 
 void ParallelContext::sumVectorUInt(std::vector<unsigned int> &value) {
+  if (isThreadRank()) {
+    threadReduce(value, std::plus<unsigned int>());
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   std::vector<unsigned int> sum(value.size(), 0u);
-  barrier();
   MPI_Allreduce(&(value[0]), &(sum[0]), static_cast<int>(value.size()),
                 MPI_UNSIGNED, MPI_SUM, getComm());
   value = sum;
@@ -193,6 +434,12 @@ void ParallelContext::sumVectorUInt(std::vector<unsigned int> &value) {
 }
 
 void ParallelContext::parallelAnd(bool &value) {
+  if (isThreadRank()) {
+    std::vector<int> values(1, value ? 1 : 0);
+    threadReduce(values, [](int a, int b) { return std::min(a, b); });
+    value = (values[0] == 1);
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
@@ -204,8 +451,62 @@ void ParallelContext::parallelAnd(bool &value) {
 #endif
 }
 
+void ParallelContext::sumDoubles(std::initializer_list<double *> values) {
+  if ((!isThreadRank() && !_mpiEnabled) || values.size() == 0) {
+    return;
+  }
+  std::vector<double> buffer;
+  for (auto value : values) {
+    buffer.push_back(*value);
+  }
+  sumVectorDouble(buffer);
+  unsigned int i = 0;
+  for (auto value : values) {
+    *value = buffer[i++];
+  }
+}
+
+void ParallelContext::startSumVectorDouble(const std::vector<double> &values,
+                                           AsyncReduction &reduction) {
+  assert(!reduction._pending);
+  reduction._input = values;
+  reduction._output.resize(values.size());
+  if (isThreadRank()) {
+    // no asynchronous progress with threads, reduce right away
+    reduction._output = values;
+    sumVectorDouble(reduction._output);
+    return;
+  }
+  if (!_mpiEnabled || values.empty()) {
+    reduction._output = values;
+    return;
+  }
+#ifdef WITH_MPI
+  MPI_Iallreduce(&(reduction._input[0]), &(reduction._output[0]),
+                 static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM,
+                 getComm(), &reduction._request);
+  reduction._pending = true;
+#endif
+}
+
+void ParallelContext::waitReduction(AsyncReduction &reduction,
+                                    std::vector<double> &values) {
+#ifdef WITH_MPI
+  if (reduction._pending) {
+    MPI_Wait(&reduction._request, MPI_STATUS_IGNORE);
+    reduction._pending = false;
+  }
+#endif
+  values.swap(reduction._output);
+  reduction._output.clear();
+}
+
 void ParallelContext::allGatherDouble(double localValue,
                                       std::vector<double> &allValues) {
+  if (isThreadRank()) {
+    threadConcatenate(std::vector<double>(1, localValue), allValues);
+    return;
+  }
   if (!_mpiEnabled) {
     allValues.clear();
     allValues.push_back(localValue);
@@ -222,6 +523,10 @@ void ParallelContext::allGatherDouble(double localValue,
 
 void ParallelContext::allGatherInt(int localValue,
                                    std::vector<int> &allValues) {
+  if (isThreadRank()) {
+    threadConcatenate(std::vector<int>(1, localValue), allValues);
+    return;
+  }
   if (!_mpiEnabled) {
     allValues.clear();
     allValues.push_back(localValue);
@@ -238,6 +543,10 @@ void ParallelContext::allGatherInt(int localValue,
 
 void ParallelContext::allGatherUInt(unsigned int localValue,
                                     std::vector<unsigned int> &allValues) {
+  if (isThreadRank()) {
+    threadConcatenate(std::vector<unsigned int>(1, localValue), allValues);
+    return;
+  }
   if (!_mpiEnabled) {
     allValues.clear();
     allValues.push_back(localValue);
@@ -254,6 +563,10 @@ void ParallelContext::allGatherUInt(unsigned int localValue,
 
 void ParallelContext::concatenateIntVectors(const std::vector<int> &localVector,
                                             std::vector<int> &globalVector) {
+  if (isThreadRank()) {
+    threadConcatenate(localVector, globalVector);
+    return;
+  }
   if (!_mpiEnabled) {
     globalVector = localVector;
     return;
@@ -271,6 +584,10 @@ void ParallelContext::concatenateIntVectors(const std::vector<int> &localVector,
 void ParallelContext::concatenateUIntVectors(
     const std::vector<unsigned int> &localVector,
     std::vector<unsigned int> &globalVector) {
+  if (isThreadRank()) {
+    threadConcatenate(localVector, globalVector);
+    return;
+  }
   if (!_mpiEnabled) {
     globalVector = localVector;
     return;
@@ -287,6 +604,10 @@ void ParallelContext::concatenateUIntVectors(
 
 void ParallelContext::concatenateHeterogeneousDoubleVectors(
     const std::vector<double> &localVector, std::vector<double> &globalVector) {
+  if (isThreadRank()) {
+    threadConcatenate(localVector, globalVector);
+    return;
+  }
   if (!_mpiEnabled) {
     globalVector = localVector;
     return;
@@ -316,6 +637,10 @@ void ParallelContext::concatenateHeterogeneousDoubleVectors(
 void ParallelContext::concatenateHeterogeneousUIntVectors(
     const std::vector<unsigned int> &localVector,
     std::vector<unsigned int> &globalVector) {
+  if (isThreadRank()) {
+    threadConcatenate(localVector, globalVector);
+    return;
+  }
   if (!_mpiEnabled) {
     globalVector = localVector;
     return;
@@ -342,7 +667,44 @@ void ParallelContext::concatenateHeterogeneousUIntVectors(
 #endif
 }
 
+void ParallelContext::concatenateHeterogeneousULongVectors(
+    const std::vector<unsigned long> &localVector,
+    std::vector<unsigned long> &globalVector) {
+  if (isThreadRank()) {
+    threadConcatenate(localVector, globalVector);
+    return;
+  }
+  if (!_mpiEnabled) {
+    globalVector = localVector;
+    return;
+  }
+#ifdef WITH_MPI
+  std::vector<int> vectorSizes(static_cast<int>(getSize()));
+  allGatherInt(localVector.size(), vectorSizes);
+  auto totalSize = std::accumulate(vectorSizes.begin(), vectorSizes.end(), 0);
+  globalVector.resize(totalSize);
+  std::vector<int> displ(getSize(), 0);
+  for (unsigned int i = 1; i < displ.size(); ++i) {
+    displ[i] = displ[i - 1] + vectorSizes[i - 1];
+  }
+  MPI_Allgatherv(&localVector[0],    // send buffer
+                 localVector.size(), // send count
+                 MPI_UNSIGNED_LONG,  // send type
+                 &globalVector[0],   // receive buffer
+                 &vectorSizes[0],    // receive counts
+                 &displ[0],          // per rank offset
+                 MPI_UNSIGNED_LONG,  // receive type
+                 getComm());
+#else
+  assert(false);
+#endif
+}
+
 void ParallelContext::broadcastInt(unsigned int fromRank, int &value) {
+  if (isThreadRank()) {
+    threadBroadcast(fromRank, value);
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -353,6 +715,10 @@ void ParallelContext::broadcastInt(unsigned int fromRank, int &value) {
 
 void ParallelContext::broadcastUInt(unsigned int fromRank,
                                     unsigned int &value) {
+  if (isThreadRank()) {
+    threadBroadcast(fromRank, value);
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -362,6 +728,10 @@ void ParallelContext::broadcastUInt(unsigned int fromRank,
 }
 
 void ParallelContext::broadcastDouble(unsigned int fromRank, double &value) {
+  if (isThreadRank()) {
+    threadBroadcast(fromRank, value);
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -371,19 +741,25 @@ void ParallelContext::broadcastDouble(unsigned int fromRank, double &value) {
 }
 
 void ParallelContext::maxUInt(unsigned int &value) {
+  if (isThreadRank()) {
+    std::vector<unsigned int> values(1, value);
+    threadReduce(values,
+                 [](unsigned int a, unsigned int b) { return std::max(a, b); });
+    value = values[0];
+    return;
+  }
 #ifdef WITH_MPI
   if (!_mpiEnabled) {
     return;
   }
   unsigned int sum = 0;
-  barrier();
   MPI_Allreduce(&value, &sum, 1, MPI_UNSIGNED, MPI_MAX, getComm());
   value = sum;
 #endif
 }
 
 unsigned int ParallelContext::getMax(double &value, unsigned int &bestRank) {
-  if (!_mpiEnabled) {
+  if (getSize() == 1) {
     bestRank = 0;
     return bestRank;
   }
@@ -400,6 +776,10 @@ unsigned int ParallelContext::getMax(double &value, unsigned int &bestRank) {
 }
 
 void ParallelContext::barrier() {
+  if (isThreadRank()) {
+    _threadRanks.top().comm->barrier();
+    return;
+  }
   if (!_mpiEnabled) {
     return;
   }
@@ -409,7 +789,7 @@ void ParallelContext::barrier() {
 }
 
 void ParallelContext::abort(int errorCode) {
-  if (!_mpiEnabled) {
+  if (isThreadRank() || !_mpiEnabled) {
     exit(errorCode);
   }
 #ifdef WITH_MPI
@@ -444,7 +824,7 @@ void ParallelContext::makeRandConsistent() {
 }
 
 bool ParallelContext::isIntEqual(int value) {
-#ifdef WITH_MPI
+  // allGatherInt also works without MPI
   std::vector<int> rands(getSize());
   allGatherInt(value, rands);
   for (auto v : rands) {
@@ -452,12 +832,10 @@ bool ParallelContext::isIntEqual(int value) {
       return false;
     }
   }
-#endif
   return true;
 }
 
 bool ParallelContext::isDoubleEqual(double value) {
-#ifdef WITH_MPI
   std::vector<double> rands(getSize());
   allGatherDouble(value, rands);
   for (auto v : rands) {
@@ -467,6 +845,5 @@ bool ParallelContext::isDoubleEqual(double value) {
       return false;
     }
   }
-#endif
   return true;
 }
@@ -2,6 +2,9 @@
 
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <memory>
 #include <stack>
 #include <string>
 #include <vector>
@@ -12,6 +15,9 @@
 typedef int MPI_Comm;
 #endif
 
+class ThreadComm;
+class ThreadTeam;
+
 /**
  *  Singleton class that handles parallelization routines
  */
@@ -19,6 +25,26 @@ class ParallelContext {
 public:
   ParallelContext() = delete;
 
+  /**
+   *  Handle on a non-blocking reduction (see startSumVectorDouble).
+   *  The buffers are owned by the handle, which must stay alive
+   *  until waitReduction is called
+   */
+  class AsyncReduction {
+  public:
+    AsyncReduction() : _pending(false) {}
+    bool isPending() const { return _pending; }
+
+  private:
+    friend class ParallelContext;
+    std::vector<double> _input;
+    std::vector<double> _output;
+    bool _pending;
+#ifdef WITH_MPI
+    MPI_Request _request;
+#endif
+  };
+
   /**
    *  Initialize the parallel context. Must always be called at the start of
    *  the program
@@ -32,6 +58,67 @@ public:
    */
   static void finalize();
 
+  /**
+   *  Shared-memory backend, that does not require MPI: run function
+   *  on threads threads of the current process, each thread being
+   *  one rank of a communicator of size threads. Returns when all
+   *  the threads are done. All the functions of this class behave
+   *  as with MPI ranks within function (init and finalize are then
+   *  no-ops), but the MPI communicator (getComm) is not available,
+   *  and thus neither is the scheduler.
+   *  @param threads the number of ranks
+   *  @param function the function each rank runs
+   */
+  static void runThreadRanks(unsigned int threads,
+                             const std::function<void()> &function);
+
+  /**
+   *  @return true if the calling rank is a thread rank (see
+   *  runThreadRanks): all the ranks then share the process
+   *  state, such as std::cout and the log file
+   */
+  static bool isThreadRank() { return !_threadRanks.empty(); }
+
+  /**
+   *  Hybrid parallelization: each rank (MPI rank or thread rank)
+   *  can own a persistent team of threads, to run its local loops
+   *  in parallel without duplicating the state of the rank. The
+   *  rank-level functions of this class must be called outside of
+   *  the team functions, and the team functions are local to the
+   *  calling rank (not collective over the ranks).
+   */
+
+  /**
+   *  Create the team of the calling rank, with threads threads
+   *  (including the calling thread). 1 disables the team.
+   */
+  static void setTeamSize(unsigned int threads);
+  static unsigned int getTeamSize();
+
+  /**
+   *  Run function(thread) on each thread of the team of the
+   *  calling rank, and return when all of them are done.
+   *  Within function, the team* functions below can be called.
+   */
+  static void teamRun(const std::function<void(unsigned int)> &function);
+
+  /**
+   *  Run function(i) for each i < elems on the threads of the
+   *  team, with a dynamic distribution of the indices
+   */
+  static void
+  teamParallelFor(unsigned int elems,
+                  const std::function<void(unsigned int)> &function);
+
+  /**
+   *  Within teamRun: the index of the calling thread in its team,
+   *  a barrier over the team, and the sum over the team (in the
+   *  same order for all threads, for reproducibility)
+   */
+  static unsigned int getTeamThread();
+  static void teamBarrier();
+  static void teamSumDouble(double &value);
+
   /**
    *  @return the MPI rank
    */
@@ -76,6 +163,9 @@ public:
   static void
   concatenateHeterogeneousDoubleVectors(const std::vector<double> &localVector,
                                         std::vector<double> &globalVector);
+  static void concatenateHeterogeneousULongVectors(
+      const std::vector<unsigned long> &localVector,
+      std::vector<unsigned long> &globalVector);
 
   static void sumDouble(double &value);
   static void sumUInt(unsigned int &value);
@@ -85,6 +175,31 @@ public:
   static void sumULong(unsigned long &value);
   static void parallelAnd(bool &value);
 
+  /**
+   *  Sum several scalars with one single reduction
+   *  @param values pointers to the values to sum. Each value is
+   *    replaced with its sum over all ranks
+   */
+  static void sumDoubles(std::initializer_list<double *> values);
+
+  /**
+   *  Non-blocking version of sumVectorDouble: start the reduction,
+   *  let the caller compute something else, and get the sums
+   *  with waitReduction. All ranks must start and wait their
+   *  reductions in the same order.
+   *  @param values input values for this rank
+   *  @param reduction the handle to pass to waitReduction
+   */
+  static void startSumVectorDouble(const std::vector<double> &values,
+                                   AsyncReduction &reduction);
+  /**
+   *  Wait for a reduction started with startSumVectorDouble
+   *  @param reduction the handle of the reduction
+   *  @param values output values (the sums over all ranks)
+   */
+  static void waitReduction(AsyncReduction &reduction,
+                            std::vector<double> &values);
+
   /**
    *  Broadcast a value from a given rank
    *  @param fromRank rank from which we want the value
@@ -111,6 +226,22 @@ public:
   static unsigned int getBegin(unsigned int elems);
   static unsigned int getEnd(unsigned int elems);
 
+  /**
+   *  Dynamic alternative to getBegin/getEnd, for independant tasks
+   *  with very different costs: the ranks share a task counter, and
+   *  each call to getNextTask returns the index of a task that was
+   *  not given to any rank yet (or a value >= the number of tasks
+   *  when all of them were given). startDynamicTasks and
+   *  endDynamicTasks are collective and must frame the calls to
+   *  getNextTask. The calls to getNextTask use the counter of the
+   *  innermost frame, even from a context pushed after
+   *  startDynamicTasks: this allows to run each task in a
+   *  sequential context, and to nest other frames in the tasks
+   */
+  static void startDynamicTasks();
+  static unsigned int getNextTask();
+  static void endDynamicTasks();
+
   static void barrier();
   static void abort(int errorCode);
 
@@ -132,6 +263,49 @@ private:
   static std::stack<MPI_Comm> _commStack;
   static std::stack<bool> _ownsMPIContextStack;
   static bool _mpiEnabled;
+  /**
+   *  Task counter of a startDynamicTasks/endDynamicTasks frame
+   */
+  struct DynamicTasks {
+    // counter used when MPI is disabled
+    unsigned int localCounter;
+    // counter in the window of rank 0
+    unsigned int *counter;
+#ifdef WITH_MPI
+    MPI_Win window;
+#endif
+    // thread group sharing the counter, with the thread backend
+    std::shared_ptr<ThreadComm> threadComm;
+  };
+  static thread_local std::stack<DynamicTasks> _dynamicTasks;
+
+  /**
+   *  Shared-memory backend state of the calling thread: the
+   *  stack of thread groups it belongs to, with its rank in each
+   *  of them. Empty when the thread does not run as a rank
+   */
+  struct ThreadRank {
+    std::shared_ptr<ThreadComm> comm;
+    unsigned int rank;
+  };
+  static thread_local std::stack<ThreadRank> _threadRanks;
+  /**
+   *  Hybrid backend state: the team owned by the calling rank, and
+   *  the team and index of the calling thread during a teamRun
+   */
+  static thread_local std::unique_ptr<ThreadTeam> _team;
+  static thread_local ThreadTeam *_currentTeam;
+  static thread_local unsigned int _teamThread;
+  template <typename T>
+  static void threadAllGather(const std::vector<T> &localValues,
+                              std::vector<std::vector<T>> &allValues);
+  template <typename T>
+  static void threadConcatenate(const std::vector<T> &localVector,
+                                std::vector<T> &globalVector);
+  template <typename T, typename Op>
+  static void threadReduce(std::vector<T> &values, Op op);
+  template <typename T>
+  static void threadBroadcast(unsigned int fromRank, T &value);
 
   class ParallelException : public std::exception {
   public:
@@ -1,12 +1,13 @@
 #include "PerCoreGeneTrees.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
+#include <IO/FamilyMetadataIndex.hpp>
 #include <IO/FileSystem.hpp>
 #include <IO/LibpllParsers.hpp>
 #include <IO/Logger.hpp>
-#include <ccp/ConditionalClades.hpp>
 #include <parallelization/ParallelContext.hpp>
 #include <trees/PLLRootedTree.hpp>
 #include <util/utils.hpp>
@@ -36,6 +37,31 @@ getMyIndices(const std::vector<unsigned int> &treeSizes) {
   return myIndices;
 }
 
+/**
+ *  Assign the families to the cores by decreasing cost, each
+ *  to the least loaded core (the lowest rank on ties), such
+ *  that all cores compute the same assignment
+ *  @param familyCosts the cost of each family
+ *  @param perRankLoad output: the resulting cost of each core
+ *  @return the core of each family
+ */
+static std::vector<unsigned int>
+assignFamiliesByCost(const std::vector<double> &familyCosts,
+                     std::vector<double> &perRankLoad) {
+  std::vector<size_t> sortedIndices =
+      sort_indices_descending<double>(familyCosts);
+  std::vector<unsigned int> familyRanks(familyCosts.size(), 0);
+  perRankLoad.assign(ParallelContext::getSize(), 0.0);
+  for (auto index : sortedIndices) {
+    auto rank = static_cast<unsigned int>(
+        std::min_element(perRankLoad.begin(), perRankLoad.end()) -
+        perRankLoad.begin());
+    perRankLoad[rank] += familyCosts[index];
+    familyRanks[index] = rank;
+  }
+  return familyRanks;
+}
+
 static void splitLines(const std::string &input,
                        std::vector<std::string> &output) {
   std::stringstream ss(input);
@@ -47,31 +73,28 @@ static void splitLines(const std::string &input,
   }
 }
 
-std::vector<unsigned int> getCCPSizes(const Families &families) {
-  unsigned int treesNumber = static_cast<unsigned int>(families.size());
-  std::vector<unsigned int> localTreeSizes(
-      (treesNumber - 1) / ParallelContext::getSize() + 1, 0);
-  for (auto i = ParallelContext::getBegin(treesNumber);
-       i < ParallelContext::getEnd(treesNumber); i++) {
-    ConditionalClades cc;
-    cc.unserialize(families[i].ccpFile);
-    localTreeSizes[i - ParallelContext::getBegin(treesNumber)] =
-        cc.getCladesNumber();
-  }
-  std::vector<unsigned int> treeSizes;
-  ParallelContext::concatenateUIntVectors(localTreeSizes, treeSizes);
-  treeSizes.erase(remove(treeSizes.begin(), treeSizes.end(), 0),
-                  treeSizes.end());
-  assert(treeSizes.size() == families.size());
-  return treeSizes;
-}
-
 PerCoreGeneTrees::PerCoreGeneTrees(const Families &families,
-                                   bool acceptMultipleTrees, bool ccpMode) {
-  auto treeSizes = ccpMode ? getCCPSizes(families)
+                                   bool acceptMultipleTrees, bool ccpMode)
+    : _acceptMultipleTrees(acceptMultipleTrees), _ccpMode(ccpMode) {
+  auto treeSizes = ccpMode ? FamilyMetadataIndex::getCCPCladeNumbers(families)
                            : LibpllParsers::parallelGetTreeSizes(families);
   auto myIndices = getMyIndices(treeSizes);
+  loadTrees(families, myIndices);
+  std::vector<unsigned int> perCoreTrees;
+  ParallelContext::allGatherUInt(_geneTrees.size(), perCoreTrees);
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < ParallelContext::getRank(); ++i) {
+    offset += perCoreTrees[i];
+  }
+  for (unsigned int i = 0; i < _geneTrees.size(); ++i) {
+    _geneTrees[i].globalIndex = offset + i;
+  }
+  ParallelContext::barrier();
+}
 
+void PerCoreGeneTrees::loadTrees(const Families &families,
+                                 const std::vector<size_t> &myIndices) {
+  _geneTrees.clear();
   _geneTrees.resize(myIndices.size());
   unsigned int index = 0;
   for (auto i : myIndices) {
@@ -84,7 +107,7 @@ PerCoreGeneTrees::PerCoreGeneTrees(const Families &families,
       geneTreeStrVector.clear();
       geneTreeStrVector.push_back(geneTreeStr);
     }
-    if (acceptMultipleTrees) {
+    if (_acceptMultipleTrees) {
       if (index == 0) {
         _geneTrees.resize(myIndices.size() * geneTreeStrVector.size());
       }
@@ -96,7 +119,7 @@ PerCoreGeneTrees::PerCoreGeneTrees(const Families &families,
       _geneTrees[index].familyIndex = i;
       _geneTrees[index].mapping.fill(families[i].mappingFile,
                                      currentGeneTreeStr);
-      if (!ccpMode) {
+      if (!_ccpMode) {
         _geneTrees[index].geneTree =
             new PLLUnrootedTree(currentGeneTreeStr, false);
       }
@@ -105,14 +128,83 @@ PerCoreGeneTrees::PerCoreGeneTrees(const Families &families,
       index++;
     }
   }
+}
+
+bool PerCoreGeneTrees::rebalance(const Families &families,
+                                 const std::vector<double> &localCosts,
+                                 double minGain) {
+  assert(localCosts.size() == _geneTrees.size());
+  std::vector<unsigned int> localFamilies;
+  std::vector<unsigned int> localGlobalIndices;
+  for (const auto &tree : _geneTrees) {
+    localFamilies.push_back(tree.familyIndex);
+    localGlobalIndices.push_back(tree.globalIndex);
+  }
+  std::vector<unsigned int> allFamilies;
+  std::vector<unsigned int> allGlobalIndices;
+  std::vector<double> allCosts;
+  ParallelContext::concatenateHeterogeneousUIntVectors(localFamilies,
+                                                       allFamilies);
+  ParallelContext::concatenateHeterogeneousUIntVectors(localGlobalIndices,
+                                                       allGlobalIndices);
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localCosts, allCosts);
+  // the trees of a family are on the same core and in order
+  std::vector<double> familyCosts(families.size(), 0.0);
+  std::vector<std::vector<unsigned int>> familyGlobalIndices(families.size());
+  for (unsigned int i = 0; i < allFamilies.size(); ++i) {
+    familyCosts[allFamilies[i]] += allCosts[i];
+    familyGlobalIndices[allFamilies[i]].push_back(allGlobalIndices[i]);
+  }
+  double localLoad = 0.0;
+  for (auto cost : localCosts) {
+    localLoad += cost;
+  }
+  std::vector<double> perRankLoad;
+  ParallelContext::allGatherDouble(localLoad, perRankLoad);
+  auto currentMax = *std::max_element(perRankLoad.begin(), perRankLoad.end());
+  auto familyRanks = assignFamiliesByCost(familyCosts, perRankLoad);
+  auto newMax = *std::max_element(perRankLoad.begin(), perRankLoad.end());
+  // all cores take the same decision
+  if (currentMax <= 0.0 || newMax > currentMax * (1.0 - minGain)) {
+    return false;
+  }
+  Logger::timed << "Rebalancing the families between the cores, highest "
+                   "per-core cost: "
+                << currentMax << " -> " << newMax << std::endl;
+  std::vector<size_t> myIndices;
+  for (unsigned int i = 0; i < familyRanks.size(); ++i) {
+    if (familyRanks[i] == ParallelContext::getRank()) {
+      myIndices.push_back(i);
+    }
+  }
+  loadTrees(families, myIndices);
+  std::vector<unsigned int> treesPerFamily(families.size(), 0);
+  for (auto &tree : _geneTrees) {
+    auto &globalIndices = familyGlobalIndices[tree.familyIndex];
+    auto &treeIndex = treesPerFamily[tree.familyIndex];
+    assert(treeIndex < globalIndices.size());
+    tree.globalIndex = globalIndices[treeIndex++];
+  }
   ParallelContext::barrier();
+  return true;
+}
+
+std::vector<unsigned int> PerCoreGeneTrees::getGlobalIndices() const {
+  std::vector<unsigned int> res;
+  for (const auto &tree : _geneTrees) {
+    res.push_back(tree.globalIndex);
+  }
+  return res;
 }
 
 PerCoreGeneTrees::PerCoreGeneTrees(const GeneSpeciesMapping &mapping,
-                                   PLLUnrootedTree &geneTree) {
+                                   PLLUnrootedTree &geneTree)
+    : _acceptMultipleTrees(false), _ccpMode(false) {
   if (ParallelContext::getRank() == 0) {
     _geneTrees.resize(1);
     _geneTrees[0].name = "JointTree";
+    _geneTrees[0].familyIndex = 0;
+    _geneTrees[0].globalIndex = 0;
     _geneTrees[0].mapping = mapping;
     _geneTrees[0].geneTree = &geneTree;
     _geneTrees[0].ownTree = false;
@@ -136,9 +228,11 @@ bool PerCoreGeneTrees::checkMappings(const std::string &speciesTreeFile) {
 
 void PerCoreGeneTrees::getPerCoreFamilies(const Families &allFamilies,
                                           Families &perCoreFamilies) {
+  // same distribution as PerCoreGeneTrees(allFamilies), without
+  // loading the trees
   perCoreFamilies.clear();
-  PerCoreGeneTrees geneTrees(allFamilies);
-  for (const auto &geneTree : geneTrees.getTrees()) {
-    perCoreFamilies.push_back(allFamilies[geneTree.familyIndex]);
+  auto treeSizes = LibpllParsers::parallelGetTreeSizes(allFamilies);
+  for (auto i : getMyIndices(treeSizes)) {
+    perCoreFamilies.push_back(allFamilies[i]);
   }
 }
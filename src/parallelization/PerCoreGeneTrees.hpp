@@ -19,9 +19,12 @@ public:
     std::string name;
     std::string startingGeneTreeFile;
     unsigned int familyIndex;
+    // index of the tree in the concatenation of the trees of all
+    // cores at construction time, kept when trees are redistributed
+    unsigned int globalIndex;
     GeneSpeciesMapping mapping;
-    PLLUnrootedTree *geneTree;
-    bool ownTree; // If true, I am responsible for destroying the tree
+    PLLUnrootedTree *geneTree = nullptr;
+    bool ownTree = false; // If true, I am responsible for destroying the tree
     ~GeneTree() {
       if (ownTree) {
         delete geneTree;
@@ -69,7 +72,36 @@ public:
   static void getPerCoreFamilies(const Families &allFamilies,
                                  Families &perCoreFamilies);
 
+  /**
+   *  Redistribute the families between the cores according to
+   *  their measured costs, if it reduces the cost of the most
+   *  loaded core enough. Collective.
+   *
+   *  All references to the previous trees are invalidated
+   *  if the families were redistributed.
+   *
+   *  @param families the families this object was built from
+   *  @param localCosts the cost (e.g. the evaluation time) of
+   *    each tree of the current core
+   *  @param minGain minimum relative decrease of the highest
+   *    per-core cost for the families to be moved
+   *  @return true if the families were redistributed
+   */
+  bool rebalance(const Families &families,
+                 const std::vector<double> &localCosts, double minGain);
+
+  /**
+   *  @return the global indices of the trees of the current core
+   *  (see GeneTree::globalIndex)
+   */
+  std::vector<unsigned int> getGlobalIndices() const;
+
 private:
+  void loadTrees(const Families &families,
+                 const std::vector<size_t> &myIndices);
+
   std::vector<GeneTree> _geneTrees;
   std::vector<unsigned int> _treeSizes;
+  bool _acceptMultipleTrees;
+  bool _ccpMode;
 };
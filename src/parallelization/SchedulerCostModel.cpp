@@ -0,0 +1,148 @@
+#include "SchedulerCostModel.hpp"
+
+#include <IO/FileSystem.hpp>
+#include <IO/ParallelOfstream.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <parallelization/ParallelContext.hpp>
+
+// the scheduler expects integer costs: the most expensive
+// job gets this cost, and the other ones proportionally
+static const double COST_RESOLUTION = 1000000.0;
+
+static double getFileSize(const std::string &path) {
+  if (!path.size() || !FileSystem::exists(path)) {
+    return 0.0;
+  }
+  std::ifstream is(path, std::ios::binary | std::ios::ate);
+  auto size = is.tellg();
+  return size > 0 ? static_cast<double>(size) : 0.0;
+}
+
+// return a negative value if the runtime was not measured
+static double readRuntime(const std::string &path) {
+  if (!FileSystem::exists(path)) {
+    return -1.0;
+  }
+  std::ifstream is(path);
+  double seconds = -1.0;
+  if (!(is >> seconds)) {
+    return -1.0;
+  }
+  return seconds;
+}
+
+SchedulerCostModel::SchedulerCostModel(
+    const Families &families, const std::vector<std::string> &statsFiles,
+    const std::vector<unsigned int> &geneTreeSizes, double libpllWeight,
+    double recWeight, unsigned int speciesLeaves)
+    : _totalCost(0.0), _maxCost(0.0), _measuredNumber(0) {
+  assert(statsFiles.size() == families.size());
+  assert(geneTreeSizes.size() == families.size());
+  auto familiesNumber = static_cast<unsigned int>(families.size());
+  auto begin = ParallelContext::getBegin(familiesNumber);
+  auto end = ParallelContext::getEnd(familiesNumber);
+  // each term has its own unit: libpll updates taxa x sites
+  // partial likelihoods, and the reconciliation taxa x species ones
+  std::vector<double> localLibpllTerms;
+  std::vector<double> localRecTerms;
+  std::vector<double> localRuntimes;
+  for (auto i = begin; i < end; ++i) {
+    double taxa = std::max(1u, geneTreeSizes[i]);
+    double libpllTerm = 0.0;
+    if (libpllWeight > 0.0) {
+      // the alignment size per taxon is a proxy for the number of sites
+      double sites = getFileSize(families[i].alignmentFile) / taxa;
+      libpllTerm = taxa * sites;
+    }
+    localLibpllTerms.push_back(libpllTerm);
+    localRecTerms.push_back(taxa * speciesLeaves);
+    localRuntimes.push_back(readRuntime(getRuntimePath(statsFiles[i])));
+  }
+  std::vector<double> libpllTerms;
+  std::vector<double> recTerms;
+  std::vector<double> runtimes;
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localLibpllTerms,
+                                                         libpllTerms);
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localRecTerms,
+                                                         recTerms);
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localRuntimes,
+                                                         runtimes);
+  assert(libpllTerms.size() == families.size());
+  assert(recTerms.size() == families.size());
+  // normalize each term to an average of 1 over the families before
+  // summing them, such that the weights give their relative shares
+  double libpllSum = 0.0;
+  double recSum = 0.0;
+  for (unsigned int i = 0; i < familiesNumber; ++i) {
+    libpllSum += libpllTerms[i];
+    recSum += recTerms[i];
+  }
+  std::vector<double> estimates(familiesNumber, 0.0);
+  for (unsigned int i = 0; i < familiesNumber; ++i) {
+    if (libpllSum > 0.0) {
+      estimates[i] += libpllWeight * libpllTerms[i] * familiesNumber /
+                      libpllSum;
+    }
+    if (recSum > 0.0) {
+      estimates[i] += recWeight * recTerms[i] * familiesNumber / recSum;
+    }
+    if (estimates[i] <= 0.0) {
+      estimates[i] = 1.0;
+    }
+  }
+  // express the estimates in core-seconds, using the families
+  // for which we have both an estimate and a measurement
+  double sumMeasured = 0.0;
+  double sumEstimated = 0.0;
+  for (unsigned int i = 0; i < familiesNumber; ++i) {
+    if (runtimes[i] > 0.0) {
+      sumMeasured += runtimes[i];
+      sumEstimated += estimates[i];
+      _measuredNumber++;
+    }
+  }
+  double scale = 1.0;
+  if (sumMeasured > 0.0 && sumEstimated > 0.0) {
+    scale = sumMeasured / sumEstimated;
+  }
+  _costs.resize(familiesNumber);
+  for (unsigned int i = 0; i < familiesNumber; ++i) {
+    _costs[i] = runtimes[i] > 0.0 ? runtimes[i] : estimates[i] * scale;
+    _totalCost += _costs[i];
+    _maxCost = std::max(_maxCost, _costs[i]);
+  }
+}
+
+unsigned long SchedulerCostModel::getCost(unsigned int i) const {
+  if (_maxCost <= 0.0) {
+    return 1;
+  }
+  auto cost = std::llround(_costs[i] / _maxCost * COST_RESOLUTION);
+  return static_cast<unsigned long>(std::max(1ll, cost));
+}
+
+unsigned int SchedulerCostModel::getCores(unsigned int i,
+                                          unsigned int maxCores) const {
+  maxCores = std::max(1u, maxCores);
+  if (_totalCost <= 0.0) {
+    return 1;
+  }
+  double averageLoad = _totalCost / ParallelContext::getSize();
+  double cores = std::ceil(_costs[i] / averageLoad);
+  cores = std::min(static_cast<double>(maxCores), cores);
+  return std::max(1u, static_cast<unsigned int>(cores));
+}
+
+void SchedulerCostModel::saveRuntime(const std::string &statsFile,
+                                     double seconds) {
+  ParallelOfstream os(getRuntimePath(statsFile));
+  os << seconds * ParallelContext::getSize() << std::endl;
+  os.close();
+}
+
+std::string SchedulerCostModel::getRuntimePath(const std::string &statsFile) {
+  return statsFile + ".runtime";
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <IO/Families.hpp>
+#include <string>
+#include <vector>
+
+/**
+ *  Sizes the per-family jobs sent to the scheduler.
+ *
+ *  The cost of a family is the runtime of its job in the previous
+ *  scheduled step writing the same stats file, in core-seconds (see
+ *  saveRuntime).
+ *  Families without such a measurement get a static estimate, the
+ *  weighted sum of a sequence likelihood term (taxa x sites, the
+ *  number of sites being estimated from the alignment size) and of
+ *  a reconciliation term (taxa x species leaves). Each term is first
+ *  normalized to an average of 1 over the families, since they do
+ *  not have the same unit. The estimates are then rescaled to the
+ *  unit of the measured runtimes.
+ *
+ *  The cores of a job are then chosen such that its cost per core
+ *  does not exceed the average load of a core over the whole step.
+ */
+class SchedulerCostModel {
+public:
+  /**
+   *  Collective
+   *  @param families The families to schedule
+   *  @param statsFiles The stats file of the job of each family
+   *  @param geneTreeSizes The number of taxa of each family
+   *  @param libpllWeight Relative weight of the sequence likelihood
+   *    term, 0 if the alignments are not used
+   *  @param recWeight Relative weight of the reconciliation term,
+   *    0 if the reconciliation likelihood is not used
+   *  @param speciesLeaves The number of leaves of the species tree
+   */
+  SchedulerCostModel(const Families &families,
+                     const std::vector<std::string> &statsFiles,
+                     const std::vector<unsigned int> &geneTreeSizes,
+                     double libpllWeight, double recWeight,
+                     unsigned int speciesLeaves);
+
+  /**
+   *  Return the cost of the job of family i, as an integer relative
+   *  to the cost of the other jobs, as expected by the scheduler
+   */
+  unsigned long getCost(unsigned int i) const;
+
+  /**
+   *  Return the number of cores of the job of family i, between 1
+   *  and maxCores
+   */
+  unsigned int getCores(unsigned int i, unsigned int maxCores) const;
+
+  /**
+   *  Return the number of families with a measured runtime
+   */
+  unsigned int getMeasuredNumber() const { return _measuredNumber; }
+
+  /**
+   *  Save the runtime of a scheduled job, to be read by the cost
+   *  model of the next steps. The wall time is multiplied by the
+   *  number of ranks of the current parallel context, such that the
+   *  jobs run on different numbers of cores can be compared.
+   *  Only the master rank writes.
+   *  @param seconds The wall time of the job
+   */
+  static void saveRuntime(const std::string &statsFile, double seconds);
+
+private:
+  static std::string getRuntimePath(const std::string &statsFile);
+  std::vector<double> _costs;
+  double _totalCost;
+  double _maxCost;
+  unsigned int _measuredNumber;
+};
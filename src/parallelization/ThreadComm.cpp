@@ -0,0 +1,34 @@
+#include "ThreadComm.hpp"
+
+#include <cassert>
+
+ThreadComm::ThreadComm(unsigned int size)
+    : _size(size), _waiting(0), _generation(0), _buffers(size),
+      _tasksCounter(0) {
+  assert(size);
+}
+
+void ThreadComm::barrier() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  auto generation = _generation;
+  if (++_waiting == _size) {
+    _waiting = 0;
+    _generation++;
+    _condition.notify_all();
+  } else {
+    _condition.wait(lock, [this, generation] {
+      return generation != _generation;
+    });
+  }
+}
+
+void ThreadComm::allGather(unsigned int rank,
+                           const std::vector<char> &localBuffer,
+                           std::vector<std::vector<char>> &allBuffers) {
+  assert(rank < _size);
+  _buffers[rank] = localBuffer;
+  barrier();
+  allBuffers = _buffers;
+  // no thread can overwrite its buffer before all threads read it
+  barrier();
+}
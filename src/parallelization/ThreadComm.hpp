@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+/**
+ *  Group of threads emulating the ranks of a MPI communicator
+ *  within one single process (see ParallelContext::runThreadRanks).
+ *  All collective operations are built on top of allGather.
+ */
+class ThreadComm {
+public:
+  ThreadComm(unsigned int size);
+
+  ThreadComm(const ThreadComm &) = delete;
+  ThreadComm &operator=(const ThreadComm &) = delete;
+
+  unsigned int getSize() const { return _size; }
+
+  /**
+   *  Collective: block until all the threads of the group reach it
+   */
+  void barrier();
+
+  /**
+   *  Collective: each thread contributes one buffer, and gets the
+   *  buffers of all threads
+   *  @param rank the rank of the calling thread
+   *  @param localBuffer the contribution of the calling thread
+   *  @param allBuffers output buffers, indexed by rank
+   */
+  void allGather(unsigned int rank, const std::vector<char> &localBuffer,
+                 std::vector<std::vector<char>> &allBuffers);
+
+  /**
+   *  Typed version of allGather, for trivially copyable types
+   */
+  template <typename T>
+  void allGather(unsigned int rank, const std::vector<T> &localValues,
+                 std::vector<std::vector<T>> &allValues) {
+    std::vector<char> localBuffer(localValues.size() * sizeof(T));
+    if (localValues.size()) {
+      memcpy(&localBuffer[0], &localValues[0], localBuffer.size());
+    }
+    std::vector<std::vector<char>> allBuffers;
+    allGather(rank, localBuffer, allBuffers);
+    allValues.resize(_size);
+    for (unsigned int i = 0; i < _size; ++i) {
+      allValues[i].resize(allBuffers[i].size() / sizeof(T));
+      if (allValues[i].size()) {
+        memcpy(&allValues[i][0], &allBuffers[i][0], allBuffers[i].size());
+      }
+    }
+  }
+
+  /**
+   *  Counter shared by the threads of the group, for the dynamic
+   *  task distribution
+   */
+  std::atomic<unsigned int> &getTasksCounter() { return _tasksCounter; }
+
+private:
+  unsigned int _size;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  unsigned int _waiting;
+  unsigned long _generation;
+  std::vector<std::vector<char>> _buffers;
+  std::atomic<unsigned int> _tasksCounter;
+};
@@ -0,0 +1,58 @@
+#include "ThreadTeam.hpp"
+
+ThreadTeam::ThreadTeam(unsigned int size)
+    : _comm(size), _function(nullptr), _generation(0), _running(0),
+      _stop(false) {
+  for (unsigned int thread = 1; thread < size; ++thread) {
+    _workers.emplace_back(&ThreadTeam::workerLoop, this, thread);
+  }
+}
+
+ThreadTeam::~ThreadTeam() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _startCondition.notify_all();
+  for (auto &worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadTeam::run(const std::function<void(unsigned int)> &function) {
+  if (_workers.empty()) {
+    function(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _function = &function;
+    _running = static_cast<unsigned int>(_workers.size());
+    _generation++;
+  }
+  _startCondition.notify_all();
+  function(0);
+  std::unique_lock<std::mutex> lock(_mutex);
+  _doneCondition.wait(lock, [this]() { return _running == 0; });
+  _function = nullptr;
+}
+
+void ThreadTeam::workerLoop(unsigned int thread) {
+  unsigned long generation = 0;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _startCondition.wait(
+        lock, [&]() { return _stop || _generation != generation; });
+    if (_stop) {
+      return;
+    }
+    generation = _generation;
+    auto function = _function;
+    lock.unlock();
+    (*function)(thread);
+    lock.lock();
+    if (--_running == 0) {
+      _doneCondition.notify_all();
+    }
+  }
+}
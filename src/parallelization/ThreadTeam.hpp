@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <parallelization/ThreadComm.hpp>
+#include <thread>
+#include <vector>
+
+/**
+ *  Persistent team of threads owned by one rank, to run the local
+ *  loops of this rank in parallel (see ParallelContext::teamRun).
+ *  The calling thread is the thread 0 of the team, and the other
+ *  threads wait for work between two runs.
+ */
+class ThreadTeam {
+public:
+  ThreadTeam(unsigned int size);
+  ~ThreadTeam();
+
+  ThreadTeam(const ThreadTeam &) = delete;
+  ThreadTeam &operator=(const ThreadTeam &) = delete;
+
+  unsigned int getSize() const { return _comm.getSize(); }
+
+  /**
+   *  Barriers and exchanges between the threads of the team
+   */
+  ThreadComm &getComm() { return _comm; }
+
+  /**
+   *  Run function(thread) on all the threads of the team, and
+   *  return when all of them are done
+   */
+  void run(const std::function<void(unsigned int)> &function);
+
+private:
+  void workerLoop(unsigned int thread);
+
+  ThreadComm _comm;
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _startCondition;
+  std::condition_variable _doneCondition;
+  const std::function<void(unsigned int)> *_function;
+  unsigned long _generation;
+  unsigned int _running;
+  bool _stop;
+};
@@ -0,0 +1,49 @@
+#include "WorkerPool.hpp"
+
+#include <IO/Logger.hpp>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <maths/Random.hpp>
+#include <numeric>
+#include <parallelization/ParallelContext.hpp>
+
+void WorkerPool::run(const std::vector<unsigned long> &costs,
+                     const std::function<void(unsigned int)> &job) {
+  assert(ParallelContext::isRandConsistent());
+  auto consistentSeed = Random::getInt();
+  std::vector<unsigned int> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](unsigned int a, unsigned int b) {
+                     return costs[a] > costs[b];
+                   });
+  // every job is the master rank of its own context and would
+  // write its logs: silence them on all the ranks, like the
+  // scheduled jobs. The thread ranks share the streams of the
+  // process, so only one of them changes them
+  bool mute =
+      !ParallelContext::isThreadRank() || ParallelContext::getRank() == 0;
+  ParallelContext::barrier();
+  if (mute) {
+    std::cout.setstate(std::ios::failbit);
+    Logger::enableLogFile(false);
+  }
+  ParallelContext::barrier();
+  ParallelContext::startDynamicTasks();
+  ParallelContext::pushSequentialContext();
+  for (auto i = ParallelContext::getNextTask(); i < order.size();
+       i = ParallelContext::getNextTask()) {
+    job(order[i]);
+  }
+  ParallelContext::popContext();
+  ParallelContext::endDynamicTasks();
+  ParallelContext::barrier();
+  if (mute) {
+    std::cout.clear();
+    Logger::enableLogFile(true);
+  }
+  // seed across ranks might not be consistent anymore
+  Random::setSeed(consistentSeed);
+  ParallelContext::barrier();
+}
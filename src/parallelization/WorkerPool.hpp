@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+/**
+ *  In-process alternative to the Scheduler: the ranks act as
+ *  long-lived workers that run the jobs themselves, such that
+ *  the state shared by all jobs (species tree, rates...) is only
+ *  loaded once per rank, and not once per job.
+ *
+ *  Each job runs on a single rank. The jobs are handed out
+ *  dynamically, from the most to the least expensive one.
+ */
+class WorkerPool {
+public:
+  WorkerPool() = delete;
+
+  /**
+   *  Collective. Call job(i) exactly once for each i < costs.size(),
+   *  on one of the ranks, in a sequential parallel context.
+   *  The logs of the jobs are discarded, as with the Scheduler.
+   *  @param costs The relative cost of each job
+   *  @param job The job to run
+   */
+  static void run(const std::vector<unsigned long> &costs,
+                  const std::function<void(unsigned int)> &job);
+};
@@ -3,6 +3,7 @@
 #include <DistanceMethods/Cherry.hpp>
 #include <DistanceMethods/CherryPro.hpp>
 #include <DistanceMethods/MiniNJ.hpp>
+#include <IO/FamilyMetadataIndex.hpp>
 #include <IO/FileSystem.hpp>
 #include <IO/LibpllParsers.hpp>
 #include <IO/Logger.hpp>
@@ -49,13 +50,27 @@ Routines::computeInitialSpeciesTree(Families &families,
   return nullptr;
 }
 
+/*
+ *  Keep the per-family metadata used for the load balancing in
+ *  the output directory, such that the next steps and a restarted
+ *  run do not need to parse the input files again
+ */
+static void setFamilyMetadataIndex(const std::string &output) {
+  FamilyMetadataIndex::setIndexPath(
+      FileSystem::joinPaths(output, "family_metadata.txt"));
+}
+
 void Routines::runRaxmlOptimization(Families &families,
                                     const std::string &output,
                                     const std::string &execPath,
                                     unsigned int iteration, bool splitImplem,
-                                    long &sumElapsedSec) {
+                                    long &sumElapsedSec,
+                                    bool persistentWorkers,
+                                    unsigned int threadsPerRank) {
+  setFamilyMetadataIndex(output);
   RaxmlMaster::runRaxmlOptimization(families, output, execPath, iteration,
-                                    splitImplem, sumElapsedSec);
+                                    splitImplem, sumElapsedSec,
+                                    persistentWorkers, threadsPerRank);
 }
 
 void Routines::optimizeGeneTrees(
@@ -65,12 +80,29 @@ void Routines::optimizeGeneTrees(
     RecOpt reconciliationOpt, bool madRooting, double supportThreshold,
     double recWeight, bool enableRec, bool enableLibpll, unsigned int sprRadius,
     unsigned int iteration, bool schedulerSplitImplem, long &elapsed,
-    bool inPlace) {
+    bool inPlace, bool persistentWorkers, unsigned int threadsPerRank) {
+  setFamilyMetadataIndex(output);
   GeneRaxMaster::optimizeGeneTrees(
       families, recModelInfo, rates, output, resultName, execPath,
       speciesTreePath, reconciliationOpt, madRooting, supportThreshold,
       recWeight, enableRec, enableLibpll, sprRadius, iteration,
-      schedulerSplitImplem, elapsed, inPlace);
+      schedulerSplitImplem, elapsed, inPlace, persistentWorkers,
+      threadsPerRank);
+}
+
+void Routines::optimizeGeneTreesPipeline(
+    Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
+    const std::string &output, const std::string &resultName,
+    const std::string &speciesTreePath, RecOpt reconciliationOpt,
+    bool madRooting, double supportThreshold, double recWeight,
+    bool enableRec, bool enableLibpll, bool raxmlLight,
+    const std::vector<unsigned int> &sprRadii, unsigned int iteration,
+    long &elapsed, unsigned int threadsPerRank) {
+  setFamilyMetadataIndex(output);
+  GeneRaxMaster::optimizeGeneTreesPipeline(
+      families, recModelInfo, rates, output, resultName, speciesTreePath,
+      reconciliationOpt, madRooting, supportThreshold, recWeight, enableRec,
+      enableLibpll, raxmlLight, sprRadii, iteration, elapsed, threadsPerRank);
 }
 
 void Routines::exportPerSpeciesRates(const std::string &speciesTreeFile,
@@ -81,15 +113,21 @@ void Routines::exportPerSpeciesRates(const std::string &speciesTreeFile,
                << std::endl;
   ParallelOfstream os(outputFile);
   PLLRootedTree speciesTree(speciesTreeFile);
-  auto freeParameters = recModelInfo.modelFreeParameters();
+  // the gamma shape parameter is shared by all species nodes
+  unsigned int gammaParameters = recModelInfo.hasGammaCategories() ? 1 : 0;
+  auto freeParameters = recModelInfo.modelFreeParameters() - gammaParameters;
   auto speciesNodesNumber = speciesTree.getNodeNumber();
-  assert(speciesNodesNumber * freeParameters == rates.dimensions());
+  assert(speciesNodesNumber * freeParameters + gammaParameters ==
+         rates.dimensions());
   for (auto node : speciesTree.getNodes()) {
     auto e = node->node_index;
     os << node->label;
     for (unsigned int i = 0; i < freeParameters; ++i) {
       os << " " << rates[e * freeParameters + i];
     }
+    if (gammaParameters) {
+      os << " " << rates[rates.dimensions() - 1];
+    }
     os << "\n";
   }
 }
@@ -403,8 +441,7 @@ void Routines::gatherLikelihoods(Families &families, double &totalLibpllLL,
     totalRecLL += recLL;
     totalLibpllLL += libpllLL;
   }
-  ParallelContext::sumDouble(totalRecLL);
-  ParallelContext::sumDouble(totalLibpllLL);
+  ParallelContext::sumDoubles({&totalRecLL, &totalLibpllLL});
 }
 
 static const std::string keyDelimiter("-_-");
@@ -35,13 +35,25 @@ public:
    *                   (or the fork)
    *  @param sumElapsedSec will be incremented by the number of
    *                       seconds spent in this call
+   *  @param persistentWorkers run the families in-process on the
+   *                           current ranks instead of scheduling
+   *                           one job per family
+   *  @param threadsPerRank with persistentWorkers, the number of
+   *                        threads each rank uses to split the sites
+   *                        of the long alignments
    */
   static void runRaxmlOptimization(Families &families,
                                    const std::string &output,
                                    const std::string &execPath,
                                    unsigned int iteration, bool splitImplem,
-                                   long &sumElapsedSec);
+                                   long &sumElapsedSec,
+                                   bool persistentWorkers = false,
+                                   unsigned int threadsPerRank = 1);
 
+  /**
+   *  See GeneRaxMaster::optimizeGeneTrees. threadsPerRank has the
+   *  same meaning as in runRaxmlOptimization
+   */
   static void optimizeGeneTrees(
       Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
       const std::string &output, const std::string &resultName,
@@ -49,7 +61,20 @@ public:
       RecOpt reconciliationOpt, bool madRooting, double supportThreshold,
       double recWeight, bool enableRec, bool enableLibpll,
       unsigned int sprRadius, unsigned int iteration, bool schedulerSplitImplem,
-      long &elapsed, bool inPlace = false);
+      long &elapsed, bool inPlace = false, bool persistentWorkers = false,
+      unsigned int threadsPerRank = 1);
+
+  /**
+   *  See GeneRaxMaster::optimizeGeneTreesPipeline
+   */
+  static void optimizeGeneTreesPipeline(
+      Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
+      const std::string &output, const std::string &resultName,
+      const std::string &speciesTreePath, RecOpt reconciliationOpt,
+      bool madRooting, double supportThreshold, double recWeight,
+      bool enableRec, bool enableLibpll, bool raxmlLight,
+      const std::vector<unsigned int> &sprRadii, unsigned int iteration,
+      long &elapsed, unsigned int threadsPerRank = 1);
   /**
    * Optimize the DTL rates for the families families.
    * The result is stored into rates
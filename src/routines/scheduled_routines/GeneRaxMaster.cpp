@@ -4,15 +4,44 @@
 #include <IO/LibpllParsers.hpp>
 #include <IO/Logger.hpp>
 #include <IO/ParallelOfstream.hpp>
+#include <chrono>
 #include <maths/Parameters.hpp>
+#include <parallelization/ParallelContext.hpp>
 #include <parallelization/Scheduler.hpp>
+#include <parallelization/SchedulerCostModel.hpp>
+#include <parallelization/WorkerPool.hpp>
+#include <routines/scheduled_routines/GeneRaxSlave.hpp>
+#include <routines/scheduled_routines/RaxmlSlave.hpp>
 #include <sstream>
+#include <trees/PLLRootedTree.hpp>
 #include <util/RecModelInfo.hpp>
 
 static std::string toArg(const std::string &str) {
   return str.size() ? str : "NONE";
 }
 
+static SchedulerCostModel
+buildCostModel(const Families &families,
+               const std::vector<std::string> &statsFiles,
+               const std::vector<unsigned int> &geneTreeSizes,
+               const RecModelInfo &recModelInfo,
+               const std::string &speciesTreePath, bool enableRec,
+               bool enableLibpll) {
+  // relative shares of the average family cost (the cost model
+  // normalizes each term): the transfers double the reconciliation cost
+  double libpllWeight = enableLibpll ? 1.0 : 0.0;
+  double recCostWeight = 0.0;
+  unsigned int speciesLeaves = 0;
+  if (enableRec) {
+    bool transfers = recModelInfo.model == RecModel::UndatedDTL;
+    recCostWeight = transfers ? 2.0 : 1.0;
+    PLLRootedTree speciesTree(speciesTreePath);
+    speciesLeaves = speciesTree.getLeafNumber();
+  }
+  return SchedulerCostModel(families, statsFiles, geneTreeSizes, libpllWeight,
+                            recCostWeight, speciesLeaves);
+}
+
 void GeneRaxMaster::optimizeGeneTrees(
     Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
     const std::string &output, const std::string &resultName,
@@ -20,7 +49,7 @@ void GeneRaxMaster::optimizeGeneTrees(
     RecOpt recOpt, bool madRooting, double supportThreshold, double recWeight,
     bool enableRec, bool enableLibpll, unsigned int sprRadius,
     unsigned int iteration, bool schedulerSplitImplem, long &elapsed,
-    bool inPlace) {
+    bool inPlace, bool persistentWorkers, unsigned int threadsPerRank) {
   auto start = Logger::getElapsedSec();
   std::stringstream outputDirName;
   outputDirName << "gene_optimization_" << iteration;
@@ -34,10 +63,25 @@ void GeneRaxMaster::optimizeGeneTrees(
   rates.save(ratesFile);
   std::string checkpointDir = FileSystem::joinPaths(outputDir, "checkpoints");
   FileSystem::mkdir(checkpointDir, true);
-  for (size_t i = 0; i < families.size(); ++i) {
-    auto &family = families[i];
+  std::vector<std::string> familyOutputs;
+  std::vector<std::string> statsFiles;
+  for (const auto &family : families) {
     std::string familyOutput = FileSystem::joinPaths(output, resultName);
     familyOutput = FileSystem::joinPaths(familyOutput, family.name);
+    familyOutputs.push_back(familyOutput);
+    statsFiles.push_back(FileSystem::joinPaths(familyOutput, "stats.txt"));
+  }
+  auto costModel =
+      buildCostModel(families, statsFiles, geneTreeSizes, recModelInfo,
+                     speciesTreePath, enableRec, enableLibpll);
+  Logger::info << "Scheduler cost model: " << costModel.getMeasuredNumber()
+               << "/" << families.size() << " measured families"
+               << std::endl;
+  std::vector<std::string> startingGeneTrees;
+  std::vector<std::string> checkpointPaths;
+  for (size_t i = 0; i < families.size(); ++i) {
+    auto &family = families[i];
+    const auto &familyOutput = familyOutputs[i];
     std::string geneTreePath =
         FileSystem::joinPaths(familyOutput, "geneTree.newick");
     std::string checkpointPath =
@@ -46,53 +90,170 @@ void GeneRaxMaster::optimizeGeneTrees(
       // todobenoit make this the normal behavior?
       geneTreePath = family.startingGeneTree;
     }
-    std::string outputStats = FileSystem::joinPaths(familyOutput, "stats.txt");
+    const auto &outputStats = statsFiles[i];
     auto taxa = geneTreeSizes[i];
+    // a job cannot use more cores than gene taxa
     unsigned int cores = 1;
-    if (sprRadius == 1) {
-      cores = taxa / 20;
-    } else if (sprRadius == 2) {
-      cores = taxa / 4;
-    } else if (sprRadius >= 3) {
-      cores = taxa;
-    }
-    if (cores == 0) {
-      cores = 1;
-    }
-    if (!schedulerSplitImplem) {
-      cores = 1;
+    if (schedulerSplitImplem) {
+      cores = costModel.getCores(i, taxa);
     }
-    os << family.name << " ";
-    os << cores << " "; // cores
-    os << taxa << " ";  // cost
-    os << "optimizeGeneTrees" << " ";
-    os << family.startingGeneTree << " ";
-    os << toArg(family.mappingFile) << " ";
-    if (family.alignmentFile != "") {
-      os << family.alignmentFile << " ";
-    } else {
-      os << "NOALIGNMENT" << " ";
+    if (!persistentWorkers) {
+      os << family.name << " ";
+      os << cores << " ";                // cores
+      os << costModel.getCost(i) << " "; // cost
+      os << "optimizeGeneTrees" << " ";
+      os << family.startingGeneTree << " ";
+      os << toArg(family.mappingFile) << " ";
+      if (family.alignmentFile != "") {
+        os << family.alignmentFile << " ";
+      } else {
+        os << "NOALIGNMENT" << " ";
+      }
+      os << speciesTreePath << " ";
+      os << family.libpllModel << " ";
+      os << ratesFile << " ";
+      for (auto &str : recModelInfo.getArgv()) {
+        os << str << " ";
+      }
+      os << static_cast<int>(recOpt) << " ";
+      os << supportThreshold << " ";
+      os << recWeight << " ";
+      os << static_cast<int>(enableRec) << " ";
+      os << static_cast<int>(enableLibpll) << " ";
+      os << sprRadius << " ";
+      os << geneTreePath << " ";
+      os << outputStats << " ";
+      os << static_cast<int>(madRooting) << " ";
+      os << checkpointPath << std::endl;
     }
-    os << speciesTreePath << " ";
-    os << family.libpllModel << " ";
-    os << ratesFile << " ";
-    for (auto &str : recModelInfo.getArgv()) {
-      os << str << " ";
-    }
-    os << static_cast<int>(recOpt) << " ";
-    os << supportThreshold << " ";
-    os << recWeight << " ";
-    os << static_cast<int>(enableRec) << " ";
-    os << static_cast<int>(enableLibpll) << " ";
-    os << sprRadius << " ";
-    os << geneTreePath << " ";
-    os << outputStats << " ";
-    os << static_cast<int>(madRooting) << " ";
-    os << checkpointPath << std::endl;
+    startingGeneTrees.push_back(family.startingGeneTree);
+    checkpointPaths.push_back(checkpointPath);
     family.startingGeneTree = geneTreePath;
     family.statsFile = outputStats;
   }
   os.close();
-  Scheduler::schedule(outputDir, commandFile, schedulerSplitImplem, execPath);
+  if (persistentWorkers) {
+    // each worker parses the species tree once for all its families
+    PLLRootedTree speciesTree(speciesTreePath);
+    std::vector<unsigned long> costs;
+    for (unsigned int i = 0; i < families.size(); ++i) {
+      costs.push_back(costModel.getCost(i));
+    }
+    // the jobs split the sites of their alignment over this team
+    auto previousTeamSize = ParallelContext::getTeamSize();
+    if (threadsPerRank != previousTeamSize) {
+      ParallelContext::setTeamSize(threadsPerRank);
+    }
+    WorkerPool::run(costs, [&](unsigned int i) {
+      const auto &family = families[i];
+      GeneRaxSlave::optimizeGeneTree(
+          startingGeneTrees[i], family.mappingFile, family.alignmentFile,
+          speciesTreePath, family.libpllModel, rates, recModelInfo, recOpt,
+          madRooting, supportThreshold, recWeight, enableRec, enableLibpll,
+          sprRadius, family.startingGeneTree, family.statsFile,
+          checkpointPaths[i], &speciesTree);
+    });
+    if (threadsPerRank != previousTeamSize) {
+      ParallelContext::setTeamSize(previousTeamSize);
+    }
+  } else {
+    Scheduler::schedule(outputDir, commandFile, schedulerSplitImplem,
+                        execPath);
+  }
+  elapsed = (Logger::getElapsedSec() - start);
+}
+
+void GeneRaxMaster::optimizeGeneTreesPipeline(
+    Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
+    const std::string &output, const std::string &resultName,
+    const std::string &speciesTreePath, RecOpt recOpt, bool madRooting,
+    double supportThreshold, double recWeight, bool enableRec,
+    bool enableLibpll, bool raxmlLight,
+    const std::vector<unsigned int> &sprRadii, unsigned int iteration,
+    long &elapsed, unsigned int threadsPerRank) {
+  auto start = Logger::getElapsedSec();
+  std::stringstream outputDirName;
+  outputDirName << "gene_optimization_pipeline_" << iteration;
+  std::string outputDir = FileSystem::joinPaths(output, outputDirName.str());
+  FileSystem::mkdir(outputDir, true);
+  std::string checkpointDir = FileSystem::joinPaths(outputDir, "checkpoints");
+  FileSystem::mkdir(checkpointDir, true);
+  auto geneTreeSizes = LibpllParsers::parallelGetTreeSizes(families);
+  // the runtime of the whole chain of steps of each family
+  std::vector<std::string> pipelineStats;
+  for (const auto &family : families) {
+    std::string familyOutput = FileSystem::joinPaths(output, resultName);
+    familyOutput = FileSystem::joinPaths(familyOutput, family.name);
+    pipelineStats.push_back(FileSystem::joinPaths(familyOutput, "pipeline"));
+  }
+  auto costModel =
+      buildCostModel(families, pipelineStats, geneTreeSizes, recModelInfo,
+                     speciesTreePath, enableRec, enableLibpll);
+  std::vector<unsigned long> costs;
+  for (unsigned int i = 0; i < families.size(); ++i) {
+    costs.push_back(costModel.getCost(i));
+  }
+  // the families after the last step, updated once all workers are done
+  auto outputFamilies = families;
+  for (auto &family : outputFamilies) {
+    std::string familyOutput = FileSystem::joinPaths(output, resultName);
+    familyOutput = FileSystem::joinPaths(familyOutput, family.name);
+    if (raxmlLight) {
+      std::string raxmlOutput = FileSystem::joinPaths(output, "results");
+      raxmlOutput = FileSystem::joinPaths(raxmlOutput, family.name);
+      family.startingGeneTree =
+          FileSystem::joinPaths(raxmlOutput, "geneTree.newick");
+      family.libpllModel =
+          FileSystem::joinPaths(raxmlOutput, "libpllModel.txt");
+      family.statsFile =
+          FileSystem::joinPaths(raxmlOutput, "raxml_light_stats.txt");
+    }
+    if (sprRadii.size()) {
+      family.startingGeneTree =
+          FileSystem::joinPaths(familyOutput, "geneTree.newick");
+      family.statsFile = FileSystem::joinPaths(familyOutput, "stats.txt");
+    }
+  }
+  PLLRootedTree speciesTree(speciesTreePath);
+  // the jobs split the sites of their alignment over this team
+  auto previousTeamSize = ParallelContext::getTeamSize();
+  if (threadsPerRank != previousTeamSize) {
+    ParallelContext::setTeamSize(threadsPerRank);
+  }
+  WorkerPool::run(costs, [&](unsigned int i) {
+    auto jobStart = std::chrono::high_resolution_clock::now();
+    const auto &family = families[i];
+    const auto &outputFamily = outputFamilies[i];
+    auto geneTree = family.startingGeneTree;
+    if (raxmlLight) {
+      RaxmlSlave::optimizeGeneTree(geneTree, family.alignmentFile,
+                                   family.libpllModel,
+                                   outputFamily.startingGeneTree,
+                                   outputFamily.libpllModel,
+                                   outputFamily.statsFile);
+      geneTree = outputFamily.startingGeneTree;
+    }
+    for (auto radius : sprRadii) {
+      // one checkpoint per step, to restart from the right one
+      std::string checkpointPath = FileSystem::joinPaths(
+          checkpointDir, family.name + "_" + std::to_string(radius));
+      // all the steps write the same stats file: only the runtime of
+      // the whole chain is saved, in pipelineStats
+      GeneRaxSlave::optimizeGeneTree(
+          geneTree, family.mappingFile, family.alignmentFile, speciesTreePath,
+          outputFamily.libpllModel, rates, recModelInfo, recOpt, madRooting,
+          supportThreshold, recWeight, enableRec, enableLibpll, radius,
+          outputFamily.startingGeneTree, outputFamily.statsFile,
+          checkpointPath, &speciesTree, false);
+      geneTree = outputFamily.startingGeneTree;
+    }
+    std::chrono::duration<double> jobElapsed =
+        std::chrono::high_resolution_clock::now() - jobStart;
+    SchedulerCostModel::saveRuntime(pipelineStats[i], jobElapsed.count());
+  });
+  if (threadsPerRank != previousTeamSize) {
+    ParallelContext::setTeamSize(previousTeamSize);
+  }
+  families = outputFamilies;
   elapsed = (Logger::getElapsedSec() - start);
 }
@@ -19,5 +19,27 @@ public:
       RecOpt reconciliationOpt, bool madRooting, double supportThreshold,
       double recWeight, bool enableRec, bool enableLibpll,
       unsigned int sprRadius, unsigned int iteration, bool schedulerSplitImplem,
-      long &elapsed, bool inPlace = false);
+      long &elapsed, bool inPlace = false, bool persistentWorkers = false,
+      unsigned int threadsPerRank = 1);
+
+  /**
+   *  Pipelined alternative to RaxmlMaster::runRaxmlOptimization
+   *  (if raxmlLight is set) followed by one optimizeGeneTrees call
+   *  per radius of sprRadii: each family goes through all these
+   *  steps in a row on one worker (see WorkerPool), without waiting
+   *  for the other families between two steps.
+   *  The caller cannot run any global step in between (such as the
+   *  optimization of global DTL rates): all the steps use rates.
+   *  threadsPerRank is the number of threads each rank uses to split
+   *  the sites of the long alignments (see LibpllEvaluation), as in
+   *  optimizeGeneTrees with persistentWorkers.
+   */
+  static void optimizeGeneTreesPipeline(
+      Families &families, const RecModelInfo &recModelInfo, Parameters &rates,
+      const std::string &output, const std::string &resultName,
+      const std::string &speciesTreePath, RecOpt reconciliationOpt,
+      bool madRooting, double supportThreshold, double recWeight,
+      bool enableRec, bool enableLibpll, bool raxmlLight,
+      const std::vector<unsigned int> &sprRadii, unsigned int iteration,
+      long &elapsed, unsigned int threadsPerRank = 1);
 };
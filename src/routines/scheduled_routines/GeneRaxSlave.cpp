@@ -11,6 +11,7 @@
 #include <optimizers/DTLOptimizer.hpp>
 #include <parallelization/ParallelContext.hpp>
 #include <parallelization/PerCoreGeneTrees.hpp>
+#include <parallelization/SchedulerCostModel.hpp>
 #include <routines/scheduled_routines/RaxmlSlave.hpp>
 #include <search/SPRSearch.hpp>
 #include <sstream>
@@ -35,27 +36,28 @@ static void getTreeStrings(const std::string &filename,
   }
 }
 
-static void optimizeGeneTreesSlave(
+void GeneRaxSlave::optimizeGeneTree(
     const std::string &startingGeneTreeFile, const std::string &mappingFile,
     const std::string &alignmentFile, const std::string &speciesTreeFile,
-    const std::string &libpllModel, const std::string &ratesFile,
+    const std::string &libpllModel, const Parameters &ratesVector,
     const RecModelInfo &recModelInfo, RecOpt recOpt, bool madRooting,
     double supportThreshold, double recWeight, bool enableRec,
     bool enableLibpll, int sprRadius, const std::string &outputGeneTree,
-    const std::string &outputStats, const std::string &checkpointPath) {
+    const std::string &outputStats, const std::string &checkpointPath,
+    PLLRootedTree *sharedSpeciesTree, bool saveRuntime) {
   auto start = std::chrono::high_resolution_clock::now();
   Logger::timed << "Starting optimizing gene tree" << std::endl;
   Logger::info << "Number of ranks " << ParallelContext::getSize() << std::endl;
   std::vector<std::string> geneTreeStrings;
   getTreeStrings(startingGeneTreeFile, geneTreeStrings);
   assert(geneTreeStrings.size() == 1);
-  Parameters ratesVector(ratesFile);
   auto jointTree = std::make_unique<JointTree>(
       geneTreeStrings[0], alignmentFile, speciesTreeFile, mappingFile,
       libpllModel, recModelInfo, recOpt, madRooting, supportThreshold,
       recWeight,
       false, // check
-      recModelInfo.perFamilyRates, ratesVector, checkpointPath);
+      recModelInfo.perFamilyRates, ratesVector, checkpointPath,
+      sharedSpeciesTree);
   jointTree->enableReconciliation(enableRec);
   jointTree->enableLibpll(enableLibpll);
   Logger::info << "Taxa number: " << jointTree->getGeneTaxaNumber()
@@ -99,6 +101,9 @@ static void optimizeGeneTreesSlave(
       std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
   Logger::timed << "End of optimizing gene tree after " << seconds << "s"
                 << std::endl;
+  if (saveRuntime && outputStats.size()) {
+    SchedulerCostModel::saveRuntime(outputStats, elapsed.count());
+  }
   ParallelContext::barrier();
 }
 
@@ -136,11 +141,12 @@ int GeneRaxSlave::optimizeGeneTreesMain(int argc, char **argv, void *comm) {
   std::string outputStats(argv[i++]);
   bool madRooting = bool(atoi(argv[i++]));
   std::string checkpointPath(argv[i++]);
-  optimizeGeneTreesSlave(startingGeneTreeFile, mappingFile, alignmentFile,
-                         speciesTreeFile, libpllModel, ratesFile, recModelInfo,
-                         recOpt, madRooting, supportThreshold, recWeight,
-                         enableRec, enableLibpll, sprRadius, outputGeneTree,
-                         outputStats, checkpointPath);
+  Parameters ratesVector(ratesFile);
+  optimizeGeneTree(startingGeneTreeFile, mappingFile, alignmentFile,
+                   speciesTreeFile, libpllModel, ratesVector, recModelInfo,
+                   recOpt, madRooting, supportThreshold, recWeight, enableRec,
+                   enableLibpll, sprRadius, outputGeneTree, outputStats,
+                   checkpointPath);
   ParallelContext::finalize();
   Logger::timed << "End of optimizeGeneTreesSlave" << std::endl;
   return 0;
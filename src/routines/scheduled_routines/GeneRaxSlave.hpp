@@ -1,7 +1,34 @@
 #pragma once
 
+#include <string>
+#include <util/enums.hpp>
+
+class Parameters;
+class PLLRootedTree;
+struct RecModelInfo;
+
 class GeneRaxSlave {
 public:
   GeneRaxSlave() = delete;
   static int optimizeGeneTreesMain(int argc, char **argv, void *comm);
+
+  /**
+   *  Optimize the gene tree of one family on the current parallel
+   *  context, and write the results into outputGeneTree and
+   *  outputStats. The arguments are the ones of the scheduled
+   *  optimizeGeneTrees job, but the rates are already loaded, and
+   *  the species tree can be shared by several calls
+   *  (sharedSpeciesTree). If not set, it is read from speciesTreeFile.
+   *  If saveRuntime is set, the runtime is saved for the cost model
+   *  of the next scheduled steps (see SchedulerCostModel::saveRuntime).
+   */
+  static void optimizeGeneTree(
+      const std::string &startingGeneTreeFile, const std::string &mappingFile,
+      const std::string &alignmentFile, const std::string &speciesTreeFile,
+      const std::string &libpllModel, const Parameters &ratesVector,
+      const RecModelInfo &recModelInfo, RecOpt recOpt, bool madRooting,
+      double supportThreshold, double recWeight, bool enableRec,
+      bool enableLibpll, int sprRadius, const std::string &outputGeneTree,
+      const std::string &outputStats, const std::string &checkpointPath,
+      PLLRootedTree *sharedSpeciesTree = nullptr, bool saveRuntime = true);
 };
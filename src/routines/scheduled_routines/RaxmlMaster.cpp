@@ -5,14 +5,20 @@
 #include <IO/Logger.hpp>
 #include <IO/ParallelOfstream.hpp>
 #include <functional>
+#include <parallelization/ParallelContext.hpp>
 #include <parallelization/Scheduler.hpp>
+#include <parallelization/SchedulerCostModel.hpp>
+#include <parallelization/WorkerPool.hpp>
+#include <routines/scheduled_routines/RaxmlSlave.hpp>
 #include <sstream>
 
 void RaxmlMaster::runRaxmlOptimization(Families &families,
                                        const std::string &output,
                                        const std::string &execPath,
                                        unsigned int iteration, bool splitImplem,
-                                       long &sumElapsedSec)
+                                       long &sumElapsedSec,
+                                       bool persistentWorkers,
+                                       unsigned int threadsPerRank)
 
 {
   auto start = Logger::getElapsedSec();
@@ -24,34 +30,70 @@ void RaxmlMaster::runRaxmlOptimization(Families &families,
   std::string commandFile =
       FileSystem::joinPaths(outputDir, "raxml_light_command.txt");
   auto geneTreeSizes = LibpllParsers::parallelGetTreeSizes(families);
+  std::vector<std::string> familyOutputs;
+  std::vector<std::string> statsFiles;
+  for (const auto &family : families) {
+    std::string familyOutput = FileSystem::joinPaths(output, "results");
+    familyOutput = FileSystem::joinPaths(familyOutput, family.name);
+    familyOutputs.push_back(familyOutput);
+    statsFiles.push_back(
+        FileSystem::joinPaths(familyOutput, "raxml_light_stats.txt"));
+  }
+  // only the sequence likelihood is computed in this step
+  SchedulerCostModel costModel(families, statsFiles, geneTreeSizes, 1.0, 0.0,
+                               0);
   ParallelOfstream os(commandFile);
+  std::vector<std::string> startingGeneTrees;
+  std::vector<std::string> startingModels;
   for (size_t i = 0; i < families.size(); ++i) {
     auto &family = families[i];
-    std::string familyOutput = FileSystem::joinPaths(output, "results");
-    familyOutput = FileSystem::joinPaths(familyOutput, family.name);
+    const auto &familyOutput = familyOutputs[i];
     std::string geneTreePath =
         FileSystem::joinPaths(familyOutput, "geneTree.newick");
     std::string libpllModelPath =
         FileSystem::joinPaths(familyOutput, "libpllModel.txt");
-    std::string outputStats =
-        FileSystem::joinPaths(familyOutput, "raxml_light_stats.txt");
-    auto taxa = geneTreeSizes[i];
-    os << family.name << " ";
-    os << 1 << " ";    // cores
-    os << taxa << " "; // cost
-    os << "raxmlLight" << " ";
-    os << family.startingGeneTree << " ";
-    os << family.alignmentFile << " ";
-    os << family.libpllModel << " ";
-    os << geneTreePath << " ";
-    os << libpllModelPath << " ";
-    os << outputStats << std::endl;
+    const auto &outputStats = statsFiles[i];
+    if (!persistentWorkers) {
+      os << family.name << " ";
+      os << 1 << " ";                    // cores
+      os << costModel.getCost(i) << " "; // cost
+      os << "raxmlLight" << " ";
+      os << family.startingGeneTree << " ";
+      os << family.alignmentFile << " ";
+      os << family.libpllModel << " ";
+      os << geneTreePath << " ";
+      os << libpllModelPath << " ";
+      os << outputStats << std::endl;
+    }
+    startingGeneTrees.push_back(family.startingGeneTree);
+    startingModels.push_back(family.libpllModel);
     family.startingGeneTree = geneTreePath;
     family.statsFile = outputStats;
     family.libpllModel = libpllModelPath;
   }
   os.close();
-  Scheduler::schedule(outputDir, commandFile, splitImplem, execPath);
+  if (persistentWorkers) {
+    std::vector<unsigned long> costs;
+    for (unsigned int i = 0; i < families.size(); ++i) {
+      costs.push_back(costModel.getCost(i));
+    }
+    // the jobs split the sites of their alignment over this team
+    auto previousTeamSize = ParallelContext::getTeamSize();
+    if (threadsPerRank != previousTeamSize) {
+      ParallelContext::setTeamSize(threadsPerRank);
+    }
+    WorkerPool::run(costs, [&](unsigned int i) {
+      const auto &family = families[i];
+      RaxmlSlave::optimizeGeneTree(startingGeneTrees[i], family.alignmentFile,
+                                   startingModels[i], family.startingGeneTree,
+                                   family.libpllModel, family.statsFile);
+    });
+    if (threadsPerRank != previousTeamSize) {
+      ParallelContext::setTeamSize(previousTeamSize);
+    }
+  } else {
+    Scheduler::schedule(outputDir, commandFile, splitImplem, execPath);
+  }
   auto elapsed = (Logger::getElapsedSec() - start);
   sumElapsedSec += elapsed;
   Logger::timed << "End of raxml light step (after " << elapsed << "s)"
@@ -11,5 +11,7 @@ public:
                                    const std::string &output,
                                    const std::string &execPath,
                                    unsigned int iteration, bool splitImplem,
-                                   long &sumElapsedSec);
+                                   long &sumElapsedSec,
+                                   bool persistentWorkers = false,
+                                   unsigned int threadsPerRank = 1);
 };
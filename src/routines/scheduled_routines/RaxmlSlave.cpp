@@ -8,7 +8,9 @@
 #include <IO/Logger.hpp>
 #include <IO/ParallelOfstream.hpp>
 #include <likelihoods/LibpllEvaluation.hpp>
+#include <chrono>
 #include <parallelization/ParallelContext.hpp>
+#include <parallelization/SchedulerCostModel.hpp>
 #include <string>
 
 static void optimizeParameters(LibpllEvaluation &evaluation, double radius) {
@@ -47,9 +49,23 @@ int RaxmlSlave::runRaxmlOptimization(int argc, char **argv, void *comm) {
   std::string outputGeneTree(argv[i++]);
   std::string outputLibpllModel(argv[i++]);
   std::string outputStats(argv[i++]);
+  optimizeGeneTree(startingGeneTreeFile, alignmentFile, libpllModel,
+                   outputGeneTree, outputLibpllModel, outputStats);
+  ParallelContext::finalize();
+  return 0;
+}
+
+void RaxmlSlave::optimizeGeneTree(const std::string &startingGeneTreeFile,
+                                  const std::string &alignmentFile,
+                                  const std::string &libpllModel,
+                                  const std::string &outputGeneTree,
+                                  const std::string &outputLibpllModel,
+                                  const std::string &outputStats) {
+  auto start = std::chrono::high_resolution_clock::now();
   Logger::info << startingGeneTreeFile << std::endl;
+  // split long alignments over the team of this rank, if any
   LibpllEvaluation evaluation(startingGeneTreeFile, true, alignmentFile,
-                              libpllModel);
+                              libpllModel, true);
   Logger::timed << "LL = " << evaluation.computeLikelihood(false) << std::endl;
   optimizeBranches(evaluation, 1.0);
   optimizeParameters(evaluation, 10.0);
@@ -93,6 +109,7 @@ int RaxmlSlave::runRaxmlOptimization(int argc, char **argv, void *comm) {
   modelWriter << modelStr << std::endl;
   modelWriter.close();
   LibpllParsers::saveUtree(evaluation.getTreeInfo()->root, outputGeneTree);
-  ParallelContext::finalize();
-  return 0;
+  std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  SchedulerCostModel::saveRuntime(outputStats, elapsed.count());
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 class RaxmlSlave {
 public:
   RaxmlSlave() = delete;
@@ -13,4 +15,15 @@ public:
    *
    */
   static int runRaxmlOptimization(int argc, char **argv, void *comm);
+
+  /**
+   *  Optimize the gene tree and the model of one family on the
+   *  current parallel context, without going through argv
+   */
+  static void optimizeGeneTree(const std::string &startingGeneTreeFile,
+                               const std::string &alignmentFile,
+                               const std::string &libpllModel,
+                               const std::string &outputGeneTree,
+                               const std::string &outputLibpllModel,
+                               const std::string &outputStats);
 };
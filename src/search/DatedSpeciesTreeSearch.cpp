@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 #include "SpeciesSearchCommon.hpp"
 #include "SpeciesTransferSearch.hpp"
@@ -14,6 +15,15 @@
 // Search for the speciation order (dating) optimizing the score returned by
 // the evaluator. If searchState is provided and the score gets higher than
 // searchState.bestLL, save the new best tree and update searchState.bestLL
+//
+// The swaps of consecutive ranks are evaluated in batches from the same
+// dating, and the first improving swap of a batch is applied: this follows
+// exactly the same path as testing the swaps one after another, but lets
+// the evaluator share the work between the swaps of a batch. The batch
+// size grows while no swap improves the score. If the evaluator does not
+// provide a cheap evaluation of the rank swaps, each swap costs a full
+// evaluation and speculative batches would only multiply the work: the
+// swaps are then evaluated one at a time
 static double
 optimizeDatesLocal(SpeciesTree &speciesTree,
                    SpeciesTreeLikelihoodEvaluatorInterface &evaluator,
@@ -25,29 +35,51 @@ optimizeDatesLocal(SpeciesTree &speciesTree,
     Logger::timed << "Starting new naive dating search from ll=" << bestLL
                   << std::endl;
   }
+  const unsigned int maxBatchSize = evaluator.providesRankSwapImpl() ? 32 : 1;
   bool tryAgain = false;
   auto maxRank = datedTree.getRootedTree().getInnerNodeNumber();
   do {
     auto initialItLL = bestLL;
-    for (unsigned int rank = 0; rank < maxRank; ++rank) {
-      if (!datedTree.moveUp(rank)) { // the node with rank gets rank-1
+    unsigned int batchSize = 1;
+    unsigned int rank = 0;
+    while (rank < maxRank) {
+      std::vector<unsigned int> ranks;
+      for (auto r = rank; r < maxRank && ranks.size() < batchSize; ++r) {
+        if (datedTree.canMoveUp(r)) {
+          ranks.push_back(r);
+        }
+      }
+      if (ranks.empty()) {
+        break;
+      }
+      std::vector<double> lls;
+      std::vector<PerFamLL> perFamLLs;
+      evaluator.computeRankSwapLikelihoods(speciesTree, bestLL, ranks, lls,
+                                           searchState ? &perFamLLs : nullptr);
+      unsigned int i = 0;
+      while (i < ranks.size() && !(lls[i] > bestLL)) {
+        ++i;
+      }
+      if (i == ranks.size()) {
+        // no improvement in this batch
+        rank = ranks.back() + 1;
+        batchSize = std::min(2 * batchSize, maxBatchSize);
         continue;
       }
+      // the node with rank gets rank-1
+      rank = ranks[i];
+      datedTree.moveUp(rank);
       speciesTree.onSpeciesDatesChange();
-      PerFamLL perFamLL;
-      auto ll = evaluator.computeLikelihood(&perFamLL);
-      if (searchState && ll > searchState->bestLL) {
+      // the best tree over all performed iterations
+      bestLL = lls[i];
+      if (searchState && bestLL > searchState->bestLL) {
         // the tree is better than the last saved tree
         // update searchState to save the tree
-        searchState->betterTreeCallback(ll, perFamLL);
-      }
-      if (ll > bestLL) {
-        // the best tree over all performed iterations
-        bestLL = ll;
-        rank -= std::min(2u, rank);
-      } else {
-        datedTree.moveUp(rank); // reversal: the node with rank-1 gets rank
+        searchState->betterTreeCallback(bestLL, perFamLLs[i]);
       }
+      rank -= std::min(2u, rank);
+      rank++;
+      batchSize = 1;
     }
     // we'll run another iteration only if the improvement is above 1.0
     tryAgain = (bestLL - initialItLL > 1.0);
@@ -169,11 +201,20 @@ class TransferScoreEvaluator : public SpeciesTreeLikelihoodEvaluatorInterface {
 private:
   SpeciesTree &_speciesTree;
   TransferFrequencies &_frequencies;
+  // species node index to index in _frequencies
+  std::vector<unsigned int> _nodeToFrequencyId;
 
 public:
   TransferScoreEvaluator(SpeciesTree &speciesTree,
                          TransferFrequencies &frequencies)
-      : _speciesTree(speciesTree), _frequencies(frequencies) {}
+      : _speciesTree(speciesTree), _frequencies(frequencies) {
+    StringToUint labelToId;
+    speciesTree.getLabelToId(labelToId);
+    _nodeToFrequencyId.resize(labelToId.size());
+    for (unsigned int i = 0; i < frequencies.idToLabel.size(); ++i) {
+      _nodeToFrequencyId[labelToId[frequencies.idToLabel[i]]] = i;
+    }
+  }
   virtual double computeLikelihood(PerFamLL *perFamLL = nullptr) {
     (void)(perFamLL);
     return computeLikelihoodFast();
@@ -181,6 +222,39 @@ public:
   virtual double computeLikelihoodFast() {
     return getTransferScore(_speciesTree, _frequencies);
   }
+  /**
+   *  Swapping the ranks of two speciations n1 and n2 only changes
+   *  whether the children of n1 can transfer to n2 and whether the
+   *  children of n2 can transfer to n1: each swap is evaluated from
+   *  these four transfer counts only. The frequencies are the same on
+   *  all ranks, so that no communication is needed
+   */
+  virtual void
+  computeRankSwapLikelihoods(SpeciesTree &speciesTree, double currentLL,
+                             const std::vector<unsigned int> &ranks,
+                             std::vector<double> &lls,
+                             std::vector<PerFamLL> *perFamLLs) {
+    auto &datedTree = speciesTree.getDatedTree();
+    auto &speciations = datedTree.getOrderedSpeciations();
+    lls.assign(ranks.size(), -std::numeric_limits<double>::infinity());
+    if (perFamLLs) {
+      perFamLLs->assign(ranks.size(), PerFamLL());
+    }
+    for (unsigned int i = 0; i < ranks.size(); ++i) {
+      if (!datedTree.canMoveUp(ranks[i])) {
+        continue;
+      }
+      // n1 currently has a lower rank than n2
+      auto n1 = speciations[ranks[i] - 1];
+      auto n2 = speciations[ranks[i]];
+      auto delta = getTransferCount(n2->left, n1) +
+                   getTransferCount(n2->right, n1) -
+                   getTransferCount(n1->left, n2) -
+                   getTransferCount(n1->right, n2);
+      lls[i] = currentLL + delta;
+    }
+  }
+  virtual bool providesRankSwapImpl() const { return true; }
   virtual bool providesFastLikelihoodImpl() const { assert(false); }
   virtual bool isDated() const { assert(false); }
   virtual double optimizeModelRates(bool) { assert(false); }
@@ -198,6 +272,13 @@ public:
     assert(false);
   }
   virtual bool isVerbose() const { return false; }
+
+private:
+  double getTransferCount(corax_rnode_t *src, corax_rnode_t *dest) const {
+    auto from = _nodeToFrequencyId[src->node_index];
+    auto to = _nodeToFrequencyId[dest->node_index];
+    return static_cast<double>(_frequencies.count[from][to]);
+  }
 };
 
 ScoredBackups DatedSpeciesTreeSearch::getBestDatingsFromReconciliation(
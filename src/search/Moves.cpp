@@ -28,24 +28,14 @@ SPRMove::createSPRMove(unsigned int pruneIndex, unsigned int regraftIndex,
 static void
 optimizeBranchesSlow(JointTree &tree,
                      const std::vector<corax_unode_t *> &nodesToOptimize) {
-  auto root = tree.getTreeInfo()->root;
-  // could be incremental and thus faster
-  auto treeinfo = tree.getTreeInfo();
-  auto ratecats = tree.getModel().num_ratecats();
-  std::vector<unsigned int> params_indices(ratecats, 0);
-  tree.computeLibpllLoglk(); // update CLVs
-  for (unsigned int j = 0; j < 2; ++j) {
-    for (unsigned int i = 0; i < nodesToOptimize.size(); ++i) {
-      corax_treeinfo_set_root(treeinfo, nodesToOptimize[i]);
-      double oldLoglk = tree.computeLibpllLoglk(true);
-      double newLoglk = corax_opt_optimize_branch_lengths_local(
-          treeinfo->partitions[0], treeinfo->root, &params_indices[0],
-          RAXML_BRLEN_MIN, RAXML_BRLEN_MAX, RAXML_BRLEN_TOLERANCE,
-          RAXML_BRLEN_SMOOTHINGS, 0, true);
-      assert(oldLoglk <= newLoglk);
-    }
+  // through the libpll evaluation, such that the optimization
+  // runs on its site slices if it has any
+  std::vector<unsigned int> nodeIndices;
+  for (auto node : nodesToOptimize) {
+    nodeIndices.push_back(node->node_index);
   }
-  corax_treeinfo_set_root(treeinfo, root);
+  tree.getLibpllEvaluation().optimizeLocalBranches(
+      nodeIndices, RAXML_BRLEN_TOLERANCE, RAXML_BRLEN_SMOOTHINGS);
 }
 
 SPRMove::SPRMove(unsigned int pruneIndex, unsigned int regraftIndex,
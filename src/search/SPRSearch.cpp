@@ -3,6 +3,7 @@
 #include "Moves.hpp"
 #include "SearchUtils.hpp"
 #include <IO/Logger.hpp>
+#include <algorithm>
 #include <parallelization/ParallelContext.hpp>
 #include <trees/JointTree.hpp>
 
@@ -42,6 +43,65 @@ static void getAllPruneIndices(JointTree &tree,
   */
 }
 
+struct ScoredPrune {
+  ScoredPrune(unsigned int i, double s) : index(i), score(s) {}
+  unsigned int index;
+  double score;
+};
+
+struct less_than_prune {
+  inline bool operator()(const ScoredPrune &m1, const ScoredPrune &m2) {
+    if (m1.score != m2.score) {
+      return (m1.score < m2.score);
+    }
+    return m1.index < m2.index;
+  }
+};
+
+/*
+ *  Number of regraft nodes within maxRadius from regraftNode, as
+ *  visited by SearchUtils::diggBestMoveFromPrune
+ */
+static unsigned int countRegrafts(JointTree &jointTree,
+                                  corax_unode_t *regraftNode,
+                                  unsigned int radius, unsigned int maxRadius) {
+  if (radius >= maxRadius) {
+    return 0;
+  }
+  unsigned int res = 1;
+  radius += 1;
+  if (regraftNode->next && radius < maxRadius &&
+      jointTree.canSPRCrossBranch(regraftNode)) {
+    res += countRegrafts(jointTree, regraftNode->next->back, radius,
+                         maxRadius);
+    res += countRegrafts(jointTree, regraftNode->next->next->back, radius,
+                         maxRadius);
+  }
+  return res;
+}
+
+/*
+ *  Sort the prune indices from the most to the least expensive, the
+ *  cost of a prune node being estimated from the number of regrafts
+ *  to test
+ */
+static void sortPruneIndicesByCost(JointTree &jointTree,
+                                   unsigned int maxRadius,
+                                   std::vector<unsigned int> &pruneIndices) {
+  std::vector<ScoredPrune> scoredPrunes;
+  for (auto pruneIndex : pruneIndices) {
+    auto pruneNode = jointTree.getNode(pruneIndex);
+    auto cost = countRegrafts(jointTree, pruneNode->next->back, 0, maxRadius) +
+                countRegrafts(jointTree, pruneNode->next->next->back, 0,
+                              maxRadius);
+    scoredPrunes.push_back(ScoredPrune(pruneIndex, -double(cost)));
+  }
+  std::sort(scoredPrunes.begin(), scoredPrunes.end(), less_than_prune());
+  for (unsigned int i = 0; i < scoredPrunes.size(); ++i) {
+    pruneIndices[i] = scoredPrunes[i].index;
+  }
+}
+
 static bool sprYeldsSameTree(corax_unode_t *p, corax_unode_t *r) {
   assert(p);
   assert(r);
@@ -78,57 +138,18 @@ static bool wasInvolved(corax_unode_t *node,
   return involved.find(node) != involved.end();
 }
 
-static bool sequentiallyApplyBetterMoves(
-    JointTree &jointTree,
-    const std::vector<std::shared_ptr<SPRMove>> &betterMoves, bool blo,
-    double &bestLoglk) {
-  Logger::timed << "\tGeneRax will now test and apply all the "
-                << betterMoves.size()
-                << " potential good moves one after each other" << std::endl;
-  bool foundBetterMove = false;
+/*
+ *  Split the moves (sorted from the best to the worst) into a maximal
+ *  set of moves that touch disjoint regions of the tree, and the moves
+ *  that conflict with them. Invalid moves are dropped
+ */
+static void
+selectCompatibleMoves(JointTree &jointTree,
+                      const std::vector<std::shared_ptr<SPRMove>> &moves,
+                      std::vector<std::shared_ptr<SPRMove>> &compatible,
+                      std::vector<std::shared_ptr<SPRMove>> &conflicting) {
   std::unordered_set<corax_unode_t *> involved;
-  for (auto move : betterMoves) {
-    auto prune = jointTree.getNode(move->getPruneIndex());
-    auto regraft = jointTree.getNode(move->getRegraftIndex());
-    if (wasInvolved(prune, involved) || wasInvolved(regraft, involved)) {
-      continue;
-    }
-    if (!isSPRMoveValid(jointTree.getGeneTree(), prune, regraft)) {
-      continue;
-    }
-    addInvolvedNode(prune, involved);
-    addInvolvedNode(regraft, involved);
-    move->updatePath(jointTree);
-    jointTree.applyMove(*move);
-    if (blo) {
-      jointTree.optimizeMove(*move);
-    }
-    double ll = jointTree.computeJointLoglk();
-    if (ll < bestLoglk) {
-      Logger::info << "\tWorse likelihood, Move rejected" << std::endl;
-      jointTree.rollbackLastMove();
-      ll = jointTree.computeJointLoglk();
-    } else {
-      foundBetterMove = true;
-      bestLoglk = ll;
-      Logger::info << "\tApplying move, ll = " << ll << ", "
-                   << move->getPruneIndex() << " " << move->getRegraftIndex()
-                   << std::endl;
-    }
-  }
-  return foundBetterMove;
-}
-
-static bool simultaneouslyApplyBetterMoves(
-    JointTree &jointTree,
-    const std::vector<std::shared_ptr<SPRMove>> &betterMoves, bool blo,
-    double &bestLoglk, std::unordered_set<corax_unode_t *> &involved,
-    std::vector<std::shared_ptr<SPRMove>> &movesToRetry) {
-  double initialLoglk = bestLoglk;
-  Logger::timed << "\tApplying a chunk of " << betterMoves.size()
-                << " potential good moves simultaneously..." << std::endl;
-  std::vector<std::shared_ptr<SPRMove>> appliedMoves;
-  for (auto move : betterMoves) {
+  for (auto move : moves) {
     auto prune = jointTree.getNode(move->getPruneIndex());
     auto regraft = jointTree.getNode(move->getRegraftIndex());
     if (!isSPRMoveValid(jointTree.getGeneTree(), prune, regraft)) {
@@ -138,100 +159,97 @@ static bool simultaneouslyApplyBetterMoves(
     auto r = regraft;
     std::vector<corax_unode_t *> branches;
     PLLUnrootedTree::orientTowardEachOther(&p, &r, branches);
-    bool skip = false;
+    bool conflict = false;
     for (auto b : branches) {
-      if (wasInvolved(b, involved)) {
-        skip = true;
-      }
+      conflict |= wasInvolved(b, involved);
     }
-    if (skip) {
-      movesToRetry.push_back(move);
+    if (conflict) {
+      conflicting.push_back(move);
       continue;
     }
     for (auto b : branches) {
       addInvolvedNode(b, involved);
       addInvolvedNode(b->back, involved);
     }
+    compatible.push_back(move);
+  }
+}
+
+/*
+ *  Apply compatible moves together and evaluate the resulting tree
+ *  once. Keep them if the likelihood improves, and otherwise rollback
+ *  them and try again with each half of the moves.
+ *  Return true if some moves were kept
+ */
+static bool
+commitCompatibleMoves(JointTree &jointTree,
+                      const std::vector<std::shared_ptr<SPRMove>> &moves,
+                      bool blo, double &bestLoglk) {
+  if (moves.empty()) {
+    return false;
+  }
+  for (auto move : moves) {
     move->updatePath(jointTree);
     jointTree.applyMove(*move);
-    appliedMoves.push_back(move);
     if (blo) {
-      jointTree.reOptimizeMove(*move);
+      jointTree.optimizeMove(*move);
     }
   }
-  bestLoglk = jointTree.computeJointLoglk();
-  if (bestLoglk < initialLoglk) {
-    Logger::timed << "\tWorse likelihood (" << bestLoglk
-                  << ")! Rollbacking all moves! " << bestLoglk << std::endl;
-    for (auto move : appliedMoves) {
-      jointTree.rollbackLastMove();
-      movesToRetry.push_back(move);
-    }
-    bestLoglk = jointTree.computeJointLoglk();
+  double ll = jointTree.computeJointLoglk();
+  if (ll > bestLoglk) {
+    bestLoglk = ll;
+    Logger::info << "\tApplying " << moves.size() << " moves, ll = " << ll
+                 << std::endl;
+    return true;
+  }
+  for (unsigned int i = 0; i < moves.size(); ++i) {
+    jointTree.rollbackLastMove();
+  }
+  if (moves.size() == 1) {
     return false;
   }
-  Logger::timed << "\tAfter applying the chunk of moves, ll = " << bestLoglk
-                << std::endl;
-  return true;
+  // the moves touch disjoint regions: each half is still compatible,
+  // even after applying the other one
+  auto middle = moves.begin() + moves.size() / 2;
+  std::vector<std::shared_ptr<SPRMove>> firstHalf(moves.begin(), middle);
+  std::vector<std::shared_ptr<SPRMove>> secondHalf(middle, moves.end());
+  bool applied = commitCompatibleMoves(jointTree, firstHalf, blo, bestLoglk);
+  applied |= commitCompatibleMoves(jointTree, secondHalf, blo, bestLoglk);
+  return applied;
 }
 
-struct ScoredPrune {
-  ScoredPrune(unsigned int i, double s) : index(i), score(s) {}
-  unsigned int index;
-  double score;
-};
-
-struct less_than_prune {
-  inline bool operator()(const ScoredPrune &m1, const ScoredPrune &m2) {
-    if (m1.score != m2.score) {
-      return (m1.score < m2.score);
+struct less_than_move_score {
+  inline bool operator()(const std::shared_ptr<SPRMove> &m1,
+                         const std::shared_ptr<SPRMove> &m2) {
+    if (m1->getScore() != m2->getScore()) {
+      return m1->getScore() > m2->getScore();
     }
-    return m1.index < m2.index;
+    return m1->getIdentifier() < m2->getIdentifier();
   }
 };
 
-// #define SIMPLE
 static bool
 applyTheBetterMoves(JointTree &jointTree,
                     const std::vector<std::shared_ptr<SPRMove>> &betterMoves,
                     bool blo, double &bestLoglk) {
-  const unsigned int chunkSize = 10;
-  const unsigned int maxSequential = 100;
   bool foundBetterMove = false;
   double initialLL = bestLoglk;
   Logger::timed << "Found " << betterMoves.size() << " potential better moves"
                 << std::endl;
-  if (betterMoves.size() > maxSequential) {
-    Logger::timed << "GeneRax will try to apply them chunk by chunk..."
-                  << std::endl;
-    unsigned int offset = 0;
-    std::vector<std::shared_ptr<SPRMove>> movesToRetry;
-    std::unordered_set<corax_unode_t *> involved;
-    while (offset <= betterMoves.size()) {
-      auto end = std::min<unsigned int>(offset + chunkSize, betterMoves.size());
-      std::vector<std::shared_ptr<SPRMove>> chunk(betterMoves.begin() + offset,
-                                                  betterMoves.begin() + end);
-      bool improved = simultaneouslyApplyBetterMoves(
-          jointTree, chunk, blo, bestLoglk, involved, movesToRetry);
-      offset += chunkSize;
-      if (improved) {
-        // apply the moves that could not be applied simultaneously
-        improved |= sequentiallyApplyBetterMoves(jointTree, movesToRetry, blo,
-                                                 bestLoglk);
-      } else {
-        // apply all the moves one after each other
-        improved |=
-            sequentiallyApplyBetterMoves(jointTree, chunk, blo, bestLoglk);
-      }
-      movesToRetry.clear();
-      foundBetterMove |= improved;
-      if (!improved) {
-        break;
-      }
-    }
-  } else {
+  auto moves = betterMoves;
+  std::sort(moves.begin(), moves.end(), less_than_move_score());
+  // commit the best compatible moves together, and postpone the moves
+  // that conflict with them to the next batch
+  while (moves.size()) {
+    std::vector<std::shared_ptr<SPRMove>> compatible;
+    std::vector<std::shared_ptr<SPRMove>> conflicting;
+    selectCompatibleMoves(jointTree, moves, compatible, conflicting);
+    Logger::timed << "\tTrying to apply " << compatible.size()
+                  << " compatible moves simultaneously ("
+                  << conflicting.size() << " postponed)" << std::endl;
     foundBetterMove |=
-        sequentiallyApplyBetterMoves(jointTree, betterMoves, blo, bestLoglk);
+        commitCompatibleMoves(jointTree, compatible, blo, bestLoglk);
+    moves = conflicting;
   }
   double epsilon = fabs(bestLoglk) > 10000.0 ? 0.5 : 0.001;
   return foundBetterMove && (bestLoglk - initialLL > epsilon);
@@ -241,20 +259,26 @@ static void synchronizeMoves(JointTree &jointTree,
                              std::vector<std::shared_ptr<SPRMove>> &moves) {
   std::vector<unsigned int> localPrune;
   std::vector<unsigned int> localRegraft;
+  std::vector<double> localScores;
   for (auto move : moves) {
     localPrune.push_back(move->getPruneIndex());
     localRegraft.push_back(move->getRegraftIndex());
+    localScores.push_back(move->getScore());
   }
   std::vector<unsigned int> prune;
   std::vector<unsigned int> regraft;
+  std::vector<double> scores;
   ParallelContext::concatenateHeterogeneousUIntVectors(localPrune, prune);
   ParallelContext::concatenateHeterogeneousUIntVectors(localRegraft, regraft);
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localScores, scores);
   auto temp = moves;
   moves.clear();
   assert(prune.size() == regraft.size());
+  assert(prune.size() == scores.size());
   std::vector<unsigned int> path;
   for (unsigned int i = 0; i < prune.size(); ++i) {
     moves.push_back(std::make_shared<SPRMove>(prune[i], regraft[i], path));
+    moves.back()->setScore(scores[i]);
     moves.back()->updatePath(jointTree);
   }
 }
@@ -265,29 +289,35 @@ bool SPRSearch::applySPRRound(JointTree &jointTree, int radius, bool blo) {
   unsigned int additionalRadius = 0;
   bool improved = false;
   double bestLL = jointTree.computeJointLoglk();
-  std::unordered_map<unsigned int, double> treeHashScores;
-  DiggStopper stopper;
+  // scores of the topologies evaluated in this and the previous rounds
+  auto &scoreCache = jointTree.getScoreCache();
   std::vector<std::shared_ptr<SPRMove>> betterMoves;
-  std::vector<ScoredPrune> scoredPrunes;
   Logger::timed << "SPR Search with radius " << radius << ": trying "
                 << pruneIndices.size() << " prune nodes" << std::endl;
-  auto begin = ParallelContext::getBegin(pruneIndices.size());
-  auto end = ParallelContext::getEnd(pruneIndices.size());
-  for (unsigned int i = begin; i < end; ++i) {
+  // the cost of a prune node varies a lot with its neighbourhood:
+  // the ranks take the prune nodes round-robin, most expensive first,
+  // so that each rank gets a similar share of expensive and cheap ones.
+  // The assignment does not depend on the timings, and neither do the
+  // moves evaluated by each rank
+  sortPruneIndicesByCost(jointTree, radius + 1, pruneIndices);
+  // the stopper learns from all the prune nodes of this rank
+  DiggStopper stopper;
+  auto rank = ParallelContext::getRank();
+  auto size = ParallelContext::getSize();
+  for (auto i = rank; i < pruneIndices.size(); i += size) {
     auto pruneIndex = pruneIndices[i];
     std::vector<unsigned int> path;
     SPRMove move(0, 0, path);
     double bestLLAmongPrune;
     double tempLL = bestLL;
     bool isBetter = SearchUtils::diggBestMoveFromPrune(
-        jointTree, treeHashScores, stopper, pruneIndex, radius + 1,
+        jointTree, scoreCache, stopper, pruneIndex, radius + 1,
         additionalRadius, tempLL, bestLLAmongPrune, blo, move);
-    // scoredPrunes.push_back(ScoredPrune(pruneIndex, bestLLAmongPrune -
-    // bestLL));
     if (isBetter) {
       betterMoves.push_back(std::make_shared<SPRMove>(move));
     }
   }
+  scoreCache.synchronize();
   synchronizeMoves(jointTree, betterMoves);
   improved |= applyTheBetterMoves(jointTree, betterMoves, blo, bestLL);
   return improved;
@@ -16,33 +16,32 @@ static bool isValidSPRMove(corax_unode_s *prune, corax_unode_s *regraft) {
   return !sprYeldsSameTree(prune, regraft);
 }
 
-void SearchUtils::testMove(
-    JointTree &jointTree, SPRMove &move, double &newLoglk, bool blo,
-    std::unordered_map<unsigned int, double> *treeHashScores) {
-  static int computed = 0;
-  static int saved = 0;
-  jointTree.applyMove(move);
-  if (treeHashScores) {
-    auto hash = jointTree.getUnrootedTreeHash();
-    auto it = treeHashScores->find(hash);
-    if (it != treeHashScores->end()) {
+void SearchUtils::testMove(JointTree &jointTree, SPRMove &move,
+                           double &newLoglk, bool blo,
+                           TreeScoreCache *scoreCache) {
+  static thread_local int computed = 0;
+  static thread_local int saved = 0;
+  size_t hash = 0;
+  if (scoreCache) {
+    // look the topology up before applying the move
+    hash = jointTree.getTopologyHashAfterMove(move);
+    if (scoreCache->find(hash, newLoglk)) {
       saved++;
-      newLoglk = it->second;
-      jointTree.rollbackLastMove();
       move.setScore(newLoglk);
       return;
     } else {
       computed++;
     }
   }
+  jointTree.applyMove(move);
   double recLoglk = jointTree.computeReconciliationLoglk();
   if (blo) {
     jointTree.optimizeMove(move);
   }
   newLoglk = recLoglk + jointTree.computeLibpllLoglk(false);
   move.setScore(newLoglk);
-  if (treeHashScores) {
-    treeHashScores->insert({jointTree.getUnrootedTreeHash(), newLoglk});
+  if (scoreCache) {
+    scoreCache->insert(hash, newLoglk);
   }
   jointTree.rollbackLastMove();
 }
@@ -60,14 +59,13 @@ struct less_than_move_ptr {
   }
 };
 
-static void
-diggRecursive(JointTree &jointTree,
-              std::unordered_map<unsigned int, double> &treeHashScores,
-              DiggStopper &stopper, corax_unode_t *pruneNode,
-              corax_unode_t *regraftNode, std::vector<unsigned int> &path,
-              unsigned int radius, unsigned int maxRadius,
-              unsigned int additionalRadius, bool blo, double &bestLL,
-              double &bestLLAmongPrune, SPRMove &bestMove) {
+static void diggRecursive(JointTree &jointTree, TreeScoreCache &scoreCache,
+                          DiggStopper &stopper, corax_unode_t *pruneNode,
+                          corax_unode_t *regraftNode,
+                          std::vector<unsigned int> &path, unsigned int radius,
+                          unsigned int maxRadius, unsigned int additionalRadius,
+                          bool blo, double &bestLL, double &bestLLAmongPrune,
+                          SPRMove &bestMove) {
   // should we stop?
   if (radius >= maxRadius) {
     return;
@@ -77,7 +75,7 @@ diggRecursive(JointTree &jointTree,
   double diff = 1.0;
   if (isValidSPRMove(pruneNode, regraftNode)) {
     double newLL = 0.0;
-    SearchUtils::testMove(jointTree, move, newLL, blo, &treeHashScores);
+    SearchUtils::testMove(jointTree, move, newLL, blo, &scoreCache);
     diff = newLL - bestLL;
     if (newLL > bestLLAmongPrune) {
       bestMove = move;
@@ -98,10 +96,10 @@ diggRecursive(JointTree &jointTree,
     auto left = regraftNode->next->back;
     auto right = regraftNode->next->next->back;
     path.push_back(regraftNode->node_index);
-    diggRecursive(jointTree, treeHashScores, stopper, pruneNode, left, path,
+    diggRecursive(jointTree, scoreCache, stopper, pruneNode, left, path,
                   radius, maxRadius, additionalRadius, blo, bestLL,
                   bestLLAmongPrune, bestMove);
-    diggRecursive(jointTree, treeHashScores, stopper, pruneNode, right, path,
+    diggRecursive(jointTree, scoreCache, stopper, pruneNode, right, path,
                   radius, maxRadius, additionalRadius, blo, bestLL,
                   bestLLAmongPrune, bestMove);
     path.pop_back();
@@ -109,9 +107,8 @@ diggRecursive(JointTree &jointTree,
 }
 
 bool SearchUtils::diggBestMoveFromPrune(
-    JointTree &jointTree,
-    std::unordered_map<unsigned int, double> &treeHashScores,
-    DiggStopper &stopper, unsigned int pruneIndex, unsigned int maxRadius,
+    JointTree &jointTree, TreeScoreCache &scoreCache, DiggStopper &stopper,
+    unsigned int pruneIndex, unsigned int maxRadius,
     unsigned int additionalRadius, double &bestLL, double &bestLLAmongPrune,
     bool blo, SPRMove &bestMove) {
   auto pruneNode = jointTree.getNode(pruneIndex);
@@ -121,10 +118,10 @@ bool SearchUtils::diggBestMoveFromPrune(
   std::vector<unsigned int> path;
   bestLLAmongPrune = -99999999999.0;
   double initialLL = bestLL;
-  diggRecursive(jointTree, treeHashScores, stopper, pruneNode, regraft1, path,
+  diggRecursive(jointTree, scoreCache, stopper, pruneNode, regraft1, path,
                 0, maxRadius, additionalRadius, blo, bestLL, bestLLAmongPrune,
                 bestMove);
-  diggRecursive(jointTree, treeHashScores, stopper, pruneNode, regraft2, path,
+  diggRecursive(jointTree, scoreCache, stopper, pruneNode, regraft2, path,
                 0, maxRadius, additionalRadius, blo, bestLL, bestLLAmongPrune,
                 bestMove);
   return (bestLLAmongPrune - initialLL) > 0.1;
@@ -3,6 +3,7 @@
 #include <maths/AverageStream.hpp>
 #include <memory>
 #include <search/Moves.hpp>
+#include <search/TreeScoreCache.hpp>
 
 #include <unordered_map>
 
@@ -57,19 +58,20 @@ public:
    *  @param move The move to test
    *  @param newLoglk The likelihood of the new tree
    *  @param blo Do we apply branch length optimization?
+   *  @param scoreCache If set, the likelihood is read from the
+   *    cache when possible, and stored into it otherwise
    *
    *  Parallelization: this function is local to one rank
    */
-  static void
-  testMove(JointTree &jointTree, SPRMove &move, double &newLoglk, bool blo,
-           std::unordered_map<unsigned int, double> *treeHashScore = nullptr);
+  static void testMove(JointTree &jointTree, SPRMove &move, double &newLoglk,
+                       bool blo, TreeScoreCache *scoreCache = nullptr);
 
   /**
    *
    *  Find the best SPR move for a given prune index under a given radius
    *
    *  @param jointTree The current tree
-   *  @param treeHashScore A buffer storing likelihoods to avoid
+   *  @param scoreCache A cache storing likelihoods to avoid
    *     computing the likelihood of the same tree twice
    *     This object should be cleared when the DTL rates are
    *     optimized
@@ -90,9 +92,8 @@ public:
    *  Parallelization: this function is local to one rank
    */
   static bool diggBestMoveFromPrune(
-      JointTree &jointTree,
-      std::unordered_map<unsigned int, double> &treeHashScores,
-      DiggStopper &stopper, unsigned int pruneIndex, unsigned int maxRadius,
+      JointTree &jointTree, TreeScoreCache &scoreCache, DiggStopper &stopper,
+      unsigned int pruneIndex, unsigned int maxRadius,
       unsigned int additionalRadius, double &bestLL, double &bestLLAmongPrune,
       bool blo, SPRMove &bestMove);
 };
@@ -23,9 +23,7 @@ bool SpeciesSPRSearch::SPRRound(
   for (unsigned int i = 0; i < speciesTree.getTree().getNodeNumber(); ++i) {
     affectedBranches.push_back(i);
   }
-  for (auto &bs : searchState.sprBoots) {
-    bs.test(perFamLL, affectedBranches, true);
-  }
+  searchState.testSPRBoots(perFamLL, affectedBranches, true);
   for (auto prune : prunes) {
     std::vector<unsigned int> regrafts;
     SpeciesTreeOperator::getPossibleRegrafts(speciesTree, prune, radius,
@@ -1,41 +1,88 @@
 #include "SpeciesSearchCommon.hpp"
 
+#include <algorithm>
+#include <limits>
+
 #include <trees/PLLRootedTree.hpp>
 #include <trees/SpeciesTree.hpp>
 
-static std::string getSubtreeNewick(const corax_rnode_t *subtree) {
+static void fillClade(const corax_rnode_t *subtree,
+                      const StringToUint &leafLabelToIndex,
+                      genesis::utils::Bitvector &clade) {
   if (!subtree->left) {
-    return std::string(subtree->label);
+    clade.set(leafLabelToIndex.at(subtree->label));
+    return;
   }
-  std::string res("(");
-  std::string id1 = getSubtreeNewick(subtree->left);
-  std::string id2 = getSubtreeNewick(subtree->right);
-  if (id1 > id2) {
-    std::swap(id1, id2);
+  fillClade(subtree->left, leafLabelToIndex, clade);
+  fillClade(subtree->right, leafLabelToIndex, clade);
+}
+
+static void fillLeafLabels(const corax_rnode_t *subtree,
+                           std::vector<std::string> &labels) {
+  if (!subtree->left) {
+    labels.push_back(std::string(subtree->label));
+    return;
   }
-  return std::string("(") + id1 + "," + id2 + ")";
+  fillLeafLabels(subtree->left, labels);
+  fillLeafLabels(subtree->right, labels);
 }
 
-bool RootLikelihoods::hasSubtreeId(const corax_rnode_t *subtree) const {
-  auto newickID = getSubtreeNewick(subtree);
-  return newickToId.find(newickID) != newickToId.end();
+void RootLikelihoods::updateLeafIndices(const corax_rnode_t *root) {
+  if (_leafLabelToIndex.size()) {
+    return;
+  }
+  // sort the labels such that the clades do not depend on the
+  // tree from which the indices were computed
+  std::vector<std::string> labels;
+  fillLeafLabels(root, labels);
+  std::sort(labels.begin(), labels.end());
+  for (unsigned int i = 0; i < labels.size(); ++i) {
+    _leafLabelToIndex[labels[i]] = i;
+  }
 }
 
-unsigned int RootLikelihoods::getSubtreeId(const corax_rnode_t *subtree) const {
-  auto newickID = getSubtreeNewick(subtree);
-  auto it = newickToId.find(newickID);
-  return it->second;
+RootLikelihoods::Clade
+RootLikelihoods::getClade(const corax_rnode_t *subtree) {
+  Clade clade(_leafLabelToIndex.size());
+  fillClade(subtree, _leafLabelToIndex, clade);
+  return clade;
+}
+
+std::vector<RootLikelihoods::Clade>
+RootLikelihoods::getClades(PLLRootedTree &tree) {
+  updateLeafIndices(tree.getRoot());
+  std::vector<Clade> clades(tree.getNodeNumber());
+  for (auto node : tree.getPostOrderNodes()) {
+    auto &clade = clades[node->node_index];
+    if (!node->left) {
+      clade = Clade(_leafLabelToIndex.size());
+      clade.set(_leafLabelToIndex.at(node->label));
+    } else {
+      clade = clades[node->left->node_index];
+      clade |= clades[node->right->node_index];
+    }
+  }
+  return clades;
+}
+
+bool RootLikelihoods::hasSubtreeId(const Clade &clade) const {
+  return _cladeToId.find(clade) != _cladeToId.end();
+}
+
+unsigned int RootLikelihoods::getSubtreeId(const Clade &clade) const {
+  return _cladeToId.find(clade)->second;
 }
 
 unsigned int RootLikelihoods::getRootId(const corax_rnode_t *root) {
-  auto newickID1 = getSubtreeNewick(root->left);
-  auto newickID2 = getSubtreeNewick(root->right);
-  auto it1 = newickToId.find(newickID1);
-  auto it2 = newickToId.find(newickID2);
-  if (it1 == newickToId.end() && it2 == newickToId.end()) {
-    unsigned int id = newickToId.size() / 2;
-    newickToId.insert({newickID1, id});
-    newickToId.insert({newickID2, id});
+  updateLeafIndices(root);
+  auto clade1 = getClade(root->left);
+  auto clade2 = getClade(root->right);
+  auto it1 = _cladeToId.find(clade1);
+  auto it2 = _cladeToId.find(clade2);
+  if (it1 == _cladeToId.end() && it2 == _cladeToId.end()) {
+    unsigned int id = _cladeToId.size() / 2;
+    _cladeToId.insert({clade1, id});
+    _cladeToId.insert({clade2, id});
     return id;
   }
   assert(it1->second == it2->second);
@@ -58,12 +105,14 @@ void RootLikelihoods::savePerFamilyLikelihoods(corax_rnode_t *root,
 void RootLikelihoods::fillTree(PLLRootedTree &tree) {
   std::vector<double> nodeIdToLL(tree.getNodeNumber(), 0.0);
   double bestLL = -std::numeric_limits<double>::infinity();
+  auto clades = getClades(tree);
   for (auto node : tree.getNodes()) {
-    if (!hasSubtreeId(node)) {
+    auto &clade = clades[node->node_index];
+    if (!hasSubtreeId(clade)) {
       continue;
     }
     // we have a likelihood value
-    auto id = getSubtreeId(node);
+    auto id = getSubtreeId(clade);
     auto value = _idToLL[id];
     nodeIdToLL[node->node_index] = value;
     bestLL = std::max<double>(value, bestLL);
@@ -91,14 +140,16 @@ void RootLikelihoods::fillTreeBootstraps(PLLRootedTree &tree) {
   for (const auto &bs : _bootstraps) {
     idToSupport[bs.getBestID()]++;
   }
+  auto clades = getClades(tree);
   auto postOrderNodes = tree.getPostOrderNodes();
   for (auto it = postOrderNodes.rbegin(); it != postOrderNodes.rend(); ++it) {
 
     auto node = *it;
-    if (!hasSubtreeId(node)) {
+    auto &clade = clades[node->node_index];
+    if (!hasSubtreeId(clade)) {
       continue;
     }
-    auto id = getSubtreeId(node);
+    auto id = getSubtreeId(clade);
     if (idToSupport.find(id) == idToSupport.end()) {
       continue;
     }
@@ -128,12 +179,69 @@ void SpeciesSearchState::betterTreeCallback(double ll, PerFamLL &perFamLL) {
   }
 }
 
+void SpeciesSearchState::startSPRBootsTest(
+    const PerFamLL &perFamLL, ParallelContext::AsyncReduction &reduction) {
+  std::vector<double> lls;
+  for (const auto &bs : sprBoots) {
+    lls.push_back(bs.evaluateLocal(perFamLL));
+  }
+  ParallelContext::startSumVectorDouble(lls, reduction);
+}
+
+void SpeciesSearchState::endSPRBootsTest(
+    ParallelContext::AsyncReduction &reduction,
+    const std::vector<unsigned int> &affectedBranches, bool isReferenceTree) {
+  std::vector<double> lls;
+  ParallelContext::waitReduction(reduction, lls);
+  assert(lls.size() == sprBoots.size());
+  for (unsigned int i = 0; i < sprBoots.size(); ++i) {
+    sprBoots[i].update(lls[i], affectedBranches, isReferenceTree);
+  }
+}
+
+void SpeciesSearchState::testSPRBoots(
+    const PerFamLL &perFamLL, const std::vector<unsigned int> &affectedBranches,
+    bool isReferenceTree) {
+  ParallelContext::AsyncReduction reduction;
+  startSPRBootsTest(perFamLL, reduction);
+  endSPRBootsTest(reduction, affectedBranches, isReferenceTree);
+}
+
+void SpeciesSearchState::setLocalFamilies(
+    const std::vector<unsigned int> &globalIndices) {
+  for (auto &bs : sprBoots) {
+    bs.setLocalElements(globalIndices);
+  }
+  khBoots.setLocalElements(globalIndices);
+}
+
 void SpeciesSearchState::betterLikelihoodCallback(double ll,
                                                   PerFamLL &perFamLL) {
   bestLL = ll;
   khBoots.newML(perFamLL);
 }
 
+void SpeciesTreeLikelihoodEvaluatorInterface::computeRankSwapLikelihoods(
+    SpeciesTree &speciesTree, double currentLL,
+    const std::vector<unsigned int> &ranks, std::vector<double> &lls,
+    std::vector<PerFamLL> *perFamLLs) {
+  (void)(currentLL);
+  auto &datedTree = speciesTree.getDatedTree();
+  lls.assign(ranks.size(), -std::numeric_limits<double>::infinity());
+  if (perFamLLs) {
+    perFamLLs->assign(ranks.size(), PerFamLL());
+  }
+  for (unsigned int i = 0; i < ranks.size(); ++i) {
+    if (!datedTree.moveUp(ranks[i])) {
+      continue;
+    }
+    speciesTree.onSpeciesDatesChange();
+    lls[i] = computeLikelihood(perFamLLs ? &(*perFamLLs)[i] : nullptr);
+    datedTree.moveUp(ranks[i]); // reversal
+    speciesTree.onSpeciesDatesChange();
+  }
+}
+
 bool SpeciesSearchCommon::testSPR(
     SpeciesTree &speciesTree,
     SpeciesTreeLikelihoodEvaluatorInterface &evaluation,
@@ -161,18 +269,21 @@ bool SpeciesSearchCommon::testSPR(
     // we test the move with exact likelihood
     PerFamLL perFamLL;
     auto testedTreeLL = evaluation.computeLikelihood(&perFamLL);
-    for (auto &bs : searchState.sprBoots) {
-      bs.test(perFamLL, affectedBranches, false);
-    }
+    // the SPR bootstraps reduction overlaps with the KH test
+    ParallelContext::AsyncReduction bootsReduction;
+    searchState.startSPRBootsTest(perFamLL, bootsReduction);
     if (evaluation.providesFastLikelihoodImpl()) {
       searchState.averageApproxError.addValue(testedTreeLL - approxLL);
     }
-    if (testedTreeLL > searchState.bestLL + 0.00000001) {
+    bool better = testedTreeLL > searchState.bestLL + 0.00000001;
+    if (!better) {
+      searchState.khBoots.test(perFamLL, affectedBranches);
+    }
+    searchState.endSPRBootsTest(bootsReduction, affectedBranches, false);
+    if (better) {
       searchState.betterTreeCallback(testedTreeLL, perFamLL);
       // Better tree found! Do not rollback, and return
       return true;
-    } else {
-      searchState.khBoots.test(perFamLL, affectedBranches);
     }
   }
   // the tree is not better, rollback the move
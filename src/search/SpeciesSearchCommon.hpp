@@ -4,6 +4,8 @@
 
 #include <likelihoods/ReconciliationEvaluation.hpp>
 #include <maths/AverageStream.hpp>
+#include <maths/bitvector.hpp>
+#include <parallelization/ParallelContext.hpp>
 #include <search/UFBoot.hpp>
 #include <trees/SpeciesTree.hpp>
 #include <util/Scenario.hpp>
@@ -31,7 +33,7 @@ public:
    */
   void reset() {
     _idToLL.clear();
-    newickToId.clear();
+    _cladeToId.clear();
     for (auto &bs : _bootstraps) {
       bs.reset();
     }
@@ -63,11 +65,25 @@ public:
   bool isEmpty() const { return !_idToLL.size(); }
 
 private:
-  bool hasSubtreeId(const corax_rnode_t *subtree) const;
-  unsigned int getSubtreeId(const corax_rnode_t *subtree) const;
+  using Clade = genesis::utils::Bitvector;
+  /**
+   *  Return the set of leaves under subtree, encoded with
+   *  the leaf indices from _leafLabelToIndex
+   */
+  Clade getClade(const corax_rnode_t *subtree);
+  /**
+   *  Return the clades of all the nodes of the tree,
+   *  indexed with the node indices
+   */
+  std::vector<Clade> getClades(PLLRootedTree &tree);
+  void updateLeafIndices(const corax_rnode_t *root);
+  bool hasSubtreeId(const Clade &clade) const;
+  unsigned int getSubtreeId(const Clade &clade) const;
   unsigned int getRootId(const corax_rnode_t *root);
 
-  std::unordered_map<std::string, unsigned int> newickToId;
+  // the two clades under a root get the same id
+  std::unordered_map<Clade, unsigned int> _cladeToId;
+  StringToUint _leafLabelToIndex;
   std::unordered_map<unsigned int, double> _idToLL;
   std::vector<RootBoot> _bootstraps;
 };
@@ -107,6 +123,32 @@ public:
    */
   virtual bool isDated() const = 0;
 
+  /**
+   *  Compute the likelihoods of the trees obtained by applying
+   *  DatedTree::moveUp(rank) to the current dating, for each rank
+   *  in ranks. Each swap is evaluated independently from the current
+   *  dating, which is left unchanged. Impossible swaps get a
+   *  -infinity likelihood.
+   *
+   *  currentLL is the likelihood of the current dating, and can be
+   *  used by implementations that evaluate the swaps incrementally.
+   *  If perFamLLs is set, fill it with the per-family log-likelihoods
+   *  of each swap from the current parallel core
+   *  The default implementation applies each swap, calls
+   *  computeLikelihood and reverts the swap
+   */
+  virtual void
+  computeRankSwapLikelihoods(SpeciesTree &speciesTree, double currentLL,
+                             const std::vector<unsigned int> &ranks,
+                             std::vector<double> &lls,
+                             std::vector<PerFamLL> *perFamLLs = nullptr);
+
+  /**
+   *  Return true if computeRankSwapLikelihoods evaluates several
+   *  swaps at a lower cost than one computeLikelihood call per swap
+   */
+  virtual bool providesRankSwapImpl() const { return false; }
+
   /**
    *  Optimize model rates, such as DTL rates
    */
@@ -221,6 +263,30 @@ public:
   std::vector<PerBranchBoot> sprBoots;
   PerBranchKH khBoots;
 
+  /**
+   *  Test a tree against all the SPR bootstraps (see
+   *  PerBranchBoot::test), with one single reduction for all of them.
+   *  The reduction is non-blocking: it is started by
+   *  startSPRBootsTest, and the bootstraps are updated by
+   *  endSPRBootsTest, so that the caller can work in between.
+   *  testSPRBoots does both at once.
+   */
+  void startSPRBootsTest(const PerFamLL &perFamLL,
+                         ParallelContext::AsyncReduction &reduction);
+  void endSPRBootsTest(ParallelContext::AsyncReduction &reduction,
+                       const std::vector<unsigned int> &affectedBranches,
+                       bool isReferenceTree);
+  void testSPRBoots(const PerFamLL &perFamLL,
+                    const std::vector<unsigned int> &affectedBranches,
+                    bool isReferenceTree);
+
+  /**
+   *  To call when the families were redistributed between the
+   *  parallel cores, with the global indices of the new local
+   *  families (see Bootstrap::setLocalElements)
+   */
+  void setLocalFamilies(const std::vector<unsigned int> &globalIndices);
+
   /**
    *  To call when a better tree is found
    */
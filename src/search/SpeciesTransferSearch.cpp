@@ -101,9 +101,7 @@ static bool transferRound(SpeciesTree &speciesTree,
   for (unsigned int i = 0; i < speciesTree.getTree().getNodeNumber(); ++i) {
     affectedBranches.push_back(i);
   }
-  for (auto &bs : searchState.sprBoots) {
-    bs.test(perFamLL, affectedBranches, true);
-  }
+  searchState.testSPRBoots(perFamLL, affectedBranches, true);
   SpeciesTransferSearch::getSortedTransferList(
       speciesTree, evaluation, minTransfers, blacklist, transferMoves);
   auto copyTransferMoves = transferMoves;
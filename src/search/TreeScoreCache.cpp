@@ -0,0 +1,67 @@
+#include "TreeScoreCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <parallelization/ParallelContext.hpp>
+#include <vector>
+
+void TreeScoreCache::insert(size_t hash, double score) {
+  _newScores.insert({hash, score});
+}
+
+void TreeScoreCache::add(size_t hash, double score) {
+  if (!_scores.insert({hash, score}).second) {
+    return;
+  }
+  _insertionOrder.push_back(hash);
+  while (_scores.size() > _maxSize) {
+    _scores.erase(_insertionOrder.front());
+    _insertionOrder.pop_front();
+  }
+}
+
+void TreeScoreCache::clear() {
+  _scores.clear();
+  _insertionOrder.clear();
+  _newScores.clear();
+}
+
+void TreeScoreCache::synchronize() {
+  // the hashes are exchanged as pairs of 32 bits values (the shifts
+  // are split because size_t might only have 32 bits)
+  std::vector<unsigned int> localHashes;
+  std::vector<double> localScores;
+  for (const auto &entry : _newScores) {
+    localHashes.push_back(static_cast<unsigned int>(entry.first & 0xffffffff));
+    localHashes.push_back(
+        static_cast<unsigned int>((entry.first >> 16) >> 16));
+    localScores.push_back(entry.second);
+  }
+  std::vector<unsigned int> hashes;
+  std::vector<double> scores;
+  ParallelContext::concatenateHeterogeneousUIntVectors(localHashes, hashes);
+  ParallelContext::concatenateHeterogeneousDoubleVectors(localScores, scores);
+  assert(hashes.size() == 2 * scores.size());
+  _newScores.clear();
+  // the concatenation order depends on the topologies each rank
+  // evaluated: sort the entries such that all the ranks insert
+  // (and thus later drop) them in the same order
+  std::vector<std::pair<size_t, double>> entries;
+  for (unsigned int i = 0; i < scores.size(); ++i) {
+    size_t hash = hashes[2 * i + 1];
+    hash = ((hash << 16) << 16) | hashes[2 * i];
+    entries.push_back({hash, scores[i]});
+  }
+  // by increasing hash, and by decreasing score for a same hash
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<size_t, double> &e1,
+               const std::pair<size_t, double> &e2) {
+              if (e1.first != e2.first) {
+                return e1.first < e2.first;
+              }
+              return e1.second > e2.second;
+            });
+  for (const auto &entry : entries) {
+    add(entry.first, entry.second);
+  }
+}
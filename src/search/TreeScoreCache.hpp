@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+
+/**
+ *  Bounded cache of the joint likelihoods of already evaluated gene
+ *  tree topologies, keyed by a topology hash (see
+ *  JointTree::getTopologyHashAfterMove). It persists across the SPR
+ *  rounds of a family: the oldest entries are dropped when the cache
+ *  is full, and it must be cleared when the model parameters change.
+ *
+ *  It is not cleared when the moves applied at the end of a round
+ *  re-optimize some branch lengths: a score cached in a previous round
+ *  was computed with the former branch lengths. The cached scores are
+ *  only used to select the candidate moves, whose likelihood is
+ *  computed again before they are applied.
+ *
+ *  The scores inserted by a rank are visible to this rank right away,
+ *  and to the other ranks after the next call to synchronize, which
+ *  adds the scores of all ranks in the same order on each rank: all
+ *  the ranks then have the same cache, whatever topologies each of
+ *  them evaluated.
+ */
+class TreeScoreCache {
+public:
+  TreeScoreCache(size_t maxSize = 200000) : _maxSize(maxSize) {}
+
+  /**
+   *  Set score to the cached value and return true if the
+   *  topology hash is in the cache
+   */
+  bool find(size_t hash, double &score) const {
+    auto it = _scores.find(hash);
+    if (it == _scores.end()) {
+      it = _newScores.find(hash);
+      if (it == _newScores.end()) {
+        return false;
+      }
+    }
+    score = it->second;
+    return true;
+  }
+
+  /**
+   *  Add the score of a topology. The other ranks only see it
+   *  after the next synchronization
+   */
+  void insert(size_t hash, double score);
+
+  void clear();
+
+  /**
+   *  Add the entries inserted by all the ranks of the current
+   *  parallel context since the last call, sorted by hash. When
+   *  several ranks scored the same topology, the highest score
+   *  is kept.
+   *  Parallelization: must be called by all ranks
+   */
+  void synchronize();
+
+  size_t size() const { return _scores.size(); }
+
+private:
+  size_t _maxSize;
+  std::unordered_map<size_t, double> _scores;
+  // insertion order, to drop the oldest entries first
+  std::deque<size_t> _insertionOrder;
+  // entries inserted by this rank since the last synchronization,
+  // not in _scores yet
+  std::unordered_map<size_t, double> _newScores;
+
+  void add(size_t hash, double score);
+};
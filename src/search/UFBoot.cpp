@@ -11,32 +11,64 @@ Bootstrap::Bootstrap(unsigned int samples) {
   // samples is the number of samples local to the current core
   // we need to subsample over the total number of samples over
   // all cores
-  auto totalSamples = samples;
-  ParallelContext::sumUInt(totalSamples);
+  _totalSamples = samples;
+  ParallelContext::sumUInt(_totalSamples);
+  _seed = static_cast<unsigned long>(Random::getInt());
   std::vector<unsigned int> perCoreSamples;
   ParallelContext::allGatherUInt(samples, perCoreSamples);
   unsigned int begin = 0;
   for (unsigned int i = 0; i < ParallelContext::getRank(); ++i) {
     begin += perCoreSamples[i];
   }
-  auto end = begin + samples;
-  for (unsigned int i = 0; i < totalSamples; ++i) {
-    unsigned int v = Random::getInt(0, totalSamples - 1);
-    if (v >= begin && v < end) {
-      indices.push_back(v - begin);
-    }
+  std::vector<unsigned int> globalElements;
+  for (unsigned int i = 0; i < samples; ++i) {
+    globalElements.push_back(begin + i);
   }
+  sample(globalElements);
   unsigned int totalSize = indices.size();
   ParallelContext::sumUInt(totalSize);
-  assert(totalSize == totalSamples);
+  assert(totalSize == _totalSamples);
+}
+
+void Bootstrap::setLocalElements(
+    const std::vector<unsigned int> &globalElements) {
+  sample(globalElements);
+}
+
+void Bootstrap::sample(const std::vector<unsigned int> &globalElements) {
+  indices.clear();
+  if (!_totalSamples) {
+    return;
+  }
+  // local index of each global element, or -1 if it is not local
+  std::vector<int> localIndices(_totalSamples, -1);
+  for (unsigned int i = 0; i < globalElements.size(); ++i) {
+    assert(globalElements[i] < _totalSamples);
+    localIndices[globalElements[i]] = static_cast<int>(i);
+  }
+  // all cores draw the same sequence
+  std::mt19937_64 rng(_seed);
+  std::uniform_int_distribution<unsigned int> distr(0, _totalSamples - 1);
+  for (unsigned int i = 0; i < _totalSamples; ++i) {
+    auto v = distr(rng);
+    if (localIndices[v] != -1) {
+      indices.push_back(static_cast<unsigned int>(localIndices[v]));
+    }
+  }
 }
 
 double Bootstrap::evaluate(const std::vector<double> &likelihoods) const {
+  auto ll = evaluateLocal(likelihoods);
+  ParallelContext::sumDouble(ll);
+  return ll;
+}
+
+double
+Bootstrap::evaluateLocal(const std::vector<double> &likelihoods) const {
   auto ll = 0.0;
   for (auto i : indices) {
     ll += likelihoods[i];
   }
-  ParallelContext::sumDouble(ll);
   return ll;
 }
 
@@ -63,7 +95,11 @@ PerBranchBoot::PerBranchBoot(unsigned int elements, unsigned int branches)
 void PerBranchBoot::test(const std::vector<double> &values,
                          const std::vector<unsigned int> &branches,
                          bool isReferenceTree) {
-  double ll = _bootstrap.evaluate(values);
+  update(_bootstrap.evaluate(values), branches, isReferenceTree);
+}
+
+void PerBranchBoot::update(double ll, const std::vector<unsigned int> &branches,
+                           bool isReferenceTree) {
   for (auto branch : branches) {
 
     if (ll > _bestLLs[branch]) {
@@ -91,10 +127,22 @@ PerBranchKH::PerBranchKH(unsigned int elements, unsigned int branches,
   }
 }
 
+void PerBranchKH::computeLikelihoods(const std::vector<double> &values,
+                                     std::vector<double> &lls) const {
+  // reduce the likelihood and all the bootstraped likelihoods at once
+  lls.resize(_bootstraps.size() + 1);
+  lls[0] = std::accumulate(values.begin(), values.end(), 0.0);
+  for (unsigned int i = 0; i < _bootstraps.size(); ++i) {
+    lls[i + 1] = _bootstraps[i].evaluateLocal(values);
+  }
+  ParallelContext::sumVectorDouble(lls);
+}
+
 void PerBranchKH::test(const std::vector<double> &values,
                        const std::vector<unsigned int> &branches) {
-  double ll2 = std::accumulate(values.begin(), values.end(), 0.0);
-  ParallelContext::sumDouble(ll2);
+  std::vector<double> lls;
+  computeLikelihoods(values, lls);
+  double ll2 = lls[0];
   if (_refLL - ll2 < -1e-3) {
     Logger::info << "ERROR _refLL - ll2 < -1e-3" << std::endl;
     Logger::info << _refLL << " " << ll2 << std::endl;
@@ -105,7 +153,7 @@ void PerBranchKH::test(const std::vector<double> &values,
   double averageDelta = 0.0;
   std::vector<double> deltas(_bootstraps.size(), 0.0);
   for (unsigned int i = 0; i < _bootstraps.size(); ++i) {
-    deltas[i] = _perBootstrapRefLL[i] - _bootstraps[i].evaluate(values);
+    deltas[i] = _perBootstrapRefLL[i] - lls[i + 1];
     averageDelta += deltas[i];
   }
   averageDelta /= static_cast<double>(_bootstraps.size());
@@ -121,10 +169,18 @@ void PerBranchKH::test(const std::vector<double> &values,
   }
 }
 void PerBranchKH::newML(const std::vector<double> &values) {
-  _refLL = std::accumulate(values.begin(), values.end(), 0.0);
-  ParallelContext::sumDouble(_refLL);
+  std::vector<double> lls;
+  computeLikelihoods(values, lls);
+  _refLL = lls[0];
   for (unsigned int i = 0; i < _bootstraps.size(); ++i) {
-    _perBootstrapRefLL[i] = _bootstraps[i].evaluate(values);
+    _perBootstrapRefLL[i] = lls[i + 1];
+  }
+}
+
+void PerBranchKH::setLocalElements(
+    const std::vector<unsigned int> &globalElements) {
+  for (auto &bootstrap : _bootstraps) {
+    bootstrap.setLocalElements(globalElements);
   }
 }
 
@@ -22,8 +22,28 @@ public:
    */
   double evaluate(const std::vector<double> &likelihoods) const;
 
+  /**
+   *  Same as evaluate, but without the reduction over the ranks:
+   *  the caller is responsible for summing the result of all ranks
+   */
+  double evaluateLocal(const std::vector<double> &likelihoods) const;
+
+  /**
+   *  Resample the same bootstrap after the elements were redistributed
+   *  between the parallel cores. Collective.
+   *  @param globalElements for each element now local to this core,
+   *    its index in the initial distribution, i.e. in the concatenation
+   *    of the elements of all cores at construction time
+   */
+  void setLocalElements(const std::vector<unsigned int> &globalElements);
+
 private:
+  void sample(const std::vector<unsigned int> &globalElements);
+
   std::vector<unsigned int> indices;
+  unsigned int _totalSamples;
+  // the bootstrap draws are replayed from this seed on resampling
+  unsigned long _seed;
 };
 
 class RootBoot {
@@ -71,6 +91,25 @@ public:
   void test(const std::vector<double> &values,
             const std::vector<unsigned int> &branches, bool isReferenceTree);
 
+  /**
+   *  Split version of test, to reduce the likelihoods of several
+   *  bootstraps at once: evaluateLocal returns the local part of the
+   *  bootstraped likelihood, and update must be called with its sum
+   *  over all ranks
+   */
+  double evaluateLocal(const std::vector<double> &values) const {
+    return _bootstrap.evaluateLocal(values);
+  }
+  void update(double ll, const std::vector<unsigned int> &branches,
+              bool isReferenceTree);
+
+  /**
+   *  See Bootstrap::setLocalElements
+   */
+  void setLocalElements(const std::vector<unsigned int> &globalElements) {
+    _bootstrap.setLocalElements(globalElements);
+  }
+
   /**
    *  Reset the best likelihoods and isOk values
    */
@@ -99,9 +138,21 @@ public:
   void newMLTree(const std::vector<double> &values);
   void newML(const std::vector<double> &values);
 
+  /**
+   *  See Bootstrap::setLocalElements
+   */
+  void setLocalElements(const std::vector<unsigned int> &globalElements);
+
   unsigned int getSupport(unsigned int branch) const { return _oks[branch]; }
 
 private:
+  /**
+   *  Fill lls with the global likelihood (first element) and the
+   *  global likelihood of each bootstrap (next elements)
+   */
+  void computeLikelihoods(const std::vector<double> &values,
+                          std::vector<double> &lls) const;
+
   std::vector<Bootstrap> _bootstraps;
   double _refLL;
   std::vector<double> _perBootstrapRefLL;
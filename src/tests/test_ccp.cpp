@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cassert>
+#include <ccp/ConditionalClades.hpp>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+void writeLines(const std::string &path,
+                const std::vector<std::string> &lines) {
+  std::ofstream os(path);
+  for (const auto &line : lines) {
+    os << line << std::endl;
+  }
+}
+
+bool areClose(double v1, double v2) {
+  return std::fabs(v1 - v2) <= 1e-9 * std::max(1.0, std::fabs(v1));
+}
+
+using SplitMap = std::map<std::pair<CID, CID>, const CladeSplit *>;
+
+SplitMap getSplits(const ConditionalClades &ccp, CID cid) {
+  SplitMap splits;
+  for (const auto &split : ccp.getCladeSplits(cid)) {
+    splits[{split.left, split.right}] = &split;
+  }
+  return splits;
+}
+
+/**
+ *  Check that ccp1 and ccp2 have the same clades (with the same
+ *  CIDs), the same split frequencies and the same branch lengths
+ */
+void checkEqual(const ConditionalClades &ccp1, const ConditionalClades &ccp2) {
+  assert(ccp1.isValid() && ccp2.isValid());
+  assert(ccp1.getLeafNumber() == ccp2.getLeafNumber());
+  assert(ccp1.getCladesNumber() == ccp2.getCladesNumber());
+  assert(ccp1.getRootsNumber() == ccp2.getRootsNumber());
+  assert(ccp1.getInputTreesNumber() == ccp2.getInputTreesNumber());
+  assert(ccp1.getUniqueInputTreesNumber() ==
+         ccp2.getUniqueInputTreesNumber());
+  for (CID cid = 0; cid < ccp1.getCladesNumber(); ++cid) {
+    assert(ccp1.isLeaf(cid) == ccp2.isLeaf(cid));
+    if (ccp1.isLeaf(cid)) {
+      assert(ccp1.getLeafLabel(cid) == ccp2.getLeafLabel(cid));
+    }
+    auto splits1 = getSplits(ccp1, cid);
+    auto splits2 = getSplits(ccp2, cid);
+    assert(splits1.size() == splits2.size());
+    for (const auto &pair : splits1) {
+      auto it = splits2.find(pair.first);
+      assert(it != splits2.end());
+      assert(areClose(pair.second->frequency, it->second->frequency));
+      assert(areClose(pair.second->blLeft, it->second->blLeft));
+      assert(areClose(pair.second->blRight, it->second->blRight));
+    }
+  }
+}
+
+/**
+ *  Build the CCPs of a sample with the streaming implementation
+ *  and with the corax trees, and check that they are equal
+ */
+void checkSample(const std::string &trees, const std::string &likelihoods,
+                 CCPRooting rooting, unsigned int sampleFrequency) {
+  ConditionalClades streamed;
+  streamed.buildFromGeneTrees(trees, likelihoods, rooting, sampleFrequency);
+  ConditionalClades reference;
+  reference.buildFromPLLTrees(trees, likelihoods, rooting, sampleFrequency);
+  checkEqual(streamed, reference);
+}
+
+int main() {
+  // duplicated topologies (rooted and unrooted) with different
+  // branch lengths and leaf orders
+  std::vector<std::string> trees = {
+      "((a:0.1,b:0.2):0.3,((c:0.1,d:0.2):0.1,(e:0.3,f:0.1):0.2):0.4);",
+      "((b:0.2,a:0.2):0.1,((d:0.1,c:0.3):0.2,(f:0.1,e:0.2):0.1):0.2);",
+      "(((a:0.1,b:0.2):0.3,(c:0.1,d:0.2):0.1):0.2,(e:0.3,f:0.1):0.2);",
+      "((a:0.1,c:0.2):0.3,((b:0.1,d:0.2):0.1,(e:0.3,f:0.1):0.2):0.4);",
+      "(a:0.5,(b:0.1,(c:0.2,(d:0.1,(e:0.2,f:0.3):0.1):0.1):0.2):0.3);",
+      "(((e:0.1,f:0.2):0.1,(c:0.2,d:0.1):0.2):0.1,(a:0.2,b:0.1):0.3);"};
+  std::vector<std::string> likelihoods = {"-10.5", "-9.0",  "-12.25",
+                                          "-11.0", "-13.5", "-8.75"};
+  std::string treesFile("test_ccp_trees.newick");
+  std::string llFile("test_ccp_likelihoods.txt");
+  writeLines(treesFile, trees);
+  writeLines(llFile, likelihoods);
+  for (auto rooting : {CCPRooting::UNIFORM, CCPRooting::ROOTED}) {
+    checkSample(treesFile, "", rooting, 1);
+    checkSample(treesFile, "", rooting, 2);
+    checkSample(treesFile, llFile, rooting, 1);
+  }
+  // unrooted newick strings
+  std::vector<std::string> unrootedTrees = {
+      "(a:0.1,b:0.2,((c:0.1,d:0.2):0.1,(e:0.3,f:0.1):0.2):0.4);",
+      "((d:0.1,c:0.3):0.2,(f:0.1,e:0.2):0.1,(b:0.2,a:0.2):0.1);",
+      "(a:0.1,(b:0.1,d:0.2):0.3,(c:0.1,(e:0.3,f:0.1):0.2):0.4);"};
+  std::string unrootedFile("test_ccp_unrooted.newick");
+  writeLines(unrootedFile, unrootedTrees);
+  checkSample(unrootedFile, "", CCPRooting::UNIFORM, 1);
+  // whitespaces and internal labels do not change the CCPs
+  std::vector<std::string> labelledTrees = {
+      "(a:0.1,b:0.2,((c:0.1,d:0.2) n1:0.1,(e:0.3,f:0.1)\tn2 :0.2) :0.4);",
+      "((d:0.1,c:0.3)n3:0.2, (f:0.1,e:0.2) 'n 4':0.1,(b:0.2,a:0.2):0.1) ;",
+      "(a:0.1,(b:0.1,d:0.2) n5:0.3,(c:0.1,(e:0.3,f:0.1) x:0.2):0.4) root;"};
+  std::string labelledFile("test_ccp_labelled.newick");
+  writeLines(labelledFile, labelledTrees);
+  ConditionalClades reference;
+  reference.buildFromGeneTrees(unrootedFile, "", CCPRooting::UNIFORM, 1);
+  ConditionalClades labelled;
+  labelled.buildFromGeneTrees(labelledFile, "", CCPRooting::UNIFORM, 1);
+  checkEqual(reference, labelled);
+  return 0;
+}
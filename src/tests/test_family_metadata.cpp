@@ -0,0 +1,73 @@
+#include <IO/FamilyMetadataIndex.hpp>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+void writeFile(const std::string &path, const std::string &content) {
+  std::ofstream os(path);
+  os << content << std::endl;
+}
+
+/**
+ *  Return the leaf numbers read with the given index, as a new
+ *  run would: the cached metadata are per thread, so each call
+ *  runs in a thread that did not cache anything yet
+ */
+std::vector<unsigned int> runLeafNumbers(const Families &families,
+                                         const std::string &indexPath) {
+  std::vector<unsigned int> leaves;
+  std::thread run([&]() {
+    FamilyMetadataIndex::setIndexPath(indexPath);
+    leaves = FamilyMetadataIndex::getLeafNumbers(families);
+  });
+  run.join();
+  return leaves;
+}
+
+int main() {
+  std::string indexPath("test_family_metadata_index.txt");
+  std::remove(indexPath.c_str());
+  Families families(2);
+  families[0].name = "f0";
+  families[0].startingGeneTree = "test_family_metadata_f0.newick";
+  families[1].name = "f1";
+  families[1].startingGeneTree = "test_family_metadata_f1.newick";
+  writeFile(families[0].startingGeneTree, "((a,b),(c,d),e);");
+  writeFile(families[1].startingGeneTree, "((a,b),c);");
+  auto leaves = runLeafNumbers(families, indexPath);
+  assert(leaves.size() == 2);
+  assert(leaves[0] == 5);
+  assert(leaves[1] == 3);
+  // tamper with the persisted leaf numbers: a second run must read
+  // them instead of parsing the unchanged gene trees again
+  std::string name;
+  unsigned long geneTreeFingerprint;
+  unsigned int treeLeaves;
+  unsigned long ccpFingerprint;
+  unsigned int ccpClades;
+  std::ifstream is(indexPath);
+  std::stringstream tampered;
+  unsigned int entries = 0;
+  while (is >> name >> geneTreeFingerprint >> treeLeaves >> ccpFingerprint >>
+         ccpClades) {
+    tampered << name << " " << geneTreeFingerprint << " " << treeLeaves + 100
+             << " " << ccpFingerprint << " " << ccpClades << "\n";
+    entries++;
+  }
+  is.close();
+  assert(entries == 2);
+  writeFile(indexPath, tampered.str());
+  leaves = runLeafNumbers(families, indexPath);
+  assert(leaves[0] == 105);
+  assert(leaves[1] == 103);
+  // a gene tree that changed is parsed again
+  writeFile(families[1].startingGeneTree, "((a,b),(c,d));");
+  leaves = runLeafNumbers(families, indexPath);
+  assert(leaves[0] == 105);
+  assert(leaves[1] == 4);
+  return 0;
+}
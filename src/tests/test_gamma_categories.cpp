@@ -0,0 +1,55 @@
+#include <cassert>
+#include <cmath>
+#include <likelihoods/ReconciliationEvaluation.hpp>
+#include <string>
+#include <vector>
+
+bool areClose(double ll1, double ll2, double epsilon) {
+  return std::fabs(ll1 - ll2) < epsilon * std::fabs(ll1);
+}
+
+/**
+ *  Reconciliation likelihood of the gene tree with the given number
+ *  of gamma categories. The gamma shape parameter alpha is only used
+ *  with several categories
+ */
+double evaluate(PLLRootedTree &speciesTree, PLLUnrootedTree &geneTree,
+                const GeneSpeciesMapping &mapping, RecModel model,
+                unsigned int categories, double alpha) {
+  RecModelInfo info;
+  info.model = model;
+  info.gammaCategories = categories;
+  std::vector<double> rates = {0.2, 0.3};
+  if (Enums::accountsForTransfers(model)) {
+    rates.push_back(0.1);
+  }
+  if (categories > 1) {
+    rates.push_back(alpha);
+  }
+  ReconciliationEvaluation evaluation(speciesTree, geneTree, mapping, info,
+                                      "");
+  evaluation.setRates(Parameters(rates));
+  return evaluation.evaluate();
+}
+
+int main() {
+  PLLRootedTree speciesTree("((A,B),((C,D),E));", false);
+  PLLUnrootedTree geneTree(
+      "((A_1,B_1),((C_1,C_2),(D_1,(E_1,B_2))),A_2);", false);
+  GeneSpeciesMapping mapping;
+  mapping.fillFromGeneLabels(geneTree.getLeafLabels());
+  for (auto model : {RecModel::UndatedDL, RecModel::UndatedDTL}) {
+    // one category is the model without rate heterogeneity
+    auto ll = evaluate(speciesTree, geneTree, mapping, model, 1, 1.0);
+    assert(std::isfinite(ll) && ll < 0.0);
+    // with a huge shape parameter, all the category rates are close
+    // to 1 and the categories give the same likelihood
+    auto flatLL = evaluate(speciesTree, geneTree, mapping, model, 4, 1.0e6);
+    assert(areClose(ll, flatLL, 1.0e-4));
+    // otherwise, the rates of the categories change the likelihood
+    auto gammaLL = evaluate(speciesTree, geneTree, mapping, model, 4, 0.5);
+    assert(std::isfinite(gammaLL));
+    assert(!areClose(ll, gammaLL, 1.0e-4));
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <likelihoods/LibpllEvaluation.hpp>
+#include <parallelization/ParallelContext.hpp>
+#include <string>
+
+/**
+ *  Write a random alignment, long enough to be split into
+ *  several site slices
+ */
+void writeAlignment(const std::string &path, unsigned int taxa,
+                    unsigned int sites) {
+  std::ofstream os(path);
+  const char nucleotides[] = "ACGT";
+  unsigned long seed = 42;
+  for (unsigned int t = 0; t < taxa; ++t) {
+    os << ">t" << t << std::endl;
+    for (unsigned int s = 0; s < sites; ++s) {
+      seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+      os << nucleotides[(seed >> 33) % 4];
+    }
+    os << std::endl;
+  }
+}
+
+bool areClose(double ll1, double ll2) {
+  return std::fabs(ll1 - ll2) < 1e-6 * std::fabs(ll1);
+}
+
+/**
+ *  Check that the likelihood of evaluation is the one of a serial
+ *  evaluation built from its tree and model
+ */
+void checkWithSerialEvaluation(LibpllEvaluation &evaluation,
+                               const std::string &alignment, double ll) {
+  LibpllEvaluation serial(evaluation.getGeneTree().getNewickString(), false,
+                          alignment, evaluation.getModelStr());
+  assert(areClose(ll, serial.computeLikelihood(false)));
+}
+
+int main() {
+  std::string alignment("test_site_slices.fasta");
+  writeAlignment(alignment, 8, 4000);
+  std::string tree("((t0:0.1,t1:0.2):0.1,(t2:0.1,t3:0.3):0.2,"
+                   "((t4:0.1,t5:0.1):0.1,(t6:0.2,t7:0.1):0.1):0.1);");
+  ParallelContext::setTeamSize(3);
+  LibpllEvaluation serial(tree, false, alignment, "GTR+G");
+  LibpllEvaluation sliced(tree, false, alignment, "GTR+G", true);
+  auto ll = serial.computeLikelihood(false);
+  assert(areClose(ll, sliced.computeLikelihood(false)));
+  assert(areClose(ll, sliced.computeLikelihood(true)));
+  // the optimizations run on the slices and their results are
+  // copied back to the main tree and model
+  auto optimizedLL = sliced.optimizeAllParameters();
+  assert(optimizedLL > ll);
+  assert(areClose(optimizedLL, sliced.computeLikelihood(true)));
+  checkWithSerialEvaluation(sliced, alignment, optimizedLL);
+  auto sprLL = sliced.raxmlSPRRounds(1, 5, 0, 0, 0.0);
+  checkWithSerialEvaluation(sliced, alignment, sprLL);
+  sprLL = sliced.optimizeBranches();
+  checkWithSerialEvaluation(sliced, alignment, sprLL);
+  // local optimization, as around the gene tree SPR moves
+  auto localLL = sliced.optimizeLocalBranches({0, 3, 5}, 1.0e-9, 5);
+  checkWithSerialEvaluation(sliced, alignment, localLL);
+  // changes of the main tree reach the slices through the CLV
+  // invalidations, and the slices then compute incrementally
+  auto node = sliced.getTreeInfo()->subnodes[2];
+  corax_treeinfo_set_root(sliced.getTreeInfo(), node);
+  corax_utree_set_length(node, node->length * 2.0);
+  sliced.invalidateCLV(node->node_index);
+  sliced.invalidateCLV(node->back->node_index);
+  auto changedLL = sliced.computeLikelihood(true);
+  assert(!areClose(changedLL, localLL));
+  checkWithSerialEvaluation(sliced, alignment, changedLL);
+  ParallelContext::setTeamSize(1);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cassert>
+#include <parallelization/ParallelContext.hpp>
+#include <vector>
+
+/**
+ *  Collective operations, run by each thread rank
+ */
+void checkCollectives() {
+  auto rank = ParallelContext::getRank();
+  auto size = ParallelContext::getSize();
+  assert(ParallelContext::isThreadRank());
+  std::vector<unsigned int> ranks;
+  ParallelContext::allGatherUInt(rank, ranks);
+  assert(ranks.size() == size);
+  for (unsigned int i = 0; i < size; ++i) {
+    assert(ranks[i] == i);
+  }
+  unsigned int sum = rank + 1;
+  ParallelContext::sumUInt(sum);
+  assert(sum == size * (size + 1) / 2);
+  double doubleSum = 0.5;
+  ParallelContext::sumDouble(doubleSum);
+  assert(doubleSum == 0.5 * size);
+  double first = 1.0;
+  double second = rank;
+  ParallelContext::sumDoubles({&first, &second});
+  assert(first == size);
+  assert(second == (size - 1) * size / 2);
+  std::vector<double> vectorSum = {1.0, static_cast<double>(rank)};
+  ParallelContext::sumVectorDouble(vectorSum);
+  assert(vectorSum[0] == size);
+  assert(vectorSum[1] == (size - 1) * size / 2);
+  unsigned int broadcasted = rank * 10;
+  ParallelContext::broadcastUInt(1, broadcasted);
+  assert(broadcasted == 10);
+  bool all = (rank != 2);
+  ParallelContext::parallelAnd(all);
+  assert(!all);
+  // rank i contributes i values
+  std::vector<unsigned int> local(rank, rank);
+  std::vector<unsigned int> global;
+  ParallelContext::concatenateHeterogeneousUIntVectors(local, global);
+  assert(global.size() == (size - 1) * size / 2);
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < size; ++i) {
+    for (unsigned int j = 0; j < i; ++j) {
+      assert(global[offset++] == i);
+    }
+  }
+  // the static chunks cover all the elements
+  unsigned int elems = 11;
+  unsigned int chunk = ParallelContext::getEnd(elems) -
+                       ParallelContext::getBegin(elems);
+  ParallelContext::sumUInt(chunk);
+  assert(chunk == elems);
+  ParallelContext::barrier();
+}
+
+/**
+ *  Dynamic tasks, run by each thread rank: each task must be
+ *  given to exactly one rank, also when it runs in a
+ *  sequential context
+ */
+void checkDynamicTasks(unsigned int tasksNumber) {
+  std::vector<unsigned int> localTasks;
+  ParallelContext::startDynamicTasks();
+  for (auto task = ParallelContext::getNextTask(); task < tasksNumber;
+       task = ParallelContext::getNextTask()) {
+    ParallelContext::pushSequentialContext();
+    assert(ParallelContext::getSize() == 1);
+    unsigned int value = task;
+    ParallelContext::sumUInt(value);
+    assert(value == task);
+    localTasks.push_back(task);
+    ParallelContext::popContext();
+  }
+  ParallelContext::endDynamicTasks();
+  std::vector<unsigned int> tasks;
+  ParallelContext::concatenateHeterogeneousUIntVectors(localTasks, tasks);
+  std::sort(tasks.begin(), tasks.end());
+  assert(tasks.size() == tasksNumber);
+  for (unsigned int i = 0; i < tasksNumber; ++i) {
+    assert(tasks[i] == i);
+  }
+}
+
+int main() {
+  unsigned int threads = 4;
+  std::vector<int> done(threads, 0);
+  ParallelContext::runThreadRanks(threads, [&done]() {
+    checkCollectives();
+    checkDynamicTasks(100);
+    // a second frame starts from a fresh counter
+    checkDynamicTasks(7);
+    done[ParallelContext::getRank()] = 1;
+  });
+  assert(!ParallelContext::isThreadRank());
+  for (auto d : done) {
+    assert(d);
+  }
+  return 0;
+}
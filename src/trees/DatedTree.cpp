@@ -71,15 +71,12 @@ bool DatedTree::moveUp(unsigned int rank) {
 
 bool DatedTree::moveDown(unsigned int rank) {
   assert(_fromBL);
-  if (rank > _orderedSpeciations.size() - 2) {
+  if (!canMoveDown(rank)) {
     return false;
   }
   auto n1 = _orderedSpeciations[rank];
   auto n2 = _orderedSpeciations[rank + 1];
   // n1 has a lower rank than n2. We want to swap them
-  if (!n1->left || !n2->left || n2->parent == n1) {
-    return false;
-  }
   _orderedSpeciations[rank + 1] = n1;
   _orderedSpeciations[rank] = n2;
   _ranks[n1->node_index]++;
@@ -87,6 +84,20 @@ bool DatedTree::moveDown(unsigned int rank) {
   return true;
 }
 
+bool DatedTree::canMoveUp(unsigned int rank) const {
+  return rank != 0 && canMoveDown(rank - 1);
+}
+
+bool DatedTree::canMoveDown(unsigned int rank) const {
+  if (rank > _orderedSpeciations.size() - 2) {
+    return false;
+  }
+  auto n1 = _orderedSpeciations[rank];
+  auto n2 = _orderedSpeciations[rank + 1];
+  // n1 and n2 can only be swapped if they are two unrelated speciations
+  return n1->left && n2->left && n2->parent != n1;
+}
+
 void DatedTree::checkRanks() const {
   // check that _ranks are consistent with _orderedSpeciations
   for (unsigned int i = 0; i < _orderedSpeciations.size() - 1; ++i) {
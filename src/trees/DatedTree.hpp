@@ -31,6 +31,13 @@ public:
   bool moveUp(unsigned int rank);
   bool moveDown(unsigned int rank);
 
+  /**
+   *  Return true if moveUp(rank) (resp. moveDown(rank)) would succeed,
+   *  without applying the move
+   */
+  bool canMoveUp(unsigned int rank) const;
+  bool canMoveDown(unsigned int rank) const;
+
   void restore(const DatedBackup &backup);
 
   bool canTransferUnderRelDated(unsigned int e, unsigned int d) const;
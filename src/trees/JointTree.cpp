@@ -29,6 +29,21 @@ static size_t getTreeHashRec(corax_unode_t *node, size_t i) {
   return hash_fn(m * i + M);
 }
 
+static size_t computeCladeHashRec(corax_unode_t *node,
+                                  std::vector<size_t> &cladeHashes,
+                                  std::vector<bool> &computed) {
+  size_t hash = 0;
+  if (!node->next) {
+    hash = leafHash(node);
+  } else {
+    hash = computeCladeHashRec(node->next->back, cladeHashes, computed) ^
+           computeCladeHashRec(node->next->next->back, cladeHashes, computed);
+  }
+  cladeHashes[node->node_index] = hash;
+  computed[node->node_index] = true;
+  return hash;
+}
+
 static corax_unode_t *findMinimumHashLeafRec(corax_unode_t *root,
                                              size_t &hashValue) {
   assert(root);
@@ -86,6 +101,69 @@ size_t JointTree::getUnrootedTreeHash() {
   return res % 100000;
 }
 
+size_t JointTree::getSplitHash(size_t cladeHash) const {
+  // both sides of a split give the same value
+  size_t h = std::min(cladeHash, cladeHash ^ _allLeavesHash);
+  // mix the bits, such that the sum over the splits does not
+  // degenerate into a xor of the leaf hashes
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void JointTree::updateCladeHashes() {
+  auto treeinfo = getTreeInfo();
+  _cladeHashes.resize(treeinfo->subnode_count);
+  std::vector<bool> computed(treeinfo->subnode_count, false);
+  auto root = treeinfo->root;
+  _allLeavesHash = computeCladeHashRec(root, _cladeHashes, computed) ^
+                   computeCladeHashRec(root->back, _cladeHashes, computed);
+  // the traversals from root and root->back miss the directed nodes
+  // pointing toward them, whose clade is the complement of their back
+  for (unsigned int i = 0; i < treeinfo->subnode_count; ++i) {
+    auto node = treeinfo->subnodes[i];
+    if (!computed[node->node_index]) {
+      _cladeHashes[node->node_index] =
+          _allLeavesHash ^ _cladeHashes[node->back->node_index];
+    }
+  }
+  _topologyHash = 0;
+  for (unsigned int i = 0; i < treeinfo->subnode_count; ++i) {
+    auto node = treeinfo->subnodes[i];
+    if (node->node_index < node->back->node_index) {
+      _topologyHash += getSplitHash(_cladeHashes[node->node_index]);
+    }
+  }
+  _cladeHashesTopologyId = _topologyIds.top();
+}
+
+size_t JointTree::getTopologyHashAfterMove(const SPRMove &move) {
+  if (_cladeHashesTopologyId != _topologyIds.top()) {
+    updateCladeHashes();
+  }
+  // Let r_0...r_m be the nodes from the prune node neighbour r_0 to the
+  // regraft node r_m, and R_k the clade under r_k. Pruning removes the
+  // split of R_0, regrafting adds the split of R_m + P, P being the
+  // pruned clade, and the splits of the nodes in between become R_k + P
+  auto prune = getNode(move.getPruneIndex());
+  auto pruned = _cladeHashes[prune->back->node_index];
+  auto &path = move.getPath();
+  assert(path.size());
+  assert(getNode(path[0])->back == prune->next ||
+         getNode(path[0])->back == prune->next->next);
+  auto hash = _topologyHash;
+  hash -= getSplitHash(_cladeHashes[path[0]]);
+  for (unsigned int k = 1; k < path.size(); ++k) {
+    auto clade = _cladeHashes[path[k]];
+    hash += getSplitHash(clade ^ pruned) - getSplitHash(clade);
+  }
+  hash += getSplitHash(_cladeHashes[move.getRegraftIndex()] ^ pruned);
+  return hash;
+}
+
 static void printLibpllNode(corax_unode_s *node, Logger &os, bool isRoot) {
   if (node->next) {
     os << "(";
@@ -113,21 +191,31 @@ JointTree::JointTree(
     const std::string &substitutionModel, const RecModelInfo &recModelInfo,
     RecOpt reconciliationOpt, bool madRooting, double supportThreshold,
     double recWeight, bool safeMode, bool optimizeDTLRates,
-    const Parameters &ratesVector, const std::string &checkpointPath)
+    const Parameters &ratesVector, const std::string &checkpointPath,
+    PLLRootedTree *sharedSpeciesTree)
     : _checkpoint(checkpointPath),
       _libpllEvaluation(
           (_checkpoint.checkpointExists ? _checkpoint.geneTreeNewickStr
                                         : newickString),
           false, alignmentFilename,
           (_checkpoint.checkpointExists ? _checkpoint.substModelStr
-                                        : substitutionModel)),
-      _speciesTree(speciestree_file, true), _optimizeDTLRates(optimizeDTLRates),
+                                        : substitutionModel),
+          true),
+      _ownedSpeciesTree(sharedSpeciesTree ? nullptr
+                                          : std::make_unique<PLLRootedTree>(
+                                                speciestree_file, true)),
+      _speciesTree(sharedSpeciesTree ? *sharedSpeciesTree
+                                     : *_ownedSpeciesTree),
+      _lastTopologyId(0),
+      _cladeHashesTopologyId(std::numeric_limits<unsigned int>::max()),
+      _allLeavesHash(0), _topologyHash(0), _optimizeDTLRates(optimizeDTLRates),
       _safeMode(safeMode), _enableReconciliation(true), _enableLibpll(true),
       _recOpt(reconciliationOpt), _recWeight(recWeight),
       _supportThreshold(supportThreshold), _madRooting(madRooting) {
   if (_checkpoint.checkpointExists) {
     Logger::info << "using model " << _checkpoint.substModelStr << std::endl;
   }
+  _topologyIds.push(_lastTopologyId);
   _geneSpeciesMap.fill(geneSpeciesMapfile, newickString);
   if (recModelInfo.forceGeneTreeRoot) {
     _enforcedRootedGeneTree = newickString;
@@ -152,6 +240,7 @@ void JointTree::printLibpllTree() const {
 void JointTree::optimizeParameters(bool felsenstein, bool reconciliation) {
   if (felsenstein && _enableLibpll) {
     _libpllEvaluation.optimizeAllParameters();
+    _scoreCache.clear();
   }
   if (reconciliation && _enableReconciliation && _optimizeDTLRates) {
     if (reconciliationEvaluation_->implementsTransfers()) {
@@ -196,6 +285,7 @@ corax_unode_t *JointTree::getNode(unsigned int index) {
 
 void JointTree::applyMove(SPRMove &move) {
   _rollbacks.push(move.applyMove(*this));
+  _topologyIds.push(++_lastTopologyId);
 }
 
 void JointTree::optimizeMove(SPRMove &move) {
@@ -214,6 +304,7 @@ void JointTree::rollbackLastMove() {
   assert(!_rollbacks.empty());
   _rollbacks.top()->applyRollback();
   _rollbacks.pop();
+  _topologyIds.pop();
 }
 
 void JointTree::save(const std::string &fileName, bool append) {
@@ -242,6 +333,7 @@ void JointTree::invalidateCLV(corax_unode_s *node) {
 
 void JointTree::setRates(const Parameters &ratesVector) {
   _ratesVector = ratesVector;
+  _scoreCache.clear();
   if (_enableReconciliation) {
     reconciliationEvaluation_->setRates(ratesVector);
   }
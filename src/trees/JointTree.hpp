@@ -6,6 +6,7 @@
 #include <likelihoods/ReconciliationEvaluation.hpp>
 #include <maths/Parameters.hpp>
 #include <search/Moves.hpp>
+#include <search/TreeScoreCache.hpp>
 #include <sstream>
 #include <stack>
 #include <trees/PLLRootedTree.hpp>
@@ -25,7 +26,8 @@ public:
             const RecModelInfo &recModelInfo, RecOpt reconciliationOpt,
             bool madRooting, double supportThreshold, double recWeight,
             bool safeMode, bool optimizeDTLRates, const Parameters &ratesVector,
-            const std::string &checkpointPath);
+            const std::string &checkpointPath,
+            PLLRootedTree *sharedSpeciesTree = nullptr);
   JointTree(const JointTree &) = delete;
   JointTree &operator=(const JointTree &) = delete;
   JointTree(JointTree &&) = delete;
@@ -53,6 +55,20 @@ public:
   void setRates(const Parameters &ratesVector);
   PLLRootedTree &getSpeciesTree() { return _speciesTree; }
   size_t getUnrootedTreeHash();
+  /**
+   *  Hash of the unrooted topology that applying move would give,
+   *  without applying it. The hash is a sum over the splits of the
+   *  tree, so that it can be updated in O(length of the move path)
+   *  from the split hashes of the current tree.
+   *  The move path must go from the neighbour of the prune node to the
+   *  parent of the regraft node, as built by diggBestMoveFromPrune
+   */
+  size_t getTopologyHashAfterMove(const SPRMove &move);
+  /**
+   *  Scores of the topologies already evaluated during the SPR
+   *  search. Cleared when the model parameters change
+   */
+  TreeScoreCache &getScoreCache() { return _scoreCache; }
   ReconciliationEvaluation &getReconciliationEvaluation() {
     return *reconciliationEvaluation_;
   }
@@ -76,6 +92,7 @@ public:
   unsigned int getGeneTaxaNumber() { return getTreeInfo()->tip_count; }
   PLLUnrootedTree &getGeneTree() { return _libpllEvaluation.getGeneTree(); }
   Model &getModel() { return _libpllEvaluation.getModel(); }
+  LibpllEvaluation &getLibpllEvaluation() { return _libpllEvaluation; }
   const GeneSpeciesMapping &getMappings() const { return _geneSpeciesMap; }
   double getSupportThreshold() const { return _supportThreshold; }
   /**
@@ -91,10 +108,22 @@ private:
   GeneRaxCheckpoint _checkpoint;
   LibpllEvaluation _libpllEvaluation;
   std::shared_ptr<ReconciliationEvaluation> reconciliationEvaluation_;
-  PLLRootedTree _speciesTree;
+  // only set if the species tree is not shared with the caller
+  std::unique_ptr<PLLRootedTree> _ownedSpeciesTree;
+  PLLRootedTree &_speciesTree;
   GeneSpeciesMapping _geneSpeciesMap;
   Parameters _ratesVector;
   std::stack<std::shared_ptr<SPRRollback>> _rollbacks;
+  // identifiers of the current and of the previous topologies, to
+  // know if _cladeHashes still describes the current topology
+  std::stack<unsigned int> _topologyIds;
+  unsigned int _lastTopologyId;
+  unsigned int _cladeHashesTopologyId;
+  // xor of the leaf hashes under each directed node
+  std::vector<size_t> _cladeHashes;
+  size_t _allLeavesHash;
+  size_t _topologyHash;
+  TreeScoreCache _scoreCache;
   bool _optimizeDTLRates;
   bool _safeMode;
   bool _enableReconciliation;
@@ -104,4 +133,7 @@ private:
   double _supportThreshold;
   bool _madRooting;
   std::string _enforcedRootedGeneTree;
+
+  void updateCladeHashes();
+  size_t getSplitHash(size_t cladeHash) const;
 };
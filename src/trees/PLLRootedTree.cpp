@@ -481,9 +481,31 @@ std::vector<corax_rnode_t *> PLLRootedTree::getPostOrderNodes() const {
 void PLLRootedTree::onSpeciesTreeChange(
     const std::unordered_set<corax_rnode_t *> *nodesToInvalidate) {
   ensureUniqueLabels(nodesToInvalidate);
-  if (_lcaCache) {
-    buildLCACache();
+  // the LCA index, the relation rows and the topology snapshot
+  // will be rebuilt on the next query
+  _lcaIndex.reset();
+  _relationRows.reset();
+  _topologySnapshot.reset();
+}
+
+std::shared_ptr<const PLLRootedTree::TopologySnapshot>
+PLLRootedTree::getTopologySnapshot() {
+  if (!_topologySnapshot) {
+    auto N = getNodeNumber();
+    auto snapshot = std::make_shared<TopologySnapshot>();
+    snapshot->postOrder = getPostOrderNodes();
+    snapshot->left.resize(N, nullptr);
+    snapshot->right.resize(N, nullptr);
+    snapshot->parent.resize(N, nullptr);
+    for (auto node : snapshot->postOrder) {
+      auto e = node->node_index;
+      snapshot->left[e] = node->left;
+      snapshot->right[e] = node->right;
+      snapshot->parent[e] = node->parent;
+    }
+    _topologySnapshot = snapshot;
   }
+  return _topologySnapshot;
 }
 
 corax_rnode_t *PLLRootedTree::getLCA(corax_rnode_t *n1, corax_rnode_t *n2) {
@@ -498,109 +520,162 @@ corax_rnode_t *PLLRootedTree::getLCA(corax_rnode_t *n1, corax_rnode_t *n2) {
 
 corax_rnode_t *PLLRootedTree::getLCA(unsigned int nodeIndex1,
                                      unsigned int nodeIndex2) {
-  if (!_lcaCache) {
-    buildLCACache();
+  const auto &index = getLCAIndex();
+  auto i = index.first[nodeIndex1];
+  auto j = index.first[nodeIndex2];
+  if (i > j) {
+    std::swap(i, j);
   }
-  return _lcaCache->lcas[nodeIndex1][nodeIndex2];
+  // the LCA is the lowest depth node visited between n1 and n2
+  auto k = index.logs[j - i + 1];
+  auto m1 = index.minima[k][i];
+  auto m2 = index.minima[k][j + 1 - (1u << k)];
+  return index.depths[m1] <= index.depths[m2] ? index.tour[m1]
+                                              : index.tour[m2];
 }
 
 bool PLLRootedTree::isAncestorOf(unsigned int nodeIndex1,
                                  unsigned int nodeIndex2) {
-  if (!_lcaCache) {
-    buildLCACache();
-  }
-  return _lcaCache->ancestors[nodeIndex2][nodeIndex1];
+  const auto &index = getLCAIndex();
+  return index.first[nodeIndex1] <= index.first[nodeIndex2] &&
+         index.last[nodeIndex2] <= index.last[nodeIndex1];
 }
 
 bool PLLRootedTree::areParents(corax_rnode_t *n1, corax_rnode_t *n2) {
-  if (!_lcaCache) {
-    buildLCACache();
+  return isAncestorOf(n1->node_index, n2->node_index) ||
+         isAncestorOf(n2->node_index, n1->node_index);
+}
+
+const genesis::utils::Bitvector &
+PLLRootedTree::getParentsRow(corax_rnode_t *n1) {
+  if (!_relationRows) {
+    buildRelationRows();
   }
-  return _lcaCache->parents[n1->node_index][n2->node_index];
+  return _relationRows->parents[n1->node_index];
 }
 
-std::vector<bool> &PLLRootedTree::getParentsCache(corax_rnode_t *n1) {
-  if (!_lcaCache) {
-    buildLCACache();
+const genesis::utils::Bitvector &
+PLLRootedTree::getAncestorsRow(corax_rnode_t *n1) {
+  if (!_relationRows) {
+    buildRelationRows();
   }
-  return _lcaCache->parents[n1->node_index];
+  return _relationRows->ancestors[n1->node_index];
 }
 
-std::vector<bool> &PLLRootedTree::getAncestorssCache(corax_rnode_t *n1) {
-  if (!_lcaCache) {
-    buildLCACache();
+const genesis::utils::Bitvector &
+PLLRootedTree::getPostOrderParentsRow(corax_rnode_t *n1) {
+  if (!_relationRows) {
+    buildRelationRows();
   }
-  return _lcaCache->ancestors[n1->node_index];
+  return _relationRows->postOrderParents[n1->node_index];
 }
 
-static void fillWithChildren(corax_rnode_t *n1, corax_rnode_t *n2,
-                             std::vector<corax_rnode_t *> &n1lcas) {
-  if (!n2) {
-    return;
+void PLLRootedTree::buildRelationRows() {
+  auto N = getNodeNumber();
+  _relationRows = std::make_unique<RelationRows>();
+  genesis::utils::Bitvector empty(N);
+  auto &ancestors = _relationRows->ancestors;
+  auto &parents = _relationRows->parents;
+  ancestors.resize(N, empty);
+  parents.resize(N, empty);
+  auto postOrder = getPostOrderNodes();
+  // the parents row starts with the descendants, filled from the leaves
+  for (auto node : postOrder) {
+    auto &row = parents[node->node_index];
+    if (node->left) {
+      row |= parents[node->left->node_index];
+      row |= parents[node->right->node_index];
+    }
+    row.set(node->node_index);
+  }
+  // fill the ancestors from the root, and add them to the parents row
+  for (auto it = postOrder.rbegin(); it != postOrder.rend(); ++it) {
+    auto node = *it;
+    auto &row = ancestors[node->node_index];
+    if (node->parent) {
+      row = ancestors[node->parent->node_index];
+    }
+    row.set(node->node_index);
+    parents[node->node_index] |= row;
+  }
+  std::vector<unsigned int> positions(N);
+  for (unsigned int i = 0; i < postOrder.size(); ++i) {
+    positions[postOrder[i]->node_index] = i;
+  }
+  auto &postOrderParents = _relationRows->postOrderParents;
+  postOrderParents.resize(N, empty);
+  for (unsigned int e = 0; e < N; ++e) {
+    forEachSetBit(parents[e], [&](size_t f) {
+      postOrderParents[e].set(positions[f]);
+    });
   }
-  n1lcas[n2->node_index] = n1;
-  fillWithChildren(n1, n2->left, n1lcas);
-  fillWithChildren(n1, n2->right, n1lcas);
 }
 
-/**
- * Recursion that starts with n2 == root and lca == root
- * traverse all nodes from the root to the leaves with n2
- * to fill n1 LCAs
- */
-static void findn1LCAs(corax_rnode_t *n1, corax_rnode_t *n2, corax_rnode_t *lca,
-                       const std::unordered_set<corax_rnode_t *> &n1Ancestors,
-                       std::vector<corax_rnode_t *> &n1lcas) {
-  if (!n2) {
-    // end of the recursion
-    return;
+const PLLRootedTree::LCAIndex &PLLRootedTree::getLCAIndex() {
+  if (!_lcaIndex) {
+    buildLCAIndex();
   }
-  if (n1 == n2) {
-    // edge case: from now, the lca of n1 and all children of n2
-    // is n1.
-    fillWithChildren(n1, n2, n1lcas);
-  } else {
-    if (n1Ancestors.find(n2) != n1Ancestors.end()) {
-      // n2 is an ancestor of n1, and thus the new lca
-      // in the recursion
-      lca = n2;
-    }
-    n1lcas[n2->node_index] = lca;
-    findn1LCAs(n1, n2->left, lca, n1Ancestors, n1lcas);
-    findn1LCAs(n1, n2->right, lca, n1Ancestors, n1lcas);
+  return *_lcaIndex;
+}
+
+static void fillEulerTour(corax_rnode_t *node, unsigned int depth,
+                          std::vector<corax_rnode_t *> &tour,
+                          std::vector<unsigned int> &depths,
+                          std::vector<unsigned int> &first,
+                          std::vector<unsigned int> &last) {
+  first[node->node_index] = tour.size();
+  tour.push_back(node);
+  depths.push_back(depth);
+  if (node->left) {
+    fillEulerTour(node->left, depth + 1, tour, depths, first, last);
+    tour.push_back(node);
+    depths.push_back(depth);
+    fillEulerTour(node->right, depth + 1, tour, depths, first, last);
+    tour.push_back(node);
+    depths.push_back(depth);
   }
+  last[node->node_index] = tour.size() - 1;
 }
 
-static void findLCAs(corax_rnode_t *n1, std::vector<corax_rnode_t *> &n1lcas) {
-  std::unordered_set<corax_rnode_t *> n1Ancestors;
-  auto it = n1;
-  auto root = n1;
-  while (it) {
-    n1Ancestors.insert(it);
-    root = it;
-    it = it->parent;
+void PLLRootedTree::buildLazyStructures() {
+  if (!_lcaIndex) {
+    buildLCAIndex();
+  }
+  if (!_relationRows) {
+    buildRelationRows();
   }
-  findn1LCAs(n1, root, root, n1Ancestors, n1lcas);
+  getTopologySnapshot();
 }
 
-void PLLRootedTree::buildLCACache() {
+void PLLRootedTree::buildLCAIndex() {
   auto N = getNodeNumber();
-  _lcaCache = std::make_unique<LCACache>();
-  std::vector<corax_rnode_t *> nulls(N, nullptr);
-  _lcaCache->lcas = std::vector<std::vector<corax_rnode_t *>>(N, nulls);
-  std::vector<bool> falses(N, false);
-  _lcaCache->parents = std::vector<std::vector<bool>>(N, falses);
-  _lcaCache->ancestors = std::vector<std::vector<bool>>(N, falses);
-  for (auto n : getNodes()) {
-    findLCAs(n, _lcaCache->lcas[n->node_index]);
-  }
-  for (auto n1 : getNodes()) {
-    auto n2 = n1;
-    while (n2) {
-      _lcaCache->parents[n1->node_index][n2->node_index] = true;
-      _lcaCache->parents[n2->node_index][n1->node_index] = true;
-      _lcaCache->ancestors[n1->node_index][n2->node_index] = true;
-      n2 = n2->parent;
+  _lcaIndex = std::make_unique<LCAIndex>();
+  auto &index = *_lcaIndex;
+  index.tour.reserve(2 * N);
+  index.depths.reserve(2 * N);
+  index.first.resize(N);
+  index.last.resize(N);
+  fillEulerTour(getRoot(), 0, index.tour, index.depths, index.first,
+                index.last);
+  auto M = index.tour.size();
+  index.logs.resize(M + 1, 0);
+  for (unsigned int i = 2; i <= M; ++i) {
+    index.logs[i] = index.logs[i / 2] + 1;
+  }
+  index.minima.resize(index.logs[M] + 1);
+  index.minima[0].resize(M);
+  for (unsigned int i = 0; i < M; ++i) {
+    index.minima[0][i] = i;
+  }
+  for (unsigned int k = 1; k < index.minima.size(); ++k) {
+    auto &prev = index.minima[k - 1];
+    auto &curr = index.minima[k];
+    auto half = 1u << (k - 1);
+    curr.resize(M + 1 - 2 * half);
+    for (unsigned int i = 0; i < curr.size(); ++i) {
+      auto m1 = prev[i];
+      auto m2 = prev[i + half];
+      curr[i] = index.depths[m1] <= index.depths[m2] ? m1 : m2;
     }
   }
 }
@@ -2,6 +2,7 @@
 
 #include <IO/LibpllParsers.hpp>
 #include <corax/corax.h>
+#include <maths/bitvector.hpp>
 #include <memory>
 #include <set>
 #include <string>
@@ -169,30 +170,99 @@ public:
 
   /**
    * Get lowest common ancestor
-   * First call is O(n^2), and all next calls O(1)
+   * First call is O(n log n), and all next calls O(1)
    */
   corax_rnode_t *getLCA(corax_rnode_t *n1, corax_rnode_t *n2);
   corax_rnode_t *getLCA(unsigned int nodeIndex1, unsigned int nodeIndex2);
 
   /**
    * Return true if n1 is an ancestor of n2
-   * First call is O(n^2), and all next calls O(1)
+   * First call is O(n log n), and all next calls O(1)
    */
   bool isAncestorOf(unsigned int nodeIndex1, unsigned int nodeIndex2);
 
   /**
    * Return true if either one of n1 or n2 is parent of another
-   * First call is O(n^2), and all next calls O(1)
+   * First call is O(n log n), and all next calls O(1)
    */
   bool areParents(corax_rnode_t *n1, corax_rnode_t *n2);
 
   void onSpeciesTreeChange(
       const std::unordered_set<corax_rnode_t *> *nodesToInvalidate);
 
-  std::vector<bool> &getParentsCache(corax_rnode_t *n1);
-  std::vector<bool> &getAncestorssCache(corax_rnode_t *n1);
+  /**
+   * Return the nodes that are either ancestors or descendants of n1
+   * (including n1), as a bitvector indexed with the rnodes indices.
+   * Rows are packed in 64 bits words, such that they can be combined
+   * with each other at a low cost
+   * First call is O(n^2 / 64), and all next calls O(1)
+   */
+  const genesis::utils::Bitvector &getParentsRow(corax_rnode_t *n1);
+
+  /**
+   * Return the ancestors of n1 (including n1), as a bitvector
+   * indexed with the rnodes indices
+   * First call is O(n^2 / 64), and all next calls O(1)
+   */
+  const genesis::utils::Bitvector &getAncestorsRow(corax_rnode_t *n1);
+
+  /**
+   * Same as getParentsRow, but the bits are indexed with the
+   * positions of the nodes in getPostOrderNodes(), such that
+   * forEachSetBit visits the related nodes in post order
+   * First call is O(n^2 / 64), and all next calls O(1)
+   */
+  const genesis::utils::Bitvector &getPostOrderParentsRow(corax_rnode_t *n1);
 
-  void buildLCACache();
+  /**
+   * Call f(i) for each set bit i of row, in increasing order.
+   * The row is read word by word, such that empty words are
+   * skipped with a single test
+   */
+  template <class F>
+  static void forEachSetBit(const genesis::utils::Bitvector &row, F f) {
+    const auto &words = row.getInternalBuffer();
+    for (size_t w = 0; w < words.size(); ++w) {
+      auto word = words[w];
+      while (word) {
+        f(w * genesis::utils::Bitvector::IntSize + __builtin_ctzll(word));
+        word &= word - 1; // clear the lowest set bit
+      }
+    }
+  }
+
+  /**
+   * Index-based description of the topology, indexed with the
+   * rnodes indices (left, right and parent are nullptr when
+   * the node has no such neighbor)
+   */
+  struct TopologySnapshot {
+    std::vector<corax_rnode_t *> postOrder;
+    std::vector<corax_rnode_t *> left;
+    std::vector<corax_rnode_t *> right;
+    std::vector<corax_rnode_t *> parent;
+  };
+
+  /**
+   * Return the snapshot of the current topology. The same
+   * snapshot is returned to all callers until the next call
+   * to onSpeciesTreeChange, such that it can be shared by all
+   * the objects reading the tree (e.g. the reconciliation models)
+   */
+  std::shared_ptr<const TopologySnapshot> getTopologySnapshot();
+
+  /**
+   * (Re)build the LCA index from the current topology. It is
+   * otherwise built lazily after each call to onSpeciesTreeChange
+   */
+  void buildLCAIndex();
+
+  /**
+   * Build all the structures that are otherwise built lazily
+   * (LCA index, relation rows, topology snapshot), such that
+   * several threads can then read the tree concurrently
+   */
+  void buildLazyStructures();
 
   /**
    *  Compute and return a mapping between labels and
@@ -229,17 +299,39 @@ public:
 private:
   std::unique_ptr<corax_rtree_t, void (*)(corax_rtree_t *)> _tree;
 
-  struct LCACache {
+  struct LCAIndex {
+    // Euler tour of the tree (each node is visited before
+    // its children, and again after each of its children)
+    std::vector<corax_rnode_t *> tour;
+    std::vector<unsigned int> depths;
+    // vectors indexed with rnodes indices: first and last
+    // position of the node in the tour. n2 is an ancestor of
+    // n1 iff [first[n1], last[n1]] is included in [first[n2], last[n2]]
+    std::vector<unsigned int> first;
+    std::vector<unsigned int> last;
+    // sparse table: minima[k][i] is the position of the lowest
+    // depth node of the tour within [i, i + 2^k)
+    std::vector<std::vector<unsigned int>> minima;
+    // logs[i] == floor(log2(i))
+    std::vector<unsigned int> logs;
+  };
+  std::unique_ptr<LCAIndex> _lcaIndex;
+  const LCAIndex &getLCAIndex();
+
+  struct RelationRows {
     // vectors are indexed with rnodes indices
-    // lcas[n1][n2] == lca(n1, n2) in the tree
     // parents[n1][n2] is true if n2 is an ancestor
     //   of n1 or n1 an ancestor of n2
     // ancestors[n1][n2] is true if n2 is ancestor of n1
-    std::vector<std::vector<corax_rnode_t *>> lcas;
-    std::vector<std::vector<bool>> parents;
-    std::vector<std::vector<bool>> ancestors;
+    std::vector<genesis::utils::Bitvector> parents;
+    std::vector<genesis::utils::Bitvector> ancestors;
+    // postOrderParents[n1][i] is parents[n1][postOrder[i]]
+    std::vector<genesis::utils::Bitvector> postOrderParents;
   };
-  std::unique_ptr<LCACache> _lcaCache;
+  std::unique_ptr<RelationRows> _relationRows;
+  void buildRelationRows();
+
+  std::shared_ptr<const TopologySnapshot> _topologySnapshot;
 
   static corax_rtree_t *
   buildRandomTree(const std::unordered_set<std::string> &leafLabels);
@@ -8,6 +8,9 @@
 
 #include <corax/corax.h>
 const double DEFAULT_BL = 0.1;
+// below this number of site patterns per slice, the threading
+// overhead outweighs the gain
+const unsigned int MIN_PATTERNS_PER_SLICE = 1000;
 
 static unsigned int getBestLibpllAttribute() {
   corax_hardware_probe();
@@ -30,9 +33,16 @@ void treeinfoDestroy(corax_treeinfo_t *treeinfo) {
   corax_treeinfo_destroy(treeinfo);
 }
 
+static void sliceTreeDestroy(corax_utree_t *utree) {
+  if (utree) {
+    corax_utree_destroy(utree, nullptr);
+  }
+}
+
 PLLTreeInfo::PLLTreeInfo(const std::string &newickStrOrFile, bool isNewickAFile,
                          const std::string &alignmentFilename,
-                         const std::string &modelStrOrFile)
+                         const std::string &modelStrOrFile,
+                         unsigned int maxSiteSlices)
     : _treeinfo(nullptr, treeinfoDestroy),
       _model(LibpllParsers::getModel(modelStrOrFile)) {
   PLLSequencePtrs sequences;
@@ -40,12 +50,52 @@ PLLTreeInfo::PLLTreeInfo(const std::string &newickStrOrFile, bool isNewickAFile,
   LibpllParsers::parseMSA(alignmentFilename, _model->charmap(), sequences,
                           patternWeights);
   buildTree(newickStrOrFile, isNewickAFile, sequences);
-  auto partition = buildPartition(sequences, patternWeights);
+  auto sitesNumber = sequences[0]->len;
+  auto partition = buildPartition(sequences, patternWeights, 0, sitesNumber);
   _treeinfo = std::unique_ptr<corax_treeinfo_t, void (*)(corax_treeinfo_t *)>(
-      buildTreeInfo(*_model, partition, *_utree), treeinfoDestroy);
+      buildTreeInfo(*_model, partition, _utree->getAnyInnerNode(),
+                    _utree->getLeafNumber()),
+      treeinfoDestroy);
+  auto slices = std::min(maxSiteSlices, sitesNumber / MIN_PATTERNS_PER_SLICE);
+  if (slices > 1) {
+    buildSiteSlices(sequences, patternWeights, slices);
+  }
   free(patternWeights);
 }
 
+std::vector<corax_treeinfo_t *> PLLTreeInfo::getSiteSlices() {
+  std::vector<corax_treeinfo_t *> res;
+  for (auto &treeinfo : _sliceTreeinfos) {
+    res.push_back(treeinfo.get());
+  }
+  return res;
+}
+
+void PLLTreeInfo::buildSiteSlices(const PLLSequencePtrs &sequences,
+                                  unsigned int *patternWeights,
+                                  unsigned int slices) {
+  auto sitesNumber = sequences[0]->len;
+  for (unsigned int i = 0; i < slices; ++i) {
+    auto begin = (i * sitesNumber) / slices;
+    auto end = ((i + 1) * sitesNumber) / slices;
+    // the clone keeps the node, CLV and pmatrix indices
+    auto tree = corax_utree_clone(_utree->getRawPtr());
+    if (!tree) {
+      throw LibpllException("Could not clone the tree for a site slice");
+    }
+    _sliceTrees.push_back(
+        std::unique_ptr<corax_utree_t, void (*)(corax_utree_t *)>(
+            tree, sliceTreeDestroy));
+    auto partition =
+        buildPartition(sequences, patternWeights + begin, begin, end - begin);
+    _sliceTreeinfos.push_back(
+        std::unique_ptr<corax_treeinfo_t, void (*)(corax_treeinfo_t *)>(
+            buildTreeInfo(*_model, partition, tree->nodes[tree->tip_count],
+                          tree->tip_count),
+            treeinfoDestroy));
+  }
+}
+
 void PLLTreeInfo::buildModel(const std::string &modelStrOrFile) {
   std::string modelStr = modelStrOrFile;
   std::ifstream f(modelStr);
@@ -75,12 +125,13 @@ void PLLTreeInfo::buildTree(const std::string &newickStrOrFile,
 }
 
 corax_partition_t *PLLTreeInfo::buildPartition(const PLLSequencePtrs &sequences,
-                                               unsigned int *patternWeights) {
+                                               unsigned int *patternWeights,
+                                               unsigned int firstSite,
+                                               unsigned int sitesNumber) {
   unsigned int attribute = getBestLibpllAttribute();
   unsigned int tipNumber = static_cast<unsigned int>(sequences.size());
   unsigned int innerNumber = tipNumber - 1;
   unsigned int edgesNumber = 2 * tipNumber - 1;
-  unsigned int sitesNumber = sequences[0]->len;
   unsigned int ratesMatrices = _model->num_submodels();
   corax_partition_t *partition = corax_partition_create(
       tipNumber, innerNumber, _model->num_states(), sitesNumber, ratesMatrices,
@@ -97,7 +148,9 @@ corax_partition_t *PLLTreeInfo::buildPartition(const PLLSequencePtrs &sequences,
   unsigned int labelIndex = 0;
   for (auto &seq : sequences) {
     tipsLabelling[seq->label] = labelIndex;
-    corax_set_tip_states(partition, labelIndex, _model->charmap(), seq->seq);
+    std::string sites(seq->seq + firstSite, sitesNumber);
+    corax_set_tip_states(partition, labelIndex, _model->charmap(),
+                         sites.c_str());
     labelIndex++;
   }
   assign(partition, *_model);
@@ -112,12 +165,13 @@ corax_partition_t *PLLTreeInfo::buildPartition(const PLLSequencePtrs &sequences,
 
 corax_treeinfo_t *PLLTreeInfo::buildTreeInfo(const Model &model,
                                              corax_partition_t *partition,
-                                             PLLUnrootedTree &utree) {
+                                             corax_unode_t *root,
+                                             unsigned int tipNumber) {
   // treeinfo
   int params_to_optimize = model.params_to_optimize();
   params_to_optimize |= CORAX_OPT_PARAM_BRANCHES_ITERATIVE;
-  auto treeinfo = corax_treeinfo_create(
-      utree.getAnyInnerNode(), utree.getLeafNumber(), 1, CORAX_BRLEN_SCALED);
+  auto treeinfo =
+      corax_treeinfo_create(root, tipNumber, 1, CORAX_BRLEN_SCALED);
   if (!treeinfo || !treeinfo->root)
     throw LibpllException("Cannot create treeinfo");
   corax_treeinfo_init_partition(treeinfo, 0, partition, params_to_optimize,
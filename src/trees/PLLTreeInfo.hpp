@@ -13,9 +13,14 @@
 
 class PLLTreeInfo {
 public:
+  /**
+   *  @param maxSiteSlices maximum number of site slices (see
+   *    getSiteSlices) to build in addition to the main treeinfo
+   */
   PLLTreeInfo(const std::string &newickStrOrFile, bool isNewickAFile,
               const std::string &alignmentFilename,
-              const std::string &modelStrOrFile);
+              const std::string &modelStrOrFile,
+              unsigned int maxSiteSlices = 1);
 
   // forbid copy
   PLLTreeInfo(const PLLTreeInfo &) = delete;
@@ -27,10 +32,25 @@ public:
   PLLUnrootedTree &getTree() { return *_utree; }
   Model &getModel() { return *_model; }
 
+  /**
+   *  Treeinfos over disjoint blocks of the site patterns, each on its
+   *  own copy of the tree, for site-parallel likelihood computations.
+   *  Empty if the alignment is too short to be worth splitting.
+   *  The copies have the same node indices as getTree(), but the
+   *  caller is responsible for synchronizing their topology, branch
+   *  lengths and model parameters before using them
+   */
+  std::vector<corax_treeinfo_t *> getSiteSlices();
+
 private:
   std::unique_ptr<corax_treeinfo_t, void (*)(corax_treeinfo_t *)> _treeinfo;
   std::unique_ptr<PLLUnrootedTree> _utree;
   std::unique_ptr<Model> _model;
+  // the slice trees must outlive the slice treeinfos
+  std::vector<std::unique_ptr<corax_utree_t, void (*)(corax_utree_t *)>>
+      _sliceTrees;
+  std::vector<std::unique_ptr<corax_treeinfo_t, void (*)(corax_treeinfo_t *)>>
+      _sliceTreeinfos;
 
 private:
   void buildFromString(const std::string &newickString,
@@ -40,8 +60,12 @@ private:
   void buildTree(const std::string &newickStrOrFile, bool isNewickAFile,
                  const PLLSequencePtrs &sequences);
   corax_partition_t *buildPartition(const PLLSequencePtrs &sequences,
-                                    unsigned int *patternWeights);
+                                    unsigned int *patternWeights,
+                                    unsigned int firstSite,
+                                    unsigned int sitesNumber);
   corax_treeinfo_t *buildTreeInfo(const Model &model,
                                   corax_partition_t *partition,
-                                  PLLUnrootedTree &utree);
+                                  corax_unode_t *root, unsigned int tipNumber);
+  void buildSiteSlices(const PLLSequencePtrs &sequences,
+                       unsigned int *patternWeights, unsigned int slices);
 };
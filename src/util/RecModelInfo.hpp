@@ -140,12 +140,27 @@ struct RecModelInfo {
     if (originationStrategy == OriginationStrategy::OPTIMIZE) {
       res.push_back('O');
     }
+    if (hasGammaCategories()) {
+      res.push_back('G');
+    }
     return res;
   }
 
+  /**
+   *  Return true if the rates vary among families according to
+   *  gammaCategories discrete gamma categories. Only the undated
+   *  DL and DTL models support it. The gamma shape parameter is
+   *  then the last free parameter
+   */
+  bool hasGammaCategories() const {
+    return gammaCategories > 1 &&
+           (model == RecModel::UndatedDL || model == RecModel::UndatedDTL);
+  }
+
   unsigned int modelFreeParameters() const {
     return Enums::freeParameters(model) +
-           (originationStrategy == OriginationStrategy::OPTIMIZE ? 1 : 0);
+           (originationStrategy == OriginationStrategy::OPTIMIZE ? 1 : 0) +
+           (hasGammaCategories() ? 1 : 0);
   }
 
   /**
@@ -160,6 +175,9 @@ struct RecModelInfo {
     if (noDup) {
       res[0] = 0.0;
     }
+    if (hasGammaCategories()) {
+      res[res.dimensions() - 1] = 1.0;
+    }
     return res;
   }
 
@@ -178,6 +196,9 @@ struct RecModelInfo {
         res[i] = 0.1;
       }
     }
+    if (hasGammaCategories() && user.dimensions() < res.dimensions()) {
+      res[res.dimensions() - 1] = 1.0;
+    }
     return res;
   }
 